@@ -0,0 +1,89 @@
+#ifndef __BENCHMARKCONFIGH__
+#define __BENCHMARKCONFIGH__
+
+#include "DataConverter.h"
+#include "EphysSocketHeader.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace EphysSocketNode
+{
+/** How the sender reaches the receiver */
+enum SenderLink
+{
+    TCP_LINK, // loopback TCP, the receiver connecting to the sender
+    UDP_LINK, // loopback datagrams to the receiver's port
+    UNIX_LINK, // Unix domain socket, the receiver connecting to the sender
+    SHM_LINK, // shared-memory ring created by the sender
+    TCP_SERVER_LINK // loopback TCP, the sender connecting to the receiver's TcpServer, over IPv6 if the host has it
+};
+
+/** What the benchmark sends and how the receiver is set up */
+struct BenchmarkConfig
+{
+    int numChannels = 64;
+    int numSamples = 256;
+    Depth depth = U16;
+    int elementSize = 2;
+    float sampleRate = 30000.0f; // 0 sends as fast as the socket accepts
+    double seconds = 5.0;
+    int numStreams = 1;
+    SenderLink link = TCP_LINK;
+    int fragmentSize = 0; // payload bytes per fragment, 0 sends whole matrices
+    Layout layout = CHANNEL_MAJOR;
+    SimdLevel simdLevel = DataConverter::getMaxSimdLevel();
+    int queueSlots = 1024;
+    float batchSeconds = 0.1f; // largest batch converted at once, as in the plugin
+    bool extendedHeader = false; // send the header extension with the sample index and send time
+    bool checksum = false; // and a CRC32C of every payload
+    int ttlRows = 0; // rows at the end of each matrix decoded as TTL lines
+    bool lowLatency = false; // real-time receivers without delayed ACKs, as the plugin's low-latency mode
+    int cpu = -1; // first CPU the receivers are pinned to, which lets low-latency mode poll; -1 for none
+    bool batchReads = true; // read TCP in chunks and small datagrams in batches, as the plugin does; off reads packet by packet
+    bool compress = false; // send a signal shaped like neural data, compressed with DeltaCodec
+    int decimation = 1; // factor converted batches are decimated by, as with the plugin's output rate
+    std::string captureFile; // file the bytes each stream receives are captured to, empty for none
+    std::string replayFile; // capture file replayed through the receive and convert path instead of a sender
+
+    int getHeaderSize() const { return HEADER_SIZE + (extendedHeader ? EXTENSION_SIZE : 0); }
+
+    int getMatrixSize() const { return numChannels * numSamples * elementSize; }
+
+    int getFragmentSize() const { return fragmentSize > 0 && fragmentSize < getMatrixSize() ? fragmentSize : getMatrixSize(); }
+};
+
+/** Returns the steady_clock time in nanoseconds, which the sender and receiver share */
+inline int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Returns the CPU time used by the calling thread, in seconds */
+inline double getThreadCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes (GetCurrentThread(), &creation, &exit, &kernel, &user);
+
+    const auto toSeconds = [] (FILETIME t)
+    { return (double) (((uint64_t) t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7; };
+
+    return toSeconds (kernel) + toSeconds (user);
+#else
+    timespec t;
+    clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t);
+
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+#endif
+}
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __BENCHMARKSOCKETSH__
+#define __BENCHMARKSOCKETSH__
+
+#ifdef _WIN32
+#include <process.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/** Minimal BSD/Winsock shim for the loopback benchmark */
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+const SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+
+inline int pollSocket (pollfd* fds, int count, int timeoutMs) { return WSAPoll (fds, count, timeoutMs); }
+inline void closeSocketHandle (SocketHandle handle) { closesocket (handle); }
+inline int getProcessId() { return _getpid(); }
+#else
+using SocketHandle = int;
+const SocketHandle INVALID_SOCKET_HANDLE = -1;
+
+inline int pollSocket (pollfd* fds, int count, int timeoutMs) { return poll (fds, (nfds_t) count, timeoutMs); }
+inline void closeSocketHandle (SocketHandle handle) { close (handle); }
+inline int getProcessId() { return (int) getpid(); }
+#endif
+
+/** Starts and stops the socket library for the lifetime of the benchmark */
+struct SocketLibrary
+{
+#ifdef _WIN32
+    SocketLibrary()
+    {
+        WSADATA data;
+        WSAStartup (MAKEWORD (2, 2), &data);
+    }
+
+    ~SocketLibrary() { WSACleanup(); }
+#endif
+};
+
+/** Returns a loopback IPv4 address with the given port (0 = any free port) */
+inline sockaddr_in loopbackAddress (int port)
+{
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    address.sin_port = htons ((uint16_t) port);
+
+    return address;
+}
+
+/** Returns the port a socket is bound to */
+inline int getBoundPort (SocketHandle handle)
+{
+    sockaddr_in address {};
+    socklen_t length = sizeof (address);
+    getsockname (handle, (sockaddr*) &address, &length);
+
+    return ntohs (address.sin_port);
+}
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,1223 @@
+/*
+    Loopback throughput and latency benchmark for the EphysSocket receiver core.
+
+    Every stream runs a LoopbackSender, a receiver thread that frames packets into
+    a PacketRing (as SocketThread does) and a converter thread that turns them into
+    DataBuffer-ready blocks (as SocketStream does). Run with --help for the options.
+
+    With --replay, a capture file recorded by the plugin or by --capture is run
+    through the same framing and conversion instead, as fast as possible.
+*/
+
+#include "BatchConverter.h"
+#include "BenchmarkConfig.h"
+#include "BenchmarkSockets.h"
+#include "ClockRecovery.h"
+#include "Crc32c.h"
+#include "DatagramBatch.h"
+#include "Decimator.h"
+#include "DeltaCodec.h"
+#include "FrameReader.h"
+#include "LatencyHistogram.h"
+#include "LoopbackSender.h"
+#include "LowLatency.h"
+#include "PacketCapture.h"
+#include "PacketRing.h"
+#include "SequenceTracker.h"
+#include "SharedMemoryRing.h"
+#include "StreamBuffer.h"
+#include "StreamStats.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+/** Poll timeout of the receive loop, as in SocketThread */
+const int READ_TIMEOUT_MS = 50;
+
+/** Sleep of the converter when no packet is queued, as in EphysSocket::updateBuffer */
+const int PACKET_WAIT_MS = 10;
+
+/** Polling before sleeping in low-latency mode, as in SocketThread and EphysSocket::updateBuffer */
+const int LOW_LATENCY_SPIN_US = 500;
+
+/** Chunked and batched reads, as in SocketThread */
+const int STREAM_BUFFER_SIZE = 256 * 1024;
+const int DATAGRAM_BATCH_THRESHOLD = 8192;
+const int DATAGRAM_BATCH_SIZE = 32;
+
+/** Waits until the socket is readable, polling without sleeping first if asked to, like SocketThread::waitForData() */
+int waitReadable (SocketHandle socket, bool polling)
+{
+    pollfd fd { socket, POLLIN, 0 };
+
+    if (polling)
+    {
+        const int64_t spinEnd = nowNs() + LOW_LATENCY_SPIN_US * 1000;
+
+        do
+        {
+            const int ready = pollSocket (&fd, 1, 0);
+
+            if (ready != 0)
+                return ready;
+        } while (nowNs() < spinEnd);
+    }
+
+    return pollSocket (&fd, 1, READ_TIMEOUT_MS);
+}
+
+/** Auto-reset event, standing in for the JUCE WaitableEvent the plugin uses */
+class Event
+{
+public:
+    void signal()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        signalled = true;
+        condition.notify_one();
+    }
+
+    void wait (int timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        condition.wait_for (lock, std::chrono::milliseconds (timeoutMs), [this]
+                            { return signalled; });
+        signalled = false;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool signalled = false;
+};
+
+/** Reads from a connected TCP socket, waiting with poll() like SocketThread::readSome() */
+class SocketSource : public ChunkSource
+{
+public:
+    SocketSource (SocketHandle socket_, bool lowLatency_, bool polling_, const std::atomic<bool>& stopping_, CaptureWriter& capture_, StreamStats& stats_)
+        : socket (socket_), lowLatency (lowLatency_), polling (polling_), stopping (stopping_), capture (capture_), stats (stats_) {}
+
+    ReadStatus readSome (std::byte* dest, int maxBytes, int& numRead, bool midFragment) override
+    {
+        while (true)
+        {
+            const int ready = waitReadable (socket, polling);
+
+            if (ready < 0)
+                return READ_ERROR;
+
+            if (ready == 0)
+            {
+                if (stopping || ! midFragment)
+                    return NO_DATA;
+
+                continue;
+            }
+
+            const int rc = recv (socket, (char*) dest, maxBytes, 0);
+            stats.recordRead (rc);
+
+            if (rc < 0)
+                return READ_ERROR;
+
+            if (rc == 0)
+                return STREAM_CLOSED;
+
+            if (lowLatency)
+                setTcpQuickAck ((intptr_t) socket);
+
+            capture.append (nowNs(), dest, rc);
+            numRead = rc;
+
+            return PACKET_READY;
+        }
+    }
+
+private:
+    SocketHandle socket;
+    bool lowLatency;
+    bool polling;
+    const std::atomic<bool>& stopping;
+    CaptureWriter& capture;
+    StreamStats& stats;
+};
+
+/** Reads from a shared-memory ring, waiting on it like SocketThread::waitForSource() */
+class RingSource : public ChunkSource
+{
+public:
+    RingSource (SharedMemoryRing& ring_, const std::atomic<bool>& stopping_, CaptureWriter& capture_, StreamStats& stats_)
+        : ring (ring_), stopping (stopping_), capture (capture_), stats (stats_) {}
+
+    ReadStatus readSome (std::byte* dest, int maxBytes, int& numRead, bool midFragment) override
+    {
+        while (true)
+        {
+            const int ready = ring.waitUntilReady (READ_TIMEOUT_MS);
+
+            if (ready < 0)
+                return READ_ERROR;
+
+            if (ready == 0)
+            {
+                if (stopping || ! midFragment)
+                    return NO_DATA;
+
+                continue;
+            }
+
+            const int rc = ring.read (dest, maxBytes, false);
+            stats.recordRead (rc);
+
+            if (rc < 0)
+                return READ_ERROR;
+
+            if (rc == 0)
+                return STREAM_CLOSED;
+
+            capture.append (nowNs(), dest, rc);
+            numRead = rc;
+
+            return PACKET_READY;
+        }
+    }
+
+private:
+    SharedMemoryRing& ring;
+    const std::atomic<bool>& stopping;
+    CaptureWriter& capture;
+    StreamStats& stats;
+};
+
+/** Reads a stream capture, after serving the bytes already read to find the first header */
+class ReplayByteSource : public ByteSource
+{
+public:
+    ReplayByteSource (ReplaySource& replay_, const std::vector<std::byte>& prefix_) : replay (replay_), prefix (prefix_) {}
+
+    ReadStatus read (std::byte* dest, int numBytes, bool /*midFragment*/) override
+    {
+        const int fromPrefix = std::min (numBytes, (int) (prefix.size() - prefixRead));
+        std::memcpy (dest, prefix.data() + prefixRead, (size_t) fromPrefix);
+        prefixRead += (size_t) fromPrefix;
+
+        if (fromPrefix == numBytes)
+            return PACKET_READY;
+
+        const int rc = replay.read (dest + fromPrefix, numBytes - fromPrefix, true);
+
+        if (rc < 0)
+            return READ_ERROR;
+
+        return rc == numBytes - fromPrefix ? PACKET_READY : STREAM_CLOSED;
+    }
+
+private:
+    ReplaySource& replay;
+    const std::vector<std::byte>& prefix;
+    size_t prefixRead = 0;
+};
+
+/** One sender, receiver and converter, and what they measured */
+class StreamBenchmark
+{
+public:
+    StreamBenchmark (const BenchmarkConfig& config_, int index_) : config (config_), sender (config_), index (index_)
+    {
+        socket = INVALID_SOCKET_HANDLE;
+        stopping = false;
+        receiverDone = false;
+        priorityRaised = false;
+        pinned = false;
+
+        numConverted = 0;
+        numLost = 0;
+        nextSequence = 0;
+
+        receiverCpuSeconds = 0.0;
+        converterCpuSeconds = 0.0;
+    }
+
+    ~StreamBenchmark()
+    {
+        if (socket != INVALID_SOCKET_HANDLE && config.link != TCP_SERVER_LINK)
+            closeSocketHandle (socket);
+    }
+
+    bool start()
+    {
+        const int matrixSize = config.getMatrixSize();
+
+        const std::string localPath = config.link == UNIX_LINK ? "/tmp/ephys-socket-bench-" + std::to_string (getProcessId()) + "-" + std::to_string (index) + ".sock"
+                                                               : "/ephys-socket-bench-" + std::to_string (getProcessId()) + "-" + std::to_string (index);
+        const int port = sender.open (localPath);
+
+        if (port < 0)
+            return false;
+
+        sockaddr_in address = loopbackAddress (port);
+
+        if (config.link == UDP_LINK)
+        {
+            socket = ::socket (AF_INET, SOCK_DGRAM, 0);
+
+            const int bufferSize = 8 << 20; // Unthrottled senders overflow the default receive buffer
+            setsockopt (socket, SOL_SOCKET, SO_RCVBUF, (const char*) &bufferSize, sizeof (bufferSize));
+
+            if (bind (socket, (sockaddr*) &address, sizeof (address)) != 0)
+                return false;
+
+            sender.setDestinationPort (getBoundPort (socket));
+        }
+
+        if (config.link == TCP_SERVER_LINK)
+        {
+            if (! server.listen (std::string(), 0, 4 << 20))
+                return false;
+
+            sender.setDestinationPort (server.getPort());
+        }
+
+        if (! config.captureFile.empty())
+        {
+            const std::string path = config.numStreams > 1 ? config.captureFile + "." + std::to_string (index + 1) : config.captureFile;
+
+            if (! capture.open (path, config.link == UDP_LINK ? CAPTURE_DATAGRAMS : CAPTURE_STREAM))
+                return false;
+        }
+
+        const int headerSize = config.getHeaderSize();
+
+        packets.resize (config.queueSlots, matrixSize + headerSize, headerSize);
+        scratch.resize (matrixSize + headerSize);
+        datagram.resize (65536);
+
+        if (config.link == UDP_LINK && config.batchReads && headerSize + (config.fragmentSize > 0 ? std::min (config.fragmentSize, matrixSize) : matrixSize) <= DATAGRAM_BATCH_THRESHOLD)
+            datagrams.resize (DATAGRAM_BATCH_SIZE, std::min (65536, matrixSize + headerSize));
+        frameReader.reset (matrixSize, headerSize, config.layout);
+        frameReader.getAssembler().getCodec().setSimdLevel (config.simdLevel);
+        sequence.reset (1 << 30);
+        stats.reset (nowNs());
+        clock.reset (config.sampleRate > 0 ? config.sampleRate : 30000.0, config.numSamples);
+
+        const int packetsPerBatch = std::max (1, (int) (config.sampleRate * config.batchSeconds) / config.numSamples);
+        batch.prepare (config.depth, config.elementSize, config.numChannels, config.numSamples, config.layout, 0.195f, 32768.0f, config.sampleRate > 0 ? packetsPerBatch : packets.getNumSlots(), headerSize);
+        batch.getConverter().setSimdLevel (config.simdLevel);
+        batch.setDigitalRows (config.ttlRows, 0);
+
+        const int64_t expectedPackets = config.sampleRate > 0 ? (int64_t) (config.seconds * config.sampleRate / config.numSamples) : 1 << 20;
+        latenciesNs.reserve ((size_t) expectedPackets + 1024);
+
+        senderThread = std::thread ([this]
+                                    { sender.run(); });
+
+        if (config.link == TCP_LINK)
+        {
+            socket = ::socket (AF_INET, SOCK_STREAM, 0);
+
+            if (connect (socket, (sockaddr*) &address, sizeof (address)) != 0)
+                return false;
+
+            if (config.lowLatency)
+                setTcpNoDelay ((intptr_t) socket);
+        }
+
+        if (config.link == TCP_SERVER_LINK)
+        {
+            if (! server.accept (5000))
+                return false;
+
+            socket = (SocketHandle) server.getRawSocketHandle();
+
+            setTcpNoDelay ((intptr_t) socket);
+            setTcpKeepAlive ((intptr_t) socket, 5, 1);
+        }
+
+        if (config.link == UNIX_LINK && ! connectLocal (localPath))
+            return false;
+
+        if (config.link == SHM_LINK && ! ring.open (localPath))
+            return false;
+
+        receiverThread = std::thread ([this]
+                                      { receive(); });
+        converterThread = std::thread ([this]
+                                       { convert(); });
+
+        return true;
+    }
+
+    void stop()
+    {
+        sender.stop();
+        senderThread.join();
+
+        std::this_thread::sleep_for (std::chrono::milliseconds (100));
+        stopping = true;
+
+        receiverThread.join();
+        converterThread.join();
+
+        stats.finish (nowNs());
+        capture.close();
+    }
+
+    void report (int index, double seconds) const
+    {
+        const double matrixMB = config.getMatrixSize() / 1e6;
+
+        std::printf ("Stream %d: %lld sent, %lld converted, %lld lost, %lld dropped on a full queue\n",
+                     index + 1,
+                     (long long) sender.getNumSent(),
+                     (long long) numConverted,
+                     (long long) numLost,
+                     (long long) stats.getNumQueueFull());
+
+        std::printf ("  throughput: %.1f packets/s, %.2f MB/s, %.0f samples/s per channel\n",
+                     numConverted / seconds,
+                     numConverted * matrixMB / seconds,
+                     numConverted * (double) config.numSamples / seconds);
+
+        if (stats.getNumPackets() > 0)
+        {
+            const LatencyHistogram& jitter = stats.getJitter();
+
+            std::printf ("  receive calls: %lld, %.2f per packet\n",
+                         (long long) stats.getNumReads(),
+                         (double) stats.getNumReads() / stats.getNumPackets());
+
+            std::printf ("  queue: max %d of %d slots; conversion %.2f us per packet (max %.2f); jitter (us): p50 %.0f, p99 %.0f, max %.1f\n",
+                         stats.getMaxQueueDepth(),
+                         packets.getNumSlots(),
+                         stats.getMeanConversionUs(),
+                         stats.getMaxConversionUs(),
+                         jitter.getPercentileUs (0.5),
+                         jitter.getPercentileUs (0.99),
+                         jitter.getMaxUs());
+        }
+
+        if (! latenciesNs.empty())
+        {
+            std::vector<int64_t> sorted (latenciesNs);
+            std::sort (sorted.begin(), sorted.end());
+
+            const auto percentile = [&sorted] (double p)
+            { return sorted[std::min (sorted.size() - 1, (size_t) (p * sorted.size()))] / 1e3; };
+
+            std::printf ("  latency (us): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+                         percentile (0.5),
+                         percentile (0.9),
+                         percentile (0.99),
+                         percentile (0.999),
+                         sorted.back() / 1e3);
+
+            std::printf ("  receive to convert (us): p50 %.0f, p99 %.0f, max %.1f\n",
+                         receiveLatency.getPercentileUs (0.5),
+                         receiveLatency.getPercentileUs (0.99),
+                         receiveLatency.getMaxUs());
+        }
+
+        if (config.lowLatency)
+        {
+            std::printf ("  low latency: receiver at %s, %s\n",
+                         priorityRaised ? "real-time priority" : "normal priority (no real-time scheduling rights)",
+                         ! isPolling() ? "sleeping between packets" : pinned ? "polling on its own CPU" : "polling, but could not be pinned");
+        }
+
+        if (config.sampleRate > 0 && clock.isLocked())
+        {
+            std::printf ("  recovered clock: %.3f Hz (%.1f ppm), %lld relocks\n",
+                         clock.getSampleRate(),
+                         clock.getDriftPpm(),
+                         (long long) clock.getNumRelocks());
+        }
+
+        const PacketAssembler& assembler = frameReader.getAssembler();
+
+        if (assembler.getNumDropped() > 0 || assembler.getNumInvalid() > 0)
+        {
+            std::printf ("  reassembly: %lld incomplete matrices, %lld invalid and %lld corrupted fragments\n",
+                         (long long) assembler.getNumDropped(),
+                         (long long) assembler.getNumInvalid(),
+                         (long long) assembler.getNumChecksumErrors());
+        }
+
+        if (config.extendedHeader)
+        {
+            std::printf ("  sequence: %lld samples lost in %lld gaps, %lld duplicate and %lld late packets\n",
+                         (long long) sequence.getNumLostSamples(),
+                         (long long) sequence.getNumGaps(),
+                         (long long) sequence.getNumDuplicates(),
+                         (long long) sequence.getNumLate());
+        }
+
+        if (config.compress && assembler.getNumCompressedBytes() > 0)
+        {
+            std::printf ("  compression: %lld matrices decoded, at %.0f%% of raw; %lld sent raw\n",
+                         (long long) assembler.getNumDecompressed(),
+                         100.0 * assembler.getNumCompressedBytes() / ((double) assembler.getNumDecompressed() * config.getMatrixSize()),
+                         (long long) sender.getNumUncompressed());
+        }
+
+        if (config.link == TCP_SERVER_LINK)
+            std::printf ("  server: accepted the sender from %s\n", server.getPeerAddress().c_str());
+
+        if (capture.getNumRecords() > 0)
+        {
+            std::printf ("  capture: %lld reads, %.2f MB, %lld dropped\n",
+                         (long long) capture.getNumRecords(),
+                         capture.getNumBytes() / 1e6,
+                         (long long) capture.getNumDropped());
+        }
+
+        std::printf ("  CPU (%% of one core): receiver %.1f, converter %.1f, sender %.1f\n",
+                     100.0 * receiverCpuSeconds / seconds,
+                     100.0 * converterCpuSeconds / seconds,
+                     100.0 * sender.getCpuSeconds() / seconds);
+    }
+
+private:
+    /** Connects to the sender's Unix socket */
+    bool connectLocal (const std::string& path)
+    {
+#ifdef _WIN32
+        return false;
+#else
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof (address.sun_path))
+            return false;
+
+        std::memcpy (address.sun_path, path.c_str(), path.size() + 1);
+
+        socket = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+        return connect (socket, (sockaddr*) &address, sizeof (address)) == 0;
+#endif
+    }
+
+    /** Polling is only worth it, and only safe next to a real-time thread, on a CPU of its own */
+    bool isPolling() const { return config.lowLatency && config.cpu >= 0; }
+
+    /** Receives datagrams until a matrix is complete, like SocketThread::readDatagrams(): small ones in
+        batches, others one at a time into packet, in place unless a matrix is half-assembled */
+    ReadStatus readDatagram (std::byte* packet)
+    {
+        PacketAssembler& assembler = frameReader.getAssembler();
+
+        const std::byte* batched = nullptr;
+        int batchedSize = 0;
+
+        while (datagrams.next (batched, batchedSize))
+        {
+            if (assembler.addFragment (batched, batchedSize, packet))
+                return PACKET_READY;
+        }
+
+        const int ready = waitReadable (socket, isPolling());
+
+        if (ready <= 0)
+            return ready < 0 ? READ_ERROR : NO_DATA;
+
+        if (datagrams.getNumSlots() > 0)
+        {
+            const int received = datagrams.receive ((intptr_t) socket);
+
+            if (received < 0)
+                return READ_ERROR;
+
+            int numBytes = 0;
+
+            for (int i = 0; i < received; i++)
+            {
+                capture.append (nowNs(), datagrams.getData (i), datagrams.getSize (i));
+                numBytes += datagrams.getSize (i);
+            }
+
+            stats.recordRead (numBytes);
+
+            return NO_DATA;
+        }
+
+        std::byte* dest = assembler.isAssembling() ? datagram.data() : packet;
+        const int capacity = assembler.isAssembling() ? (int) datagram.size() : (int) scratch.size();
+
+        const int rc = recv (socket, (char*) dest, capacity, 0);
+        stats.recordRead (rc);
+
+        if (rc < 0)
+            return READ_ERROR;
+
+        capture.append (nowNs(), dest, rc);
+
+        return assembler.addFragment (dest, rc, packet) ? PACKET_READY : NO_DATA;
+    }
+
+    void receive()
+    {
+        const double cpuStart = getThreadCpuSeconds();
+
+        if (config.lowLatency)
+            priorityRaised = raiseThreadPriority();
+
+        if (config.cpu >= 0)
+            pinned = pinThreadToCpu (config.cpu + index);
+
+        SocketSource socketSource (socket, config.lowLatency && (config.link == TCP_LINK || config.link == TCP_SERVER_LINK), isPolling(), stopping, capture, stats);
+        RingSource ringSource (ring, stopping, capture, stats);
+
+        // Without a buffer, every read goes straight to the socket, one or more per header and payload.
+        // The ring is read straight into the queue anyway, as that is already a single copy.
+        StreamBuffer source;
+
+        if (config.link == SHM_LINK)
+            source.reset (&ringSource, 0);
+        else
+            source.reset (&socketSource, config.batchReads ? STREAM_BUFFER_SIZE : 0);
+
+        while (! stopping)
+        {
+            std::byte* packet = packets.beginWrite();
+            const bool queueFull = packet == nullptr;
+
+            if (queueFull)
+                packet = scratch.data();
+
+            const ReadStatus status = config.link == UDP_LINK ? readDatagram (packet) : frameReader.readPacket (source, packet);
+
+            if (status == PACKET_READY)
+            {
+                const int64_t arrivalNs = nowNs();
+
+                EphysSocketHeader header (packet);
+
+                if (header.parseExtension (packet))
+                {
+                    const SequenceTracker::Result order = sequence.check (header.sample_index, config.numSamples);
+
+                    if (order == SequenceTracker::DUPLICATE || order == SequenceTracker::LATE)
+                        continue;
+                }
+
+                const double firstSampleTime = clock.update (arrivalNs * 1e-9);
+
+                stats.recordPacket (arrivalNs, clock.getPacketPeriod());
+
+                if (queueFull)
+                {
+                    stats.recordQueueFull();
+                    continue;
+                }
+
+                PacketInfo& info = packets.getWriteInfo();
+                info.arrivalNs = arrivalNs;
+                info.firstSampleTime = firstSampleTime;
+                info.samplePeriod = clock.getSamplePeriod();
+                info.sampleIndex = header.sample_index;
+                info.senderTimeNs = header.sender_time_ns;
+
+                packets.finishWrite();
+                packetsReady.signal();
+            }
+            else if (status != NO_DATA)
+            {
+                break;
+            }
+        }
+
+        receiverCpuSeconds = getThreadCpuSeconds() - cpuStart;
+        receiverDone = true;
+        packetsReady.signal();
+    }
+
+    void convert()
+    {
+        const double cpuStart = getThreadCpuSeconds();
+
+        std::vector<int64_t> sendTimes (batch.getMaxPackets());
+        std::vector<int64_t> arrivals (batch.getMaxPackets());
+        int64_t lastConvertedAt = 0;
+
+        while (true)
+        {
+            const bool done = receiverDone; // Read before draining so the last packets aren't missed
+
+            const int numReady = std::min (packets.getNumReady(), batch.getMaxPackets());
+
+            // Read the stamps before the slots are released
+            for (int p = 0; p < numReady; p++)
+            {
+                int64_t stamp[2];
+                std::memcpy (stamp, packets.peek (p) + config.getHeaderSize(), sizeof (stamp));
+
+                if (stamp[0] > nextSequence)
+                    numLost += stamp[0] - nextSequence;
+
+                nextSequence = stamp[0] + 1;
+                sendTimes[p] = stamp[1];
+                arrivals[p] = packets.getReadInfo (p).arrivalNs;
+            }
+
+            if (numReady > 0)
+                stats.recordQueueDepth (packets.getNumReady());
+
+            const int64_t convertStart = nowNs();
+            const int numPackets = batch.convert (packets, numReady);
+
+            stats.recordConversion (numPackets, nowNs() - convertStart);
+
+            if (numPackets == 0)
+            {
+                if (done)
+                    break;
+
+                if (isPolling() && nowNs() - lastConvertedAt < LOW_LATENCY_SPIN_US * 1000)
+                    std::this_thread::yield();
+                else
+                    packetsReady.wait (PACKET_WAIT_MS);
+
+                continue;
+            }
+
+            const int64_t convertedAt = nowNs();
+            lastConvertedAt = convertedAt;
+
+            for (int p = 0; p < numPackets; p++)
+            {
+                latenciesNs.push_back (convertedAt - sendTimes[p]);
+                receiveLatency.record (convertedAt - arrivals[p]);
+            }
+
+            numConverted += numPackets;
+        }
+
+        converterCpuSeconds = getThreadCpuSeconds() - cpuStart;
+    }
+
+    const BenchmarkConfig& config;
+
+    LoopbackSender sender;
+    SocketHandle socket;
+    SharedMemoryRing ring;
+    TcpServer server;
+    int index;
+
+    CaptureWriter capture;
+
+    PacketRing packets;
+    FrameReader frameReader;
+    ClockRecovery clock;
+    SequenceTracker sequence;
+    BatchConverter batch;
+    Event packetsReady;
+
+    std::vector<std::byte> scratch;
+    std::vector<std::byte> datagram;
+    DatagramBatch datagrams;
+
+    std::thread senderThread;
+    std::thread receiverThread;
+    std::thread converterThread;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> receiverDone;
+
+    StreamStats stats;
+    int64_t numConverted;
+    int64_t numLost;
+    int64_t nextSequence;
+
+    std::vector<int64_t> latenciesNs;
+    LatencyHistogram receiveLatency;
+    std::atomic<bool> priorityRaised;
+    std::atomic<bool> pinned;
+
+    double receiverCpuSeconds;
+    double converterCpuSeconds;
+};
+
+struct DepthInfo
+{
+    const char* name;
+    Depth depth;
+    int elementSize;
+};
+
+const DepthInfo depths[] = {
+    { "u8", U8, 1 },
+    { "s8", S8, 1 },
+    { "u16", U16, 2 },
+    { "s16", S16, 2 },
+    { "s32", S32, 4 },
+    { "f32", F32, 4 },
+    { "f64", F64, 8 },
+};
+
+/** Runs a capture file through the framing, reassembly and conversion of one stream, as fast as possible */
+int runReplay (const BenchmarkConfig& config)
+{
+    ReplaySource replay;
+
+    if (! replay.open (config.replayFile, false))
+    {
+        std::printf ("Could not open capture file %s\n", config.replayFile.c_str());
+        return 1;
+    }
+
+    const bool datagrams = replay.getKind() == CAPTURE_DATAGRAMS;
+
+    // Find the first header as SocketThread::readFirstHeader does; its bytes are then replayed like the rest
+    std::vector<std::byte> prefix (datagrams ? 65536 : HEADER_SIZE + MAX_EXTENSION_SIZE);
+    int prefixSize = replay.read (prefix.data(), datagrams ? (int) prefix.size() : HEADER_SIZE, true);
+
+    if (! datagrams && prefixSize == HEADER_SIZE && EphysSocketHeader (prefix.data()).isExtended())
+    {
+        prefixSize += std::max (0, replay.read (prefix.data() + HEADER_SIZE, EXTENSION_PREAMBLE_SIZE, true));
+
+        const int extensionSize = EphysSocketHeader::getExtensionSize (prefix.data());
+
+        if (extensionSize > 0)
+            prefixSize += std::max (0, replay.read (prefix.data() + prefixSize, extensionSize - EXTENSION_PREAMBLE_SIZE, true));
+    }
+
+    prefix.resize (std::max (0, prefixSize));
+
+    EphysSocketHeader header;
+
+    if (prefix.size() >= HEADER_SIZE)
+        header = EphysSocketHeader (prefix.data());
+
+    if (prefix.size() < HEADER_SIZE || ! header.isValid() || (header.isExtended() && ! header.parseExtension (prefix.data())))
+    {
+        std::printf ("Capture file %s does not start with a valid header\n", config.replayFile.c_str());
+        return 1;
+    }
+
+    const int matrixSize = header.num_channels * header.num_samp * header.element_size;
+    const int headerSize = header.getSize();
+
+    std::printf ("Replaying %s: %s capture of %d channels x %d samples, depth %d (%d bytes)%s\n",
+                 config.replayFile.c_str(),
+                 datagrams ? "datagram" : "stream",
+                 header.num_channels,
+                 header.num_samp,
+                 (int) header.depth,
+                 header.element_size,
+                 header.isExtended() ? ", extended headers" : "");
+
+    PacketRing packets;
+    FrameReader frameReader;
+    BatchConverter batch;
+
+    packets.resize (config.queueSlots, matrixSize + headerSize, headerSize);
+    frameReader.reset (matrixSize, headerSize, config.layout);
+    frameReader.getAssembler().getCodec().setSimdLevel (config.simdLevel);
+    batch.prepare (header.depth, header.element_size, header.num_channels, header.num_samp, config.layout, 0.195f, 32768.0f, packets.getNumSlots(), headerSize);
+    batch.getConverter().setSimdLevel (config.simdLevel);
+    batch.setDigitalRows (header.ttl_rows > 0 ? header.ttl_rows : config.ttlRows, header.ttl_bits);
+
+    ReplayByteSource source (replay, prefix);
+    std::vector<std::byte> datagram (65536);
+    bool prefixUsed = false;
+
+    int64_t numPackets = 0;
+    int64_t numConverted = 0;
+    ReadStatus status = NO_DATA;
+
+    const double cpuStart = getThreadCpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+
+    while (status == NO_DATA || status == PACKET_READY)
+    {
+        std::byte* packet = packets.beginWrite();
+
+        if (packet == nullptr)
+        {
+            numConverted += batch.convert (packets, 0);
+            continue;
+        }
+
+        if (datagrams)
+        {
+            const std::byte* fragment = prefixUsed ? datagram.data() : prefix.data();
+            const int size = prefixUsed ? replay.read (datagram.data(), (int) datagram.size(), true) : (int) prefix.size();
+
+            prefixUsed = true;
+            status = size <= 0 ? STREAM_CLOSED : frameReader.getAssembler().addFragment (fragment, size, packet) ? PACKET_READY : NO_DATA;
+        }
+        else
+        {
+            status = frameReader.readPacket (source, packet);
+        }
+
+        if (status == PACKET_READY)
+        {
+            packets.finishWrite();
+            numPackets++;
+        }
+    }
+
+    while (packets.getNumReady() > 0)
+        numConverted += batch.convert (packets, 0);
+
+    const double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    const double cpuSeconds = getThreadCpuSeconds() - cpuStart;
+    const PacketAssembler& assembler = frameReader.getAssembler();
+
+    std::printf ("%lld records, %lld packets converted in %.3f s%s\n",
+                 (long long) replay.getNumRecords(),
+                 (long long) numConverted,
+                 seconds,
+                 status == INVALID_HEADER ? ", stopped at an invalid header" : status == READ_ERROR ? ", stopped at a read error" : "");
+
+    std::printf ("  throughput: %.1f packets/s, %.2f MB/s, %.0f samples/s per channel\n",
+                 numConverted / seconds,
+                 numConverted * (matrixSize / 1e6) / seconds,
+                 numConverted * (double) header.num_samp / seconds);
+
+    if (assembler.getNumDropped() > 0 || assembler.getNumInvalid() > 0)
+    {
+        std::printf ("  reassembly: %lld incomplete matrices, %lld invalid and %lld corrupted fragments\n",
+                     (long long) assembler.getNumDropped(),
+                     (long long) assembler.getNumInvalid(),
+                     (long long) assembler.getNumChecksumErrors());
+    }
+
+    std::printf ("  CPU (%% of one core): %.1f\n", 100.0 * cpuSeconds / seconds);
+
+    return status == INVALID_HEADER || status == READ_ERROR ? 1 : 0;
+}
+
+const char* getLinkName (SenderLink link)
+{
+    switch (link)
+    {
+        case UDP_LINK:
+            return "UDP";
+        case UNIX_LINK:
+            return "Unix socket";
+        case SHM_LINK:
+            return "shared memory";
+        case TCP_SERVER_LINK:
+            return "TCP, receiver listening";
+        default:
+            return "TCP";
+    }
+}
+
+/** Times DeltaCodec on the sender's signal, with and without SSE2, and checks that it round-trips */
+void measureDecoder (const BenchmarkConfig& config)
+{
+    const std::vector<std::byte> signal = LoopbackSender::makeSignal (config);
+
+    std::vector<std::byte> compressed ((size_t) DeltaCodec::getMaxCompressedSize (config.numChannels, config.numSamples));
+    std::vector<std::byte> decoded (signal.size());
+
+    const int size = DeltaCodec::encode (signal.data(), config.numChannels, config.numSamples, config.layout, compressed.data(), (int) compressed.size());
+
+    std::printf ("Compressed matrices of %d bytes, %.0f%% of raw; decoded at", size, 100.0 * size / signal.size());
+
+    DeltaCodec codec;
+
+    for (const SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2 })
+    {
+        codec.setSimdLevel (level);
+
+        if (codec.getSimdLevel() != level)
+            continue;
+
+        const int64_t start = nowNs();
+        int64_t numDecoded = 0;
+        bool valid = true;
+
+        do
+        {
+            valid = codec.decode (compressed.data(), size, config.numChannels, config.numSamples, config.layout, decoded.data()) && valid;
+            numDecoded++;
+        } while (nowNs() - start < 200000000);
+
+        const double seconds = (nowNs() - start) / 1e9;
+
+        std::printf ("%s %.0f MB/s (%s)%s",
+                     level == SimdLevel::SCALAR ? "" : ",",
+                     numDecoded * signal.size() / seconds / 1e6,
+                     level == SimdLevel::SCALAR ? "scalar" : "SSE2",
+                     valid && decoded == signal ? "" : " MISMATCH");
+    }
+
+    std::printf ("\n");
+}
+
+/** Times the Decimator on a batch of the converter's size, at every instruction set this CPU has */
+void measureDecimator (const BenchmarkConfig& config)
+{
+    const float rate = config.sampleRate > 0 ? config.sampleRate : 30000.0f;
+    const int numSamples = std::max (config.numSamples, (int) (rate * config.batchSeconds) / config.numSamples * config.numSamples);
+
+    std::vector<float> block ((size_t) config.numChannels * numSamples);
+    std::vector<double> timestamps (numSamples);
+    std::vector<uint64_t> ttlWords (numSamples, 0);
+
+    for (size_t i = 0; i < block.size(); i++)
+        block[i] = (float) ((i * 7919) % 1000) - 500.0f;
+
+    std::vector<float> output (block.size());
+    std::vector<double> outputTimestamps (numSamples);
+    std::vector<uint64_t> outputTtl (numSamples);
+
+    Decimator decimator;
+    decimator.prepare (config.decimation, config.numChannels, numSamples);
+
+    std::printf ("Decimated by %d to %.0f Hz (%d-sample delay); filtered at", decimator.getFactor(), rate / decimator.getFactor(), decimator.getDelay());
+
+    for (const SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 })
+    {
+        decimator.setSimdLevel (level);
+
+        if (decimator.getSimdLevel() != level)
+            continue;
+
+        const int64_t start = nowNs();
+        int64_t numFiltered = 0;
+
+        do
+        {
+            decimator.process (block.data(), numSamples, timestamps.data(), ttlWords.data(), numSamples, output.data(), outputTimestamps.data(), outputTtl.data());
+            numFiltered += numSamples;
+        } while (nowNs() - start < 200000000);
+
+        const double seconds = (nowNs() - start) / 1e9;
+
+        std::printf ("%s %.1fx real time (%s)",
+                     level == SimdLevel::SCALAR ? "" : ",",
+                     numFiltered / seconds / rate,
+                     DataConverter::getSimdLevelName (level));
+    }
+
+    std::printf ("\n");
+}
+
+void printUsage()
+{
+    std::printf ("Usage: EphysSocketBenchmark [options]\n"
+                 "  --channels <n>      channels per matrix (default 64)\n"
+                 "  --samples <n>       samples per matrix, num_samp (default 256)\n"
+                 "  --depth <type>      u8, s8, u16, s16, s32, f32 or f64 (default u16)\n"
+                 "  --rate <Hz>         sample rate per stream, 0 = as fast as possible (default 30000)\n"
+                 "  --seconds <s>       duration (default 5)\n"
+                 "  --streams <n>       parallel streams (default 1)\n"
+                 "  --transport <p>     tcp, udp, unix (Unix socket), shm (shared memory) or tcp-server (sender connects) (default tcp)\n"
+                 "  --fragment <bytes>  payload bytes per fragment, 0 = whole matrices (default 0)\n"
+                 "  --layout <l>        channel or interleaved (default channel)\n"
+                 "  --simd <level>      scalar, sse2, avx2 or avx512 (default: best supported)\n"
+                 "  --queue <slots>     packet queue slots per stream (default 1024)\n"
+                 "  --header <v>        v1, or v2 to add the sample index and send time (default v1)\n"
+                 "  --checksum <on|off> add a CRC32C of every payload to v2 headers (default off)\n"
+                 "  --ttl-rows <n>      rows at the end of each matrix decoded as TTL lines (default 0)\n"
+                 "  --low-latency <on|off> real-time receiver without delayed ACKs, polling if --cpu is set (default off)\n"
+                 "  --cpu <n>           pin stream receivers to CPUs n, n+1, ... (default: not pinned)\n"
+                 "  --batch <on|off>    read TCP in chunks and small datagrams in batches (default on)\n"
+                 "  --compress <on|off> send a neural-like signal in compressed matrices, u16 or s16 only (default off)\n"
+                 "  --decimate <n>      time the anti-aliasing decimator on batches at --rate, for an output rate n times lower (default 1, off)\n"
+                 "  --capture <file>    capture the bytes each stream receives (file.<n> for several streams)\n"
+                 "  --replay <file>     run a capture through the receive and convert path instead of a sender\n");
+}
+
+bool parseArguments (int argc, char** argv, BenchmarkConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string option = argv[i];
+
+        if (option == "--help" || i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+
+        if (option == "--channels")
+            config.numChannels = std::max (1, std::atoi (value.c_str()));
+        else if (option == "--samples")
+            config.numSamples = std::max (2, std::atoi (value.c_str()));
+        else if (option == "--rate")
+            config.sampleRate = (float) std::max (0.0, std::atof (value.c_str()));
+        else if (option == "--seconds")
+            config.seconds = std::max (0.1, std::atof (value.c_str()));
+        else if (option == "--streams")
+            config.numStreams = std::max (1, std::atoi (value.c_str()));
+        else if (option == "--transport")
+            config.link = value == "udp" ? UDP_LINK : value == "unix" ? UNIX_LINK : value == "shm" ? SHM_LINK : value == "tcp-server" ? TCP_SERVER_LINK : TCP_LINK;
+        else if (option == "--fragment")
+            config.fragmentSize = std::max (0, std::atoi (value.c_str()));
+        else if (option == "--layout")
+            config.layout = value == "interleaved" ? INTERLEAVED : CHANNEL_MAJOR;
+        else if (option == "--header")
+            config.extendedHeader = value == "v2";
+        else if (option == "--checksum")
+            config.checksum = value == "on";
+        else if (option == "--cpu")
+            config.cpu = std::atoi (value.c_str());
+        else if (option == "--low-latency")
+            config.lowLatency = value == "on";
+        else if (option == "--batch")
+            config.batchReads = value == "on";
+        else if (option == "--compress")
+            config.compress = value == "on";
+        else if (option == "--decimate")
+            config.decimation = std::max (1, std::min (Decimator::MAX_FACTOR, std::atoi (value.c_str())));
+        else if (option == "--capture")
+            config.captureFile = value;
+        else if (option == "--replay")
+            config.replayFile = value;
+        else if (option == "--ttl-rows")
+            config.ttlRows = std::max (0, std::atoi (value.c_str()));
+        else if (option == "--queue")
+            config.queueSlots = std::max (2, std::atoi (value.c_str()));
+        else if (option == "--simd")
+        {
+            const SimdLevel levels[] = { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+            const char* names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+            for (int l = 0; l < 4; l++)
+                if (value == names[l])
+                    config.simdLevel = levels[l];
+        }
+        else if (option == "--depth")
+        {
+            bool found = false;
+
+            for (const auto& info : depths)
+            {
+                if (value == info.name)
+                {
+                    config.depth = info.depth;
+                    config.elementSize = info.elementSize;
+                    found = true;
+                }
+            }
+
+            if (! found)
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (config.replayFile.empty() && config.getMatrixSize() < 16)
+    {
+        std::printf ("Matrices must hold at least 16 bytes for the sequence number and send time\n");
+        return false;
+    }
+
+    if (config.checksum)
+        config.extendedHeader = true;
+
+    if (config.compress)
+    {
+        if (! DeltaCodec::isSupported (config.depth, config.elementSize))
+        {
+            std::printf ("Only u16 and s16 matrices can be compressed\n");
+            return false;
+        }
+
+        config.fragmentSize = 0;
+
+        if (config.link == UDP_LINK && config.getMatrixSize() + config.getHeaderSize() > 65507)
+        {
+            std::printf ("Compressed matrices are sent whole, and one that doesn't compress must still fit in a datagram\n");
+            return false;
+        }
+    }
+
+    if (config.link == UDP_LINK && config.getFragmentSize() + config.getHeaderSize() > 65507)
+    {
+        config.fragmentSize = 8192;
+    }
+
+    return true;
+}
+} // namespace
+
+int main (int argc, char** argv)
+{
+    BenchmarkConfig config;
+
+    if (! parseArguments (argc, argv, config))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (! config.replayFile.empty())
+        return runReplay (config);
+
+    [[maybe_unused]] SocketLibrary socketLibrary;
+
+    std::printf ("%d stream(s) of %d channels x %d samples, depth %d (%d bytes), %s, %.0f Hz, %s, %s kernels\n",
+                 config.numStreams,
+                 config.numChannels,
+                 config.numSamples,
+                 (int) config.depth,
+                 config.elementSize,
+                 config.layout == INTERLEAVED ? "interleaved" : "channel-major",
+                 config.sampleRate,
+                 getLinkName (config.link),
+                 DataConverter::getSimdLevelName (std::min (config.simdLevel, DataConverter::getMaxSimdLevel())));
+
+    if (config.extendedHeader)
+        std::printf ("Extended headers%s\n", config.checksum ? (hasHardwareCrc32c() ? ", with hardware CRC32C checksums" : ", with software CRC32C checksums") : "");
+
+    if (config.ttlRows > 0)
+        std::printf ("Last %d row(s) decoded as TTL lines\n", config.ttlRows);
+
+    if (config.compress)
+        measureDecoder (config);
+
+    if (config.decimation > 1)
+        measureDecimator (config);
+
+    if (config.getFragmentSize() < config.getMatrixSize())
+        std::printf ("Matrices of %d bytes split into fragments of %d bytes\n", config.getMatrixSize(), config.getFragmentSize());
+
+    std::vector<std::unique_ptr<StreamBenchmark>> streams;
+
+    for (int i = 0; i < config.numStreams; i++)
+    {
+        streams.push_back (std::make_unique<StreamBenchmark> (config, i));
+
+        if (! streams.back()->start())
+        {
+            std::printf ("Could not open loopback sockets for stream %d\n", i + 1);
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for (std::chrono::duration<double> (config.seconds));
+
+    const double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+    for (auto& stream : streams)
+        stream->stop();
+
+    for (size_t i = 0; i < streams.size(); i++)
+        streams[i]->report ((int) i, seconds);
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include "LoopbackSender.h"
+#include "Crc32c.h"
+#include "DeltaCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+
+using namespace EphysSocketNode;
+
+LoopbackSender::LoopbackSender (const BenchmarkConfig& config_) : config (config_)
+{
+    listener = INVALID_SOCKET_HANDLE;
+    socket = INVALID_SOCKET_HANDLE;
+    destinationPort = 0;
+    wireSize = 0;
+
+    stopping = false;
+    numSent = 0;
+    cpuSeconds = 0.0;
+
+    numCompressedBytes = 0;
+    numUncompressed = 0;
+}
+
+LoopbackSender::~LoopbackSender()
+{
+    if (socket != INVALID_SOCKET_HANDLE)
+        closeSocketHandle (socket);
+
+    if (listener != INVALID_SOCKET_HANDLE)
+        closeSocketHandle (listener);
+
+#ifndef _WIN32
+    if (config.link == UNIX_LINK && ! localPath.empty())
+        unlink (localPath.c_str());
+#endif
+}
+
+int LoopbackSender::open (const std::string& localPath_)
+{
+    buildPacket();
+
+    localPath = localPath_;
+
+    sockaddr_in address = loopbackAddress (0);
+
+    if (config.link == UDP_LINK)
+    {
+        socket = ::socket (AF_INET, SOCK_DGRAM, 0);
+        return 0;
+    }
+
+    if (config.link == UNIX_LINK)
+        return listenLocal() ? 0 : -1;
+
+    if (config.link == TCP_SERVER_LINK)
+        return 0;
+
+    if (config.link == SHM_LINK)
+    {
+        return ring.create (localPath, std::max (8 << 20, (int) wire.size() * 64)) ? 0 : -1;
+    }
+
+    listener = ::socket (AF_INET, SOCK_STREAM, 0);
+
+    if (bind (listener, (sockaddr*) &address, sizeof (address)) != 0 || listen (listener, 1) != 0)
+        return -1;
+
+    return getBoundPort (listener);
+}
+
+bool LoopbackSender::listenLocal()
+{
+#ifdef _WIN32
+    return false;
+#else
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if (localPath.size() >= sizeof (address.sun_path))
+        return false;
+
+    std::memcpy (address.sun_path, localPath.c_str(), localPath.size() + 1);
+    unlink (localPath.c_str());
+
+    listener = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+    return bind (listener, (const sockaddr*) &address, sizeof (address)) == 0 && listen (listener, 1) == 0;
+#endif
+}
+
+bool LoopbackSender::connectToReceiver()
+{
+    sockaddr_in6 address6 {};
+    address6.sin6_family = AF_INET6;
+    address6.sin6_addr = in6addr_loopback;
+    address6.sin6_port = htons ((uint16_t) destinationPort);
+
+    socket = ::socket (AF_INET6, SOCK_STREAM, 0);
+
+    if (socket != INVALID_SOCKET_HANDLE && connect (socket, (const sockaddr*) &address6, sizeof (address6)) == 0)
+        return true;
+
+    if (socket != INVALID_SOCKET_HANDLE)
+        closeSocketHandle (socket);
+
+    sockaddr_in address = loopbackAddress (destinationPort);
+    socket = ::socket (AF_INET, SOCK_STREAM, 0);
+
+    return connect (socket, (const sockaddr*) &address, sizeof (address)) == 0;
+}
+
+void LoopbackSender::setDestinationPort (int port)
+{
+    destinationPort = port;
+}
+
+void LoopbackSender::buildPacket()
+{
+    const int matrixSize = config.getMatrixSize();
+    const int fragmentSize = config.getFragmentSize();
+    const int headerSize = config.getHeaderSize();
+
+    wire.clear();
+    fragmentStarts.clear();
+    fragmentHeaders.clear();
+
+    for (int offset = 0; offset < matrixSize; offset += fragmentSize)
+    {
+        EphysSocketHeader header (std::min (fragmentSize, matrixSize - offset), config.depth, config.elementSize, config.numSamples, config.numChannels);
+        header.offset = offset;
+
+        if (config.extendedHeader)
+        {
+            header.flags = FLAG_EXTENDED | (config.checksum ? FLAG_CHECKSUM : 0);
+            header.extension_size = EXTENSION_SIZE;
+            header.ttl_rows = config.ttlRows;
+        }
+
+        fragmentStarts.push_back (wire.size());
+        fragmentHeaders.push_back (header);
+        wire.resize (wire.size() + headerSize + header.num_bytes);
+
+        std::byte* fragment = wire.data() + fragmentStarts.back();
+        header.write (fragment);
+
+        for (int i = 0; i < header.num_bytes; i++)
+            fragment[headerSize + i] = (std::byte) ((offset + i) * 31);
+    }
+
+    wireSize = wire.size();
+
+    if (config.compress)
+        matrix = makeSignal (config);
+}
+
+std::vector<std::byte> LoopbackSender::makeSignal (const BenchmarkConfig& config)
+{
+    std::vector<std::byte> signal ((size_t) config.getMatrixSize());
+
+    std::mt19937 random (1234);
+    std::normal_distribution<float> noise (0.0f, 6.0f);
+
+    const float centre = config.depth == U16 ? 32768.0f : 0.0f;
+
+    for (int ch = 0; ch < config.numChannels; ch++)
+    {
+        const float amplitude = 400.0f + 40.0f * (ch % 8);
+        const float cycles = 8.0f + (float) (ch % 5);
+
+        for (int s = 0; s < config.numSamples; s++)
+        {
+            const float phase = 6.2831853f * cycles * s / config.numSamples;
+            const int value = (int) std::lround (centre + amplitude * std::sin (phase) + noise (random));
+            const uint16_t sample = (uint16_t) value;
+
+            const size_t index = config.layout == INTERLEAVED ? (size_t) s * config.numChannels + ch : (size_t) ch * config.numSamples + s;
+            std::memcpy (signal.data() + 2 * index, &sample, 2);
+        }
+    }
+
+    return signal;
+}
+
+void LoopbackSender::compressPacket (const int64_t* stamp)
+{
+    const int headerSize = config.getHeaderSize();
+    const int matrixSize = config.getMatrixSize();
+
+    EphysSocketHeader& header = fragmentHeaders[0];
+
+    std::memcpy (matrix.data(), stamp, 16);
+
+    const int size = DeltaCodec::encode (matrix.data(), config.numChannels, config.numSamples, config.layout, wire.data() + headerSize, matrixSize - 1);
+
+    if (size > 0)
+    {
+        header.num_bytes = size;
+        header.flags |= FLAG_COMPRESSED;
+        numCompressedBytes += size;
+    }
+    else
+    {
+        std::memcpy (wire.data() + headerSize, matrix.data(), (size_t) matrixSize);
+        header.num_bytes = matrixSize;
+        header.flags &= ~FLAG_COMPRESSED;
+        numUncompressed++;
+    }
+
+    wireSize = (size_t) (headerSize + header.num_bytes);
+    header.write (wire.data());
+}
+
+bool LoopbackSender::sendPacket()
+{
+    const int headerSize = config.getHeaderSize();
+
+    // Stamp the sequence number and send time into the first 16 bytes of the matrix
+    const int64_t stamp[2] = { numSent.load(), nowNs() };
+
+    if (config.compress)
+        compressPacket (stamp);
+    else
+        std::memcpy (wire.data() + headerSize, stamp, sizeof (stamp));
+
+    if (config.extendedHeader)
+    {
+        const int64_t sendTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::system_clock::now().time_since_epoch()).count();
+
+        for (size_t f = 0; f < fragmentStarts.size(); f++)
+        {
+            EphysSocketHeader& header = fragmentHeaders[f];
+            std::byte* fragment = wire.data() + fragmentStarts[f];
+
+            header.sample_index = numSent.load() * config.numSamples;
+            header.sender_time_ns = sendTimeNs;
+
+            if (config.checksum)
+                header.checksum = crc32c (fragment + headerSize, (size_t) header.num_bytes);
+
+            header.write (fragment);
+        }
+    }
+
+    if (config.link == UDP_LINK)
+    {
+        const sockaddr_in address = loopbackAddress (destinationPort);
+
+        for (size_t f = 0; f < fragmentStarts.size(); f++)
+        {
+            const size_t end = f + 1 < fragmentStarts.size() ? fragmentStarts[f + 1] : wireSize;
+
+            sendto (socket, (const char*) wire.data() + fragmentStarts[f], (int) (end - fragmentStarts[f]), 0, (const sockaddr*) &address, sizeof (address));
+        }
+
+        return true;
+    }
+
+    if (config.link == SHM_LINK)
+    {
+        // Waits for room rather than dropping, like a blocking send, so an unthrottled run measures the receiver
+        std::byte* dest = nullptr;
+
+        while ((dest = ring.beginWrite ((int) wireSize)) == nullptr)
+        {
+            if (stopping)
+                return false;
+
+            std::this_thread::yield();
+        }
+
+        std::memcpy (dest, wire.data(), wireSize);
+        ring.finishWrite ((int) wireSize);
+
+        return true;
+    }
+
+    size_t sent = 0;
+
+    while (sent < wireSize)
+    {
+        const int rc = send (socket, (const char*) wire.data() + sent, (int) (wireSize - sent), 0);
+
+        if (rc <= 0)
+            return false;
+
+        sent += rc;
+    }
+
+    return true;
+}
+
+void LoopbackSender::run()
+{
+    const double cpuStart = getThreadCpuSeconds();
+
+    if (config.link == TCP_SERVER_LINK && ! connectToReceiver())
+        return;
+
+    if (config.link == TCP_LINK || config.link == UNIX_LINK || config.link == TCP_SERVER_LINK)
+    {
+        if (config.link != TCP_SERVER_LINK)
+            socket = accept (listener, nullptr, nullptr);
+
+        const int noDelay = 1;
+
+        if (config.link != UNIX_LINK)
+            setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof (noDelay));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> interval (config.sampleRate > 0 ? config.numSamples / config.sampleRate : 0.0);
+
+    while (! stopping)
+    {
+        if (config.sampleRate > 0)
+            std::this_thread::sleep_until (start + std::chrono::duration_cast<std::chrono::steady_clock::duration> (interval * (double) numSent.load()));
+
+        if (! sendPacket())
+            break;
+
+        numSent++;
+    }
+
+    cpuSeconds = getThreadCpuSeconds() - cpuStart;
+
+    if (config.link == TCP_LINK || config.link == UNIX_LINK || config.link == TCP_SERVER_LINK)
+    {
+        closeSocketHandle (socket);
+        socket = INVALID_SOCKET_HANDLE;
+    }
+
+    if (config.link == SHM_LINK)
+        ring.close();
+}
@@ -0,0 +1,108 @@
+#ifndef __LOOPBACKSENDERH__
+#define __LOOPBACKSENDERH__
+
+#include "BenchmarkSockets.h"
+#include "EphysSocketHeader.h"
+#include "BenchmarkConfig.h"
+#include "SharedMemoryRing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/**
+    Emits the EphysSocket wire format over loopback, a Unix socket or a
+    shared-memory ring, at a fixed packet rate or as fast as it is accepted.
+
+    The first 16 bytes of every matrix hold the packet's sequence number and
+    the steady_clock time it was sent, so the receiver can measure end-to-end
+    latency and count lost packets without any side channel. With an extended
+    header, the sample index, send time and checksum are filled in per packet too.
+
+    When compressing, every matrix is compressed with DeltaCodec as it is sent,
+    which is what a real sender would do, from a signal with the spectrum of a
+    recording (slow oscillations, a little noise) rather than an arbitrary pattern.
+*/
+class LoopbackSender
+{
+public:
+    /** Constructor */
+    LoopbackSender (const BenchmarkConfig& config);
+
+    /** Destructor */
+    ~LoopbackSender();
+
+    /** Opens the listening (TCP, Unix) or sending (UDP) socket, or creates the shared-memory ring.
+        Returns the TCP port the receiver must use, 0 for the other links or -1 on an error.
+        localPath is the Unix socket file or ring name to create. */
+    int open (const std::string& localPath = std::string());
+
+    /** For UDP and the TCP server link, sets the port the receiver is bound to */
+    void setDestinationPort (int port);
+
+    /** Sends packets until stop() is called; runs on its own thread */
+    void run();
+
+    /** Makes run() return */
+    void stop() { stopping = true; }
+
+    /** Returns the number of packets sent */
+    int64_t getNumSent() const { return numSent; }
+
+    /** CPU time used by run(), in seconds */
+    double getCpuSeconds() const { return cpuSeconds; }
+
+    /** Returns the payload bytes of the compressed matrices sent, and how many were sent raw because they didn't compress */
+    int64_t getNumCompressedBytes() const { return numCompressedBytes; }
+    int64_t getNumUncompressed() const { return numUncompressed; }
+
+    /** Fills a matrix in the configured layout with a signal shaped like an extracellular recording */
+    static std::vector<std::byte> makeSignal (const BenchmarkConfig& config);
+
+private:
+    /** Opens the Unix socket listening on localPath */
+    bool listenLocal();
+
+    /** Connects to the receiver listening on destinationPort, over IPv6 loopback if there is one */
+    bool connectToReceiver();
+
+    /** Lays out every fragment of one matrix, each with its header, back to back */
+    void buildPacket();
+
+    /** Stamps the raw matrix and compresses it into the only fragment, or copies it there raw if it doesn't compress */
+    void compressPacket (const int64_t* stamp);
+
+    /** Sends one matrix; returns false if the connection broke */
+    bool sendPacket();
+
+    const BenchmarkConfig& config;
+
+    SocketHandle listener;
+    SocketHandle socket;
+    int destinationPort;
+
+    std::string localPath;
+    SharedMemoryRing ring;
+
+    /** Fragments of one matrix, where each one starts in wire, and how much of wire is sent */
+    std::vector<std::byte> wire;
+    std::vector<size_t> fragmentStarts;
+    std::vector<EphysSocketHeader> fragmentHeaders;
+    size_t wireSize;
+
+    /** Raw matrix that is compressed into wire for every packet */
+    std::vector<std::byte> matrix;
+
+    std::atomic<bool> stopping;
+    std::atomic<int64_t> numSent;
+    double cpuSeconds;
+
+    int64_t numCompressedBytes;
+    int64_t numUncompressed;
+};
+} // namespace EphysSocketNode
+
+#endif
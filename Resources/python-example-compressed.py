@@ -0,0 +1,132 @@
+import socket
+import time
+
+import numpy as np
+
+# ---- SPECIFY THE SIGNAL PROPERTIES ---- #
+totalDuration = 10   # the total duration of the signal
+numChannels = 64     # number of channels to send
+numSamples = 256     # size of the data buffer
+Freq = 30000         # sample rate of the signal
+amplitude = 400      # peak of the test oscillation, in bits
+noiseLevel = 6       # standard deviation of the noise floor, in bits
+
+# ---- DEFINE HEADER VALUES ---- #
+headerSize  = 22 # Specifies that there are 22 bytes in the header
+offset      = 0 # Compressed matrices are never fragmented
+dataType    = 2 # U16; only U16 and S16 matrices can be compressed
+elementSize = 2 # Number of bytes per element
+FLAG_COMPRESSED = 0x04 # Header flag (high byte of the data type) marking a compressed payload
+bytesPerBuffer = numChannels * numSamples * elementSize
+
+def makeHeader(numBytes, flags):
+    return np.array([offset, numBytes], dtype='<i4').tobytes() + \
+           np.array([dataType | (flags << 8)], dtype='<i2').tobytes() + \
+           np.array([elementSize, numChannels, numSamples], dtype='<i4').tobytes()
+
+# ---- REFERENCE ENCODER ---- #
+# Channels are coded in groups of 8 and samples in blocks of 16, as described in
+# Source/Core/DeltaCodec.h: per group, sample 0 of its channels, then for every
+# block a bit width and the zigzag-coded differences between samples, bit-packed.
+GROUP_CHANNELS = 8
+BLOCK_SAMPLES = 16
+
+def compressMatrix(matrix):
+    """Compresses a (channels, samples) uint16 matrix; the receiver restores it in the stream's layout"""
+    channels, samples = matrix.shape
+    numGroups = -(-channels // GROUP_CHANNELS)
+    numBlocks = -(-(samples - 1) // BLOCK_SAMPLES)
+
+    # Padding channels are zeros, and padding samples repeat the last one, so both code as zero deltas
+    padded = np.zeros((numGroups * GROUP_CHANNELS, 1 + numBlocks * BLOCK_SAMPLES), dtype=np.uint16)
+    padded[:channels, :samples] = matrix
+    padded[:channels, samples:] = matrix[:, -1:]
+
+    deltas = np.diff(padded, axis=1) # wraps around, like the 16-bit arithmetic of the decoder
+    codes = ((deltas << 1) ^ ((deltas >> 15) * 0xffff)).astype(np.uint16)
+    blocks = codes.reshape(numGroups, GROUP_CHANNELS, numBlocks, BLOCK_SAMPLES).transpose(0, 2, 3, 1) # group, block, sample, lane
+
+    payload = bytearray()
+
+    for g in range(numGroups):
+        payload += padded[g * GROUP_CHANNELS:(g + 1) * GROUP_CHANNELS, 0].astype('<u2').tobytes()
+
+        for b in range(numBlocks):
+            block = blocks[g, b]
+            width = int(block.max()).bit_length()
+            payload.append(width)
+
+            if width > 0:
+                # Bit t * width + j of every lane is bit j of the lane's sample t
+                bits = (block[:, :, None] >> np.arange(width, dtype=np.uint16)) & 1
+                bits = bits.transpose(1, 0, 2).reshape(GROUP_CHANNELS, width, 16).astype(np.uint32)
+                words = (bits << np.arange(16, dtype=np.uint32)).sum(axis=2)
+                payload += words.T.astype('<u2').tobytes()
+
+    return bytes(payload)
+
+# ---- GENERATE THE DATA ---- #
+t = np.arange(totalDuration * Freq) / Freq
+cycles = 8 + np.arange(numChannels) % 5 # a slow oscillation per channel, like an LFP
+allData = 32768 + amplitude * np.sin(2 * np.pi * cycles[:, None] * t) + np.random.normal(0, noiseLevel, (numChannels, len(t)))
+allData = np.clip(np.round(allData), 0, 65535).astype(np.uint16) # channels x samples
+
+# ---- COMPUTE SOME USEFUL VALUES ---- #
+buffersPerSecond = Freq / numSamples
+bufferInterval = 1 / buffersPerSecond
+
+# ---- WAIT FOR USER INPUT ---- #
+value = input("Press enter key to start...")
+
+# ---- CREATE THE SOCKET SERVER ---- #
+tcpServer = socket.socket(family=socket.AF_INET, type=socket.SOCK_STREAM)
+tcpServer.bind(('localhost', 9001))
+tcpServer.listen(1)
+
+print("Waiting for external connection to start...")
+(tcpClient, address) = tcpServer.accept()
+print("Connected.")
+
+# Send every buffer right away instead of holding small ones back to coalesce them
+tcpClient.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+print("Starting transmission")
+
+def currentTime():
+    return time.time_ns() / (10 ** 9)
+
+# ---- STREAM DATA ---- #
+sentBytes = 0
+rawBytes = 0
+
+try:
+    for start in range(0, allData.shape[1] - numSamples + 1, numSamples):
+        t1 = currentTime()
+
+        matrix = allData[:, start:start + numSamples]
+        payload = compressMatrix(matrix)
+
+        # A matrix that doesn't come out smaller is sent raw (channels x samples), with the flag clear
+        if len(payload) < bytesPerBuffer:
+            tcpClient.sendall(makeHeader(len(payload), FLAG_COMPRESSED) + payload)
+        else:
+            payload = matrix.astype('<u2').tobytes()
+            tcpClient.sendall(makeHeader(len(payload), 0) + payload)
+
+        sentBytes += len(payload)
+        rawBytes += bytesPerBuffer
+
+        t2 = currentTime()
+
+        while ((t2 - t1) < bufferInterval):
+            t2 = currentTime()
+
+    print("Done, sent %.0f%% of the raw size" % (100 * sentBytes / rawBytes))
+except BrokenPipeError:
+    print("Connection closed by the server. Unable to send data. Exiting...")
+
+except ConnectionAbortedError:
+    print("Connection was aborted, unable to send data. Try disconnecting and reconnecting the remote client. Exiting...")
+
+except ConnectionResetError:
+    print("Connection was aborted, unable to send data. Try disconnecting and reconnecting the remote client. Exiting...")
@@ -1,3 +1,4 @@
+import os
 import socket
 import time
 
@@ -11,6 +12,10 @@ Freq = 30000         # sample rate of the signal
 testingValue1 = 100  # high value
 testingValue2= -100  # low value
 
+# ---- SPECIFY THE TRANSPORT ---- #
+unixSocketPath = None # e.g. '/tmp/ephys-socket-9001.sock' to serve a Unix socket on this machine instead of TCP
+pluginHost = None     # e.g. 'localhost' or '::1' to connect to the plugin in TCP server mode instead of listening
+
 # ---- DEFINE HEADER VALUES ---- #
 headerSize  = 22 # Specifies that there are 22 bytes in the header
 offset      = 0 # Offset of bytes in this packet; only used for buffers > ~64 kB
@@ -42,14 +47,34 @@ allData = np.tile(oneCycle, (numChannels, totalDuration)).T
 value = input("Press enter key to start...")
 
 # ---- CREATE THE SOCKET SERVER ---- #
-tcpServer = socket.socket(family=socket.AF_INET, type=socket.SOCK_STREAM)
-tcpServer.bind(('localhost', 9001))
-tcpServer.listen(1)
-
-print("Waiting for external connection to start...")
-(tcpClient, address) = tcpServer.accept()
+if pluginHost is not None:
+    # Retry until the plugin is listening and accepts the connection
+    print("Connecting to the plugin...")
+    while True:
+        try:
+            tcpClient = socket.create_connection((pluginHost, 9001))
+            break
+        except OSError:
+            time.sleep(0.1)
+else:
+    if unixSocketPath is None:
+        tcpServer = socket.socket(family=socket.AF_INET, type=socket.SOCK_STREAM)
+        tcpServer.bind(('localhost', 9001))
+    else:
+        if os.path.exists(unixSocketPath):
+            os.remove(unixSocketPath) # a socket file left behind by an earlier run
+        tcpServer = socket.socket(family=socket.AF_UNIX, type=socket.SOCK_STREAM)
+        tcpServer.bind(unixSocketPath)
+    tcpServer.listen(1)
+
+    print("Waiting for external connection to start...")
+    (tcpClient, address) = tcpServer.accept()
 print("Connected.")
 
+# Send every buffer right away instead of holding small ones back to coalesce them
+if unixSocketPath is None or pluginHost is not None:
+    tcpClient.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
 # ---- CONVERT DATA TO BYTES ---- #
 bytesToSend = allData.flatten().tobytes()
 totalBytes = len(bytesToSend)
@@ -64,7 +89,7 @@ def currentTime():
 try:
     while (bufferIndex < totalBytes):
         t1 = currentTime()
-        rc = tcpClient.sendto(header + bytesToSend[bufferIndex:bufferIndex+bytesPerBuffer], address)
+        tcpClient.sendall(header + bytesToSend[bufferIndex:bufferIndex+bytesPerBuffer])
         t2 = currentTime()
         
         while ((t2 - t1) < bufferInterval):
@@ -0,0 +1,74 @@
+import socket
+import sys
+import time
+
+import numpy as np
+
+# ---- SPECIFY THE SIGNAL PROPERTIES ---- #
+totalDuration = 10   # the total duration of the signal
+numChannels = 64     # number of channels to send
+numSamples = 1000    # size of the data buffer
+Freq = 30000         # sample rate of the signal
+testingValue1 = 100  # high value
+testingValue2= -100  # low value
+
+# ---- SPECIFY THE DESTINATION ---- #
+# Pass a multicast group (e.g. 239.0.0.1) as the first argument and set the same
+# group in the plugin to let several GUI instances receive the stream
+destination = sys.argv[1] if len(sys.argv) > 1 else 'localhost'
+port = 9001
+
+# ---- DEFINE HEADER VALUES ---- #
+headerSize  = 22 # Specifies that there are 22 bytes in the header
+maxPayload  = 8192 # Matrix bytes per datagram; larger matrices are split using the offset field
+dataType    = 2 # Enumeration value based on OpenCV.Mat data types
+elementSize = 2 # Number of bytes per element. elementSize = 2 for U16
+# Data types:   [ U8, S8, U16, S16, S32, F32, F64 ]
+# Enum value:   [  0,  1,   2,   3,   4,   5,   6 ]
+# Element Size: [  1,  1,   2,   2,   4,   4,   8 ]
+bytesPerBuffer = numChannels * numSamples * elementSize
+
+def header(offset, numBytes):
+    return np.array([offset, numBytes], dtype='i4').tobytes() + \
+           np.array([dataType], dtype='i2').tobytes() + \
+           np.array([elementSize, numChannels, numSamples], dtype='i4').tobytes()
+
+# ---- COMPUTE SOME USEFUL VALUES ---- #
+buffersPerSecond = Freq / numSamples
+bufferInterval = 1 / buffersPerSecond
+
+# ---- GENERATE THE DATA ---- #
+OpenEphysOffset = 100
+convertedValue1 = OpenEphysOffset+(testingValue1)
+convertedValue2 = OpenEphysOffset+(testingValue2)
+intList_1 = (np.ones((int(Freq/2),)) * convertedValue1).astype('uint16') # if dataType == 2, use astype('uint16')
+intList_2 = (np.ones((int(Freq/2),)) * convertedValue2).astype('uint16')
+oneCycle = np.concatenate((intList_1, intList_2))
+allData = np.tile(oneCycle, (numChannels, totalDuration))
+
+# ---- CREATE THE SOCKET ---- #
+udpSender = socket.socket(family=socket.AF_INET, type=socket.SOCK_DGRAM)
+udpSender.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+
+def currentTime():
+    return time.time_ns() / (10 ** 9)
+
+print("Starting transmission to " + destination + ":" + str(port))
+
+# ---- STREAM DATA ---- #
+for start in range(0, allData.shape[1] - numSamples + 1, numSamples):
+    t1 = currentTime()
+
+    # Each matrix is channels x samples, split into datagrams that each carry the header
+    bytesToSend = allData[:, start:start+numSamples].tobytes()
+
+    for offset in range(0, bytesPerBuffer, maxPayload):
+        payload = bytesToSend[offset:offset+maxPayload]
+        udpSender.sendto(header(offset, len(payload)) + payload, (destination, port))
+
+    t2 = currentTime()
+
+    while ((t2 - t1) < bufferInterval):
+        t2 = currentTime()
+
+print("Done")
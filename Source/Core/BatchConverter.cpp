@@ -0,0 +1,135 @@
+#include "BatchConverter.h"
+
+#include <algorithm>
+
+using namespace EphysSocketNode;
+
+BatchConverter::BatchConverter()
+{
+    headerSize = HEADER_SIZE;
+    elementSize = 2;
+    numChannels = 0;
+    numSamples = 0;
+    layout = CHANNEL_MAJOR;
+    scale = 1.0f;
+    offset = 0.0f;
+
+    uniform = true;
+
+    maxPackets = 1;
+    numSamplesConverted = 0;
+
+    ttlState = 0;
+    numTtlEdges = 0;
+}
+
+void BatchConverter::prepare (Depth depth, int elementSize_, int numChannels_, int numSamples_, Layout layout_, float scale_, float offset_, int maxPackets_, int headerSize_)
+{
+    headerSize = headerSize_;
+    elementSize = elementSize_;
+    numChannels = numChannels_;
+    numSamples = numSamples_;
+    layout = layout_;
+    scale = scale_;
+    offset = offset_;
+
+    scales.assign (numChannels, scale);
+    offsets.assign (numChannels, offset);
+    uniform = true;
+
+    maxPackets = std::max (1, maxPackets_);
+    numSamplesConverted = 0;
+
+    data.resize ((size_t) numChannels * numSamples * maxPackets);
+    timestamps.assign ((size_t) numSamples * maxPackets, 0.0);
+    ttlWords.assign ((size_t) numSamples * maxPackets, 0);
+
+    ttlState = 0;
+    numTtlEdges = 0;
+
+    converter.setDepth (depth);
+    ttl.prepare (depth, elementSize, numChannels, numSamples, layout, 0, 0);
+}
+
+void BatchConverter::setChannelScales (const std::vector<float>& scales_, const std::vector<float>& offsets_)
+{
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        scales[ch] = ch < (int) scales_.size() ? scales_[ch] : scale;
+        offsets[ch] = ch < (int) offsets_.size() ? offsets_[ch] : offset;
+    }
+
+    uniform = std::all_of (scales.begin(), scales.end(), [this] (float s)
+                           { return s == scale; })
+              && std::all_of (offsets.begin(), offsets.end(), [this] (float o)
+                              { return o == offset; });
+}
+
+void BatchConverter::setDigitalRows (int numRows, int bitsPerRow)
+{
+    ttl.prepare (converter.getDepth(), elementSize, numChannels, numSamples, layout, numRows, bitsPerRow);
+}
+
+void BatchConverter::convertPacket (const std::byte* packet, float* dest, int destStride) const
+{
+    const std::byte* matrix = packet + headerSize;
+
+    if (layout == INTERLEAVED)
+    {
+        converter.convertInterleaved (matrix, numChannels, numSamples, dest, destStride, scales.data(), offsets.data());
+        return;
+    }
+
+    const int numAnalogChannels = getNumAnalogChannels();
+
+    if (destStride == numSamples && uniform)
+    {
+        converter.convert (matrix, dest, numAnalogChannels * numSamples, scale, offset);
+        return;
+    }
+
+    const size_t rowBytes = (size_t) numSamples * elementSize;
+
+    // Every row is one run of samples, so each gets its own channel's scale and offset
+    for (int ch = 0; ch < numAnalogChannels; ch++)
+    {
+        converter.convert (matrix + ch * rowBytes, dest + (size_t) ch * destStride, numSamples, scales[ch], offsets[ch]);
+    }
+}
+
+int BatchConverter::convert (PacketRing& packets, int maxPackets_)
+{
+    int numPackets = std::min (packets.getNumReady(), maxPackets);
+
+    if (maxPackets_ > 0)
+    {
+        numPackets = std::min (numPackets, maxPackets_);
+    }
+
+    // The DataBuffer expects each channel's samples to be contiguous, so packets are laid out side by side in every row
+    numSamplesConverted = numPackets * numSamples;
+
+    ttl.setSimdLevel (converter.getSimdLevel());
+
+    for (int p = 0; p < numPackets; p++)
+    {
+        convertPacket (packets.beginRead(), data.data() + (size_t) p * numSamples, numSamplesConverted);
+
+        const PacketInfo& info = packets.getReadInfo();
+        double* packetTimestamps = timestamps.data() + (size_t) p * numSamples;
+
+        for (int i = 0; i < numSamples; i++)
+            packetTimestamps[i] = info.firstSampleTime + i * info.samplePeriod;
+
+        uint64_t* packetTtlWords = ttlWords.data() + (size_t) p * numSamples;
+
+        if (ttl.getNumRows() > 0)
+            numTtlEdges += ttl.decode (packets.beginRead() + headerSize, packetTtlWords, ttlState);
+        else
+            std::fill (packetTtlWords, packetTtlWords + numSamples, ttlState);
+
+        packets.finishRead();
+    }
+
+    return numPackets;
+}
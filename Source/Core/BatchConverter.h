@@ -0,0 +1,109 @@
+#ifndef __BATCHCONVERTERH__
+#define __BATCHCONVERTERH__
+
+#include "DataConverter.h"
+#include "PacketRing.h"
+#include "TtlDecoder.h"
+
+#include <vector>
+
+namespace EphysSocketNode
+{
+/**
+    Converts queued packets (header + matrix) into one block of scaled floats,
+    laid out the way a DataBuffer expects it: one contiguous row of samples per
+    channel, with the packets side by side in every row.
+
+    Every sample also gets a timestamp, interpolated from the recovered clock
+    the receiver stored with its packet, and a TTL word decoded from the
+    digital rows of the matrix, if it has any. Digital rows are the last rows
+    of the block; only the analog rows before them are converted when the
+    layout allows it.
+
+    Channels can each have their own scale and offset, which the conversion
+    kernels apply as they convert, so no second pass over the block is needed.
+*/
+class BatchConverter
+{
+public:
+    /** Constructor */
+    BatchConverter();
+
+    /** Describes the incoming matrices, and the header in front of each one, and allocates room for up to maxPackets per batch */
+    void prepare (Depth depth, int elementSize, int numChannels, int numSamples, Layout layout, float scale, float offset, int maxPackets, int headerSize = HEADER_SIZE);
+
+    /** Sets the scale and offset of every channel (numChannels each), overriding the ones given to prepare().
+        Call after prepare(). */
+    void setChannelScales (const std::vector<float>& scales, const std::vector<float>& offsets);
+
+    /** Treats the last numRows channels as digital rows of bitsPerRow lines (0 = element width).
+        Call after prepare(); 0 rows disables TTL decoding. */
+    void setDigitalRows (int numRows, int bitsPerRow);
+
+    /** Returns the number of analog channels in front of the digital rows */
+    int getNumAnalogChannels() const { return numChannels - ttl.getNumRows(); }
+
+    /** Returns the number of digital lines decoded into the TTL words */
+    int getNumTtlLines() const { return ttl.getNumLines(); }
+
+    /** Converts up to maxPackets queued packets (0 = as many as fit) and releases their slots.
+        Returns the number of packets converted. */
+    int convert (PacketRing& packets, int maxPackets);
+
+    /** Converts one packet into a block whose channel rows start destStride samples apart */
+    void convertPacket (const std::byte* packet, float* dest, int destStride) const;
+
+    /** Returns the block converted by the last call to convert() */
+    float* getData() { return data.data(); }
+
+    /** Returns the timestamp of every sample converted by the last call to convert(), in seconds */
+    double* getTimestamps() { return timestamps.data(); }
+
+    /** Returns the TTL word of every sample converted by the last call to convert() */
+    uint64_t* getTtlWords() { return ttlWords.data(); }
+
+    /** Returns the TTL word of the last sample converted so far */
+    uint64_t getTtlState() const { return ttlState; }
+
+    /** Returns the number of samples whose TTL word changed since prepare() */
+    int64_t getNumTtlEdges() const { return numTtlEdges; }
+
+    /** Returns the number of samples per channel converted by the last call to convert() */
+    int getNumSamples() const { return numSamplesConverted; }
+
+    /** Returns the maximum number of packets converted per batch */
+    int getMaxPackets() const { return maxPackets; }
+
+    /** Returns the sample converter, e.g. to cap its instruction set */
+    DataConverter& getConverter() { return converter; }
+
+private:
+    DataConverter converter;
+    TtlDecoder ttl;
+
+    int headerSize;
+    int elementSize;
+    int numChannels;
+    int numSamples;
+    Layout layout;
+    float scale;
+    float offset;
+
+    /** Per-channel scales and offsets; uniform when every channel uses scale and offset */
+    std::vector<float> scales;
+    std::vector<float> offsets;
+    bool uniform;
+
+    int maxPackets;
+    int numSamplesConverted;
+
+    std::vector<float> data;
+    std::vector<double> timestamps;
+    std::vector<uint64_t> ttlWords;
+
+    uint64_t ttlState;
+    int64_t numTtlEdges;
+};
+} // namespace EphysSocketNode
+
+#endif
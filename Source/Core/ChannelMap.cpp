@@ -0,0 +1,163 @@
+#include "ChannelMap.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+std::string trim (const std::string& text)
+{
+    const auto isSpace = [] (char c)
+    { return std::isspace ((unsigned char) c) != 0; };
+
+    const auto begin = std::find_if_not (text.begin(), text.end(), isSpace);
+    const auto end = std::find_if_not (text.rbegin(), text.rend(), isSpace).base();
+
+    return begin < end ? std::string (begin, end) : std::string();
+}
+
+/** Parses a whole field as a number, rejecting trailing characters */
+bool parseNumber (const std::string& text, double& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    value = std::strtod (text.c_str(), &end);
+
+    return end == text.c_str() + text.size() && std::isfinite (value);
+}
+} // namespace
+
+const ChannelInfo* ChannelMap::find (int channel) const
+{
+    const auto entry = entries.find (channel);
+
+    return entry != entries.end() ? &entry->second : nullptr;
+}
+
+bool ChannelMap::parse (const std::string& text, std::string& error)
+{
+    std::map<int, ChannelInfo> parsed;
+    std::istringstream lines (text);
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline (lines, line))
+    {
+        lineNumber++;
+        line = trim (line);
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::vector<std::string> fields;
+        std::istringstream fieldStream (line);
+        std::string field;
+
+        while (std::getline (fieldStream, field, ','))
+            fields.push_back (trim (field));
+
+        double channel, scale, offset;
+        ChannelInfo info;
+
+        if (fields.size() != 5)
+        {
+            error = "line " + std::to_string (lineNumber) + ": expected channel, name, type, scale, offset";
+            return false;
+        }
+
+        if (! parseNumber (fields[0], channel) || channel < 1 || channel != std::floor (channel))
+        {
+            error = "line " + std::to_string (lineNumber) + ": invalid channel '" + fields[0] + "'";
+            return false;
+        }
+
+        if (! parseType (fields[2], info.type))
+        {
+            error = "line " + std::to_string (lineNumber) + ": invalid type '" + fields[2] + "', expected ELECTRODE, AUX or ADC";
+            return false;
+        }
+
+        if (! parseNumber (fields[3], scale) || ! parseNumber (fields[4], offset))
+        {
+            error = "line " + std::to_string (lineNumber) + ": invalid scale or offset";
+            return false;
+        }
+
+        info.name = fields[1].empty() ? "CH" + fields[0] : fields[1];
+        info.scale = (float) scale;
+        info.offset = (float) offset;
+
+        parsed[(int) channel - 1] = info;
+    }
+
+    entries = std::move (parsed);
+
+    return true;
+}
+
+std::string ChannelMap::toText() const
+{
+    std::ostringstream text;
+
+    text << "# channel, name, type, scale, offset\n";
+
+    for (const auto& entry : entries)
+    {
+        text << entry.first + 1 << ", " << entry.second.name << ", " << getTypeName (entry.second.type) << ", " << entry.second.scale << ", " << entry.second.offset << "\n";
+    }
+
+    return text.str();
+}
+
+void ChannelMap::getScales (int numChannels, float defaultScale, float defaultOffset, std::vector<float>& scales, std::vector<float>& offsets) const
+{
+    scales.assign (numChannels, defaultScale);
+    offsets.assign (numChannels, defaultOffset);
+
+    for (const auto& entry : entries)
+    {
+        if (entry.first >= numChannels)
+            break;
+
+        scales[entry.first] = entry.second.scale;
+        offsets[entry.first] = entry.second.offset;
+    }
+}
+
+bool ChannelMap::parseType (const std::string& text, ChannelType& type)
+{
+    std::string upper = trim (text);
+    std::transform (upper.begin(), upper.end(), upper.begin(), [] (unsigned char c)
+                    { return (char) std::toupper (c); });
+
+    if (upper == "ELECTRODE")
+        type = ELECTRODE;
+    else if (upper == "AUX")
+        type = AUX;
+    else if (upper == "ADC")
+        type = ADC;
+    else
+        return false;
+
+    return true;
+}
+
+const char* ChannelMap::getTypeName (ChannelType type)
+{
+    switch (type)
+    {
+        case AUX:
+            return "AUX";
+        case ADC:
+            return "ADC";
+        default:
+            return "ELECTRODE";
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef __CHANNELMAPH__
+#define __CHANNELMAPH__
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/** Kind of signal a channel carries */
+enum ChannelType
+{
+    ELECTRODE,
+    AUX,
+    ADC
+};
+
+/** Name, type and conversion of one incoming channel */
+struct ChannelInfo
+{
+    std::string name;
+    ChannelType type = ELECTRODE;
+    float scale = 1.0f;
+    float offset = 0.0f;
+};
+
+/**
+    Per-channel names, types, scales and offsets of a stream. Channels without
+    an entry keep the stream's scale and offset and are named CHn.
+
+    The text form has one channel per line, with comma-separated fields:
+
+        # channel, name, type, scale, offset
+        1, CH1, ELECTRODE, 0.195, 32768
+        65, AUX1, AUX, 0.0000374, 0
+
+    Channels are numbered from 1. Empty lines and lines starting with # are skipped.
+*/
+class ChannelMap
+{
+public:
+    /** Removes every entry */
+    void clear() { entries.clear(); }
+
+    bool isEmpty() const { return entries.empty(); }
+
+    /** Sets the entry of a channel, numbered from 0 */
+    void set (int channel, const ChannelInfo& info) { entries[channel] = info; }
+
+    /** Returns the entry of a channel, numbered from 0, or nullptr if it has none */
+    const ChannelInfo* find (int channel) const;
+
+    /** Returns every entry, by channel numbered from 0 */
+    const std::map<int, ChannelInfo>& getEntries() const { return entries; }
+
+    /** Replaces the entries with those in text. On error the map is left unchanged,
+        error says which line is wrong and false is returned. */
+    bool parse (const std::string& text, std::string& error);
+
+    /** Returns the entries in the text form parse() reads */
+    std::string toText() const;
+
+    /** Fills the scale and offset of numChannels channels, using defaults for channels without an entry */
+    void getScales (int numChannels, float defaultScale, float defaultOffset, std::vector<float>& scales, std::vector<float>& offsets) const;
+
+    /** Parses ELECTRODE, AUX or ADC, ignoring case; returns false for anything else */
+    static bool parseType (const std::string& text, ChannelType& type);
+
+    /** Returns ELECTRODE, AUX or ADC */
+    static const char* getTypeName (ChannelType type);
+
+private:
+    std::map<int, ChannelInfo> entries;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,103 @@
+#include "ClockRecovery.h"
+
+#include <cmath>
+
+using namespace EphysSocketNode;
+
+ClockRecovery::ClockRecovery()
+{
+    reset (30000.0, 256);
+}
+
+void ClockRecovery::reset (double nominalSampleRate_, int samplesPerPacket_)
+{
+    nominalSampleRate = nominalSampleRate_ > 0 ? nominalSampleRate_ : 1.0;
+    samplesPerPacket = samplesPerPacket_ > 0 ? samplesPerPacket_ : 1;
+
+    packetPeriod = samplesPerPacket / nominalSampleRate;
+    current = 0.0;
+    next = 0.0;
+
+    elapsed = 0.0;
+    started = false;
+    numRelocks = 0;
+
+    lockedAt = 0.0;
+    packetsSinceLock = 0;
+
+    setBandwidth (LOCK_BANDWIDTH);
+}
+
+void ClockRecovery::setBandwidth (double bandwidth)
+{
+    // Critically damped second-order loop, as in Adriaensen's "Using a DLL to filter time"
+    const double pi = 3.14159265358979323846;
+    const double omega = 2.0 * pi * bandwidth * packetPeriod;
+
+    b = std::sqrt (2.0) * omega;
+    c = omega * omega;
+}
+
+double ClockRecovery::getSampleRate() const
+{
+    const double sinceLock = current - lockedAt;
+
+    if (packetsSinceLock == 0 || sinceLock < LOCK_SECONDS)
+        return samplesPerPacket / packetPeriod;
+
+    return packetsSinceLock * samplesPerPacket / sinceLock;
+}
+
+void ClockRecovery::skip (int numPackets)
+{
+    if (! started || numPackets <= 0)
+        return;
+
+    next += numPackets * packetPeriod;
+
+    if (elapsed >= LOCK_SECONDS)
+        packetsSinceLock += numPackets;
+}
+
+double ClockRecovery::update (double arrivalTime)
+{
+    const double error = arrivalTime - next;
+
+    if (! started || std::abs (error) > MAX_ERROR_PACKETS * packetPeriod)
+    {
+        if (started)
+            numRelocks++;
+
+        packetsSinceLock = 0;
+        elapsed = 0.0;
+        setBandwidth (LOCK_BANDWIDTH);
+
+        current = arrivalTime;
+        next = arrivalTime + packetPeriod;
+        started = true;
+    }
+    else
+    {
+        current = next;
+        next += b * error + packetPeriod;
+        packetPeriod += c * error;
+
+        if (elapsed < LOCK_SECONDS)
+        {
+            elapsed += packetPeriod;
+
+            if (elapsed >= LOCK_SECONDS)
+            {
+                setBandwidth (TRACK_BANDWIDTH);
+                lockedAt = current;
+            }
+        }
+        else
+        {
+            packetsSinceLock++;
+        }
+    }
+
+    // The packet arrives after its last sample was taken, so its first sample is a packet earlier
+    return current - (samplesPerPacket - 1) * getSamplePeriod();
+}
@@ -0,0 +1,93 @@
+#ifndef __CLOCKRECOVERYH__
+#define __CLOCKRECOVERYH__
+
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/**
+    Recovers the sender's sample clock from packet arrival times.
+
+    A second-order delay-locked loop tracks the arrival time of every packet and
+    the duration of a packet, filtering out network and scheduling jitter. That
+    gives smooth timestamps for every sample and an estimate of the rate the
+    sender really samples at, which can drift from the configured one.
+
+    The loop starts wide so it locks within a couple of seconds, then narrows.
+    Once locked, the sample rate is measured over the whole time since locking,
+    which averages the remaining jitter down to a few ppm within a minute.
+    Costs a few multiply-adds per packet.
+*/
+class ClockRecovery
+{
+public:
+    /** Constructor */
+    ClockRecovery();
+
+    /** Restarts the loop for packets of samplesPerPacket samples at a nominal rate */
+    void reset (double nominalSampleRate, int samplesPerPacket);
+
+    /** Feeds the arrival time of the next packet, in seconds of a monotonic clock.
+        Returns the smoothed time of the packet's first sample. */
+    double update (double arrivalTime);
+
+    /** Returns how much later than predicted a packet arriving at arrivalTime is, in seconds,
+        or 0 until the loop is locked */
+    double getLateness (double arrivalTime) const { return isLocked() ? arrivalTime - next : 0.0; }
+
+    /** Advances the loop over numPackets packets that were lost, so the next arrival
+        isn't mistaken for the clock running slow */
+    void skip (int numPackets);
+
+    /** Returns the estimated duration of one packet, in seconds */
+    double getPacketPeriod() const { return packetPeriod; }
+
+    /** Returns the estimated duration of one sample, in seconds */
+    double getSamplePeriod() const { return packetPeriod / samplesPerPacket; }
+
+    /** Returns the estimated sample rate of the sender */
+    double getSampleRate() const;
+
+    /** Returns how far the estimated rate is from the nominal one, in parts per million */
+    double getDriftPpm() const { return (getSampleRate() / nominalSampleRate - 1.0) * 1e6; }
+
+    /** Returns true once the loop has had time to settle */
+    bool isLocked() const { return elapsed >= LOCK_SECONDS; }
+
+    /** Number of times the loop restarted because a packet was far off the prediction */
+    int64_t getNumRelocks() const { return numRelocks; }
+
+private:
+    /** Sets the loop coefficients for a bandwidth in Hz */
+    void setBandwidth (double bandwidth);
+
+    /** Loop bandwidths while locking and once locked */
+    static constexpr double LOCK_BANDWIDTH = 1.0;
+    static constexpr double TRACK_BANDWIDTH = 0.1;
+    static constexpr double LOCK_SECONDS = 2.0;
+
+    /** Prediction error, in packets, beyond which the loop restarts (e.g. after a stall) */
+    static constexpr double MAX_ERROR_PACKETS = 50.0;
+
+    double nominalSampleRate;
+    int samplesPerPacket;
+
+    /** Smoothed arrival of the last packet, predicted arrival of the next and estimated packet duration */
+    double current;
+    double next;
+    double packetPeriod;
+
+    double b;
+    double c;
+
+    double elapsed;
+    bool started;
+
+    /** Smoothed arrival when the loop locked, and packets since then */
+    double lockedAt;
+    int64_t packetsSinceLock;
+    int64_t numRelocks;
+};
+} // namespace EphysSocketNode
+
+#endif
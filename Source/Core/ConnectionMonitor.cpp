@@ -0,0 +1,54 @@
+#include "ConnectionMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace EphysSocketNode;
+
+ConnectionMonitor::ConnectionMonitor()
+{
+    reset();
+}
+
+void ConnectionMonitor::reset()
+{
+    stallTimeoutNs = (int64_t) MIN_STALL_TIMEOUT_MS * 1000000;
+    lostTimeoutNs = (int64_t) LOST_TIMEOUT_MS * 1000000;
+    lastActivityNs = 0;
+
+    numAttempts = 0;
+    retryDelayMs = MIN_RETRY_DELAY_MS;
+}
+
+int ConnectionMonitor::recordFailedAttempt()
+{
+    const int delay = numAttempts > 0 ? std::min (retryDelayMs * 2, MAX_RETRY_DELAY_MS) : MIN_RETRY_DELAY_MS;
+
+    retryDelayMs = delay;
+    numAttempts = numAttempts + 1;
+
+    return delay;
+}
+
+void ConnectionMonitor::recordConnected (int64_t nowNs, double packetPeriod)
+{
+    // A slow stream goes quiet between packets, so its timeouts scale with the packet period
+    stallTimeoutNs = std::max ((int64_t) MIN_STALL_TIMEOUT_MS * 1000000, (int64_t) std::ceil (STALL_PACKETS * packetPeriod * 1e9));
+    lostTimeoutNs = std::max ((int64_t) LOST_TIMEOUT_MS * 1000000, 2 * stallTimeoutNs);
+    lastActivityNs = nowNs;
+
+    numAttempts = 0;
+    retryDelayMs = MIN_RETRY_DELAY_MS;
+}
+
+int ConnectionMonitor::getWaitMs (int64_t nowNs, int maxMs) const
+{
+    const int64_t stallNs = stallTimeoutNs;
+    const int64_t silenceNs = nowNs - lastActivityNs;
+    const int64_t remainingNs = (silenceNs < stallNs ? stallNs : lostTimeoutNs) - silenceNs;
+
+    if (remainingNs <= 0)
+        return maxMs;
+
+    return (int) std::min ((int64_t) maxMs, std::max ((int64_t) 1, (remainingNs + 999999) / 1000000));
+}
@@ -0,0 +1,95 @@
+#ifndef __CONNECTIONMONITORH__
+#define __CONNECTIONMONITORH__
+
+#include <atomic>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/** Where a stream's connection stands; set by its receiving thread, read by any thread */
+enum ConnectionState
+{
+    DISCONNECTED, // not asked to connect
+    CONNECTING, // opening the socket, retrying until it opens
+    WAITING_FOR_HEADER, // open, waiting for the sender's first header
+    CONNECTED, // receiving packets
+    STALLED, // connected, but nothing has arrived for longer than the stall timeout
+    FAILED // gave up, e.g. the sender came back with a different header
+};
+
+/**
+    Times a stream's connection on the steady clock: how long to wait before
+    retrying to connect, and whether the sender has gone quiet.
+
+    Failed attempts back off exponentially from MIN_RETRY_DELAY_MS to
+    MAX_RETRY_DELAY_MS, so a sender that restarts is picked up within a few
+    milliseconds while one that is down for good costs two attempts a second.
+
+    A stream is stalled once nothing has arrived for STALL_PACKETS packet
+    periods, and at least MIN_STALL_TIMEOUT_MS, and lost after LOST_TIMEOUT_MS
+    (or twice the stall timeout, if longer). A stall is only reported, as a
+    sender that pauses keeps its connection; a lost stream is reconnected.
+*/
+class ConnectionMonitor
+{
+public:
+    /** Silence after which a stream is stalled: packet periods, and the least time */
+    static constexpr int STALL_PACKETS = 4;
+    static constexpr int MIN_STALL_TIMEOUT_MS = 50;
+
+    /** Silence after which a stream is lost and reconnected */
+    static constexpr int LOST_TIMEOUT_MS = 1000;
+
+    /** Delay before retrying after the first failed attempt, doubling up to the longest */
+    static constexpr int MIN_RETRY_DELAY_MS = 10;
+    static constexpr int MAX_RETRY_DELAY_MS = 500;
+
+    /** Constructor */
+    ConnectionMonitor();
+
+    /** Starts over for a new connection, with no failed attempts and the shortest stall timeout */
+    void reset();
+
+    /** Records a failed attempt to connect and returns how long to wait before the next one, in ms */
+    int recordFailedAttempt();
+
+    /** Records a connection that delivered its first header at nowNs, for packets of packetPeriod
+        seconds (0 if unknown). The next failed attempt is retried after the shortest delay again. */
+    void recordConnected (int64_t nowNs, double packetPeriod);
+
+    /** Records bytes arriving from the sender at nowNs */
+    void recordActivity (int64_t nowNs) { lastActivityNs.store (nowNs, std::memory_order_relaxed); }
+
+    /** Returns true if nothing has arrived for longer than the stall timeout */
+    bool isStalled (int64_t nowNs) const { return nowNs - lastActivityNs >= stallTimeoutNs; }
+
+    /** Returns true if nothing has arrived for longer than the lost timeout */
+    bool isLost (int64_t nowNs) const { return nowNs - lastActivityNs >= lostTimeoutNs; }
+
+    /** Returns how long to wait for data at nowNs, at most maxMs, so that the next stall or loss is noticed on time */
+    int getWaitMs (int64_t nowNs, int maxMs) const;
+
+    /** Returns the time since anything arrived, in ms */
+    int64_t getSilenceMs (int64_t nowNs) const { return (nowNs - lastActivityNs) / 1000000; }
+
+    /** Returns the number of failed attempts since the last connection */
+    int getNumAttempts() const { return numAttempts; }
+
+    /** Returns the delay before the next attempt, in ms */
+    int getRetryDelayMs() const { return retryDelayMs; }
+
+    /** Returns the stall timeout of the current connection, in ms */
+    int getStallTimeoutMs() const { return (int) (stallTimeoutNs / 1000000); }
+
+private:
+    int64_t lostTimeoutNs;
+
+    /** Written by the receiving thread, read by any thread */
+    std::atomic<int64_t> stallTimeoutNs;
+    std::atomic<int64_t> lastActivityNs;
+    std::atomic<int> numAttempts;
+    std::atomic<int> retryDelayMs;
+};
+} // namespace EphysSocketNode
+
+#endif
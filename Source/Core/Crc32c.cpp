@@ -0,0 +1,129 @@
+#include "Crc32c.h"
+#include "SimdSupport.h"
+
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+/** Reflected Castagnoli polynomial */
+const uint32_t POLYNOMIAL = 0x82F63B78;
+
+/** Tables for slicing by 8: table[k][b] is the CRC of byte b followed by k zero bytes */
+struct Tables
+{
+    uint32_t table[8][256];
+
+    Tables()
+    {
+        for (uint32_t b = 0; b < 256; b++)
+        {
+            uint32_t crc = b;
+
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (POLYNOMIAL & (0u - (crc & 1)));
+
+            table[0][b] = crc;
+        }
+
+        for (int k = 1; k < 8; k++)
+            for (uint32_t b = 0; b < 256; b++)
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    }
+};
+
+const Tables tables;
+
+uint32_t crc32cScalar (const unsigned char* data, size_t size, uint32_t crc)
+{
+    const auto& t = tables.table;
+
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        uint32_t lo, hi;
+        std::memcpy (&lo, data, 4);
+        std::memcpy (&hi, data + 4, 4);
+        lo ^= crc; // Assumes a little-endian host, like the rest of the wire format handling
+
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+              ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+
+    for (; size > 0; size--, data++)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+
+    return crc;
+}
+
+#if EPHYS_SOCKET_X86
+
+EPHYS_SOCKET_TARGET ("sse4.2")
+uint32_t crc32cSse42 (const unsigned char* data, size_t size, uint32_t crc)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        uint64_t word;
+        std::memcpy (&word, data, 8);
+        crc64 = _mm_crc32_u64 (crc64, word);
+    }
+
+    crc = (uint32_t) crc64;
+#endif
+
+    for (; size >= 4; size -= 4, data += 4)
+    {
+        uint32_t word;
+        std::memcpy (&word, data, 4);
+        crc = _mm_crc32_u32 (crc, word);
+    }
+
+    for (; size > 0; size--, data++)
+        crc = _mm_crc32_u8 (crc, *data);
+
+    return crc;
+}
+
+bool detectSse42()
+{
+#if defined(_MSC_VER) && ! defined(__clang__)
+    int info[4];
+    __cpuid (info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports ("sse4.2");
+#endif
+}
+
+const bool sse42 = detectSse42();
+
+#else
+
+const bool sse42 = false;
+
+#endif
+
+} // namespace
+
+uint32_t EphysSocketNode::crc32c (const std::byte* data, size_t size, uint32_t crc)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*> (data);
+
+    crc = ~crc;
+
+#if EPHYS_SOCKET_X86
+    if (sse42)
+        return ~crc32cSse42 (bytes, size, crc);
+#endif
+
+    return ~crc32cScalar (bytes, size, crc);
+}
+
+bool EphysSocketNode::hasHardwareCrc32c()
+{
+    return sse42;
+}
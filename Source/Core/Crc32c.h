@@ -0,0 +1,17 @@
+#ifndef __CRC32CH__
+#define __CRC32CH__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/** Returns the CRC32C (Castagnoli) of size bytes, continuing from the crc of the bytes before them.
+    Uses the SSE4.2 crc32 instruction where the CPU has it, which keeps pace with the socket. */
+uint32_t crc32c (const std::byte* data, size_t size, uint32_t crc = 0);
+
+/** Returns true if crc32c() runs on the CPU's crc32 instruction */
+bool hasHardwareCrc32c();
+} // namespace EphysSocketNode
+
+#endif
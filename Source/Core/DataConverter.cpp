@@ -0,0 +1,516 @@
+#include "DataConverter.h"
+#include "SimdSupport.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+/** Interleaved input is transposed in blocks small enough that the source rows and the
+    destination rows they feed both stay in L1 while the block is processed */
+const int BLOCK_CHANNELS = 32;
+const int BLOCK_SAMPLES = 64;
+
+/** Reads one element without assuming alignment; packet payloads follow a 22-byte header */
+template <typename T>
+inline float loadScalar (const std::byte* src, int i)
+{
+    T value;
+    std::memcpy (&value, src + (size_t) i * sizeof (T), sizeof (T));
+    return (float) value;
+}
+
+template <typename T>
+void convertScalar (const std::byte* src, float* dest, int count, float scale, float offset)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dest[i] = scale * (loadScalar<T> (src, i) - offset);
+    }
+}
+
+/** Converts and transposes channels [ch0, ch1) of samples [s0, s1) one element at a time */
+template <typename T>
+void transposeScalar (const std::byte* src, int numChannels, int ch0, int ch1, int s0, int s1, float* dest, int destStride, const float* scales, const float* offsets)
+{
+    for (int ch = ch0; ch < ch1; ch++)
+    {
+        float* row = dest + (size_t) ch * destStride;
+        const float scale = scales[ch];
+        const float offset = offsets[ch];
+
+        for (int s = s0; s < s1; s++)
+        {
+            row[s] = scale * (loadScalar<T> (src, s * numChannels + ch) - offset);
+        }
+    }
+}
+
+template <typename T>
+void convertInterleavedScalar (const std::byte* src, int numChannels, int numSamples, float* dest, int destStride, const float* scales, const float* offsets)
+{
+    for (int s0 = 0; s0 < numSamples; s0 += BLOCK_SAMPLES)
+    {
+        const int s1 = s0 + BLOCK_SAMPLES < numSamples ? s0 + BLOCK_SAMPLES : numSamples;
+
+        for (int ch0 = 0; ch0 < numChannels; ch0 += BLOCK_CHANNELS)
+        {
+            const int ch1 = ch0 + BLOCK_CHANNELS < numChannels ? ch0 + BLOCK_CHANNELS : numChannels;
+
+            transposeScalar<T> (src, numChannels, ch0, ch1, s0, s1, dest, destStride, scales, offsets);
+        }
+    }
+}
+
+#if EPHYS_SOCKET_X86
+
+/** SSE2: 4 samples per step */
+struct Sse2
+{
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const uint8_t* p)
+    {
+        int32_t raw;
+        std::memcpy (&raw, p, 4);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i v = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (_mm_cvtsi32_si128 (raw), zero), zero);
+        return _mm_cvtepi32_ps (v);
+    }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const int8_t* p)
+    {
+        int32_t raw;
+        std::memcpy (&raw, p, 4);
+        __m128i v = _mm_cvtsi32_si128 (raw);
+        v = _mm_unpacklo_epi8 (v, v);
+        v = _mm_unpacklo_epi16 (v, v);
+        return _mm_cvtepi32_ps (_mm_srai_epi32 (v, 24));
+    }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const uint16_t* p)
+    {
+        const __m128i v = _mm_loadl_epi64 ((const __m128i*) p);
+        return _mm_cvtepi32_ps (_mm_unpacklo_epi16 (v, _mm_setzero_si128()));
+    }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const int16_t* p)
+    {
+        const __m128i v = _mm_loadl_epi64 ((const __m128i*) p);
+        return _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16));
+    }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const int32_t* p) { return _mm_cvtepi32_ps (_mm_loadu_si128 ((const __m128i*) p)); }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const float* p) { return _mm_loadu_ps (p); }
+
+    EPHYS_SOCKET_TARGET ("sse2")
+    static __m128 load (const double* p)
+    {
+        return _mm_movelh_ps (_mm_cvtpd_ps (_mm_loadu_pd (p)), _mm_cvtpd_ps (_mm_loadu_pd (p + 2)));
+    }
+};
+
+template <typename T>
+EPHYS_SOCKET_TARGET ("sse2")
+void convertSse2 (const std::byte* src, float* dest, int count, float scale, float offset)
+{
+    const T* buf = (const T*) src;
+    const __m128 s = _mm_set1_ps (scale);
+    const __m128 o = _mm_set1_ps (offset);
+
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps (dest + i, _mm_mul_ps (s, _mm_sub_ps (Sse2::load (buf + i), o)));
+    }
+
+    convertScalar<T> (src + (size_t) i * sizeof (T), dest + i, count - i, scale, offset);
+}
+
+/** Converts a 4 x 4 tile of interleaved samples and stores it as 4 channel rows.
+    Each load holds one sample of 4 channels, so s and o hold those channels' scales and offsets. */
+template <typename T>
+EPHYS_SOCKET_TARGET ("sse2")
+inline void convertTileSse2 (const T* src, int srcStride, float* dest, int destStride, __m128 s, __m128 o)
+{
+    __m128 r0 = _mm_mul_ps (s, _mm_sub_ps (Sse2::load (src), o));
+    __m128 r1 = _mm_mul_ps (s, _mm_sub_ps (Sse2::load (src + srcStride), o));
+    __m128 r2 = _mm_mul_ps (s, _mm_sub_ps (Sse2::load (src + 2 * srcStride), o));
+    __m128 r3 = _mm_mul_ps (s, _mm_sub_ps (Sse2::load (src + 3 * srcStride), o));
+
+    _MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+
+    _mm_storeu_ps (dest, r0);
+    _mm_storeu_ps (dest + destStride, r1);
+    _mm_storeu_ps (dest + 2 * destStride, r2);
+    _mm_storeu_ps (dest + 3 * destStride, r3);
+}
+
+template <typename T>
+EPHYS_SOCKET_TARGET ("sse2")
+void convertInterleavedSse2 (const std::byte* src, int numChannels, int numSamples, float* dest, int destStride, const float* scales, const float* offsets)
+{
+    const T* buf = (const T*) src;
+
+    for (int s0 = 0; s0 < numSamples; s0 += BLOCK_SAMPLES)
+    {
+        const int s1 = s0 + BLOCK_SAMPLES < numSamples ? s0 + BLOCK_SAMPLES : numSamples;
+
+        for (int ch0 = 0; ch0 < numChannels; ch0 += BLOCK_CHANNELS)
+        {
+            const int ch1 = ch0 + BLOCK_CHANNELS < numChannels ? ch0 + BLOCK_CHANNELS : numChannels;
+
+            int ch = ch0;
+
+            for (; ch + 4 <= ch1; ch += 4)
+            {
+                const __m128 s = _mm_loadu_ps (scales + ch);
+                const __m128 o = _mm_loadu_ps (offsets + ch);
+
+                int i = s0;
+
+                for (; i + 4 <= s1; i += 4)
+                {
+                    convertTileSse2 (buf + (size_t) i * numChannels + ch, numChannels, dest + (size_t) ch * destStride + i, destStride, s, o);
+                }
+
+                transposeScalar<T> (src, numChannels, ch, ch + 4, i, s1, dest, destStride, scales, offsets);
+            }
+
+            transposeScalar<T> (src, numChannels, ch, ch1, s0, s1, dest, destStride, scales, offsets);
+        }
+    }
+}
+
+/** AVX2: 8 samples per step */
+struct Avx2
+{
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const uint8_t* p) { return _mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const int8_t* p) { return _mm256_cvtepi32_ps (_mm256_cvtepi8_epi32 (_mm_loadl_epi64 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const uint16_t* p) { return _mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const int16_t* p) { return _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const int32_t* p) { return _mm256_cvtepi32_ps (_mm256_loadu_si256 ((const __m256i*) p)); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const float* p) { return _mm256_loadu_ps (p); }
+
+    EPHYS_SOCKET_TARGET ("avx2")
+    static __m256 load (const double* p)
+    {
+        const __m128 lo = _mm256_cvtpd_ps (_mm256_loadu_pd (p));
+        const __m128 hi = _mm256_cvtpd_ps (_mm256_loadu_pd (p + 4));
+        return _mm256_insertf128_ps (_mm256_castps128_ps256 (lo), hi, 1);
+    }
+};
+
+template <typename T>
+EPHYS_SOCKET_TARGET ("avx2")
+void convertAvx2 (const std::byte* src, float* dest, int count, float scale, float offset)
+{
+    const T* buf = (const T*) src;
+    const __m256 s = _mm256_set1_ps (scale);
+    const __m256 o = _mm256_set1_ps (offset);
+
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps (dest + i, _mm256_mul_ps (s, _mm256_sub_ps (Avx2::load (buf + i), o)));
+    }
+
+    convertScalar<T> (src + (size_t) i * sizeof (T), dest + i, count - i, scale, offset);
+}
+
+/** Converts an 8 x 8 tile of interleaved samples and stores it as 8 channel rows; s and o hold the 8 channels' scales and offsets */
+template <typename T>
+EPHYS_SOCKET_TARGET ("avx2")
+inline void convertTileAvx2 (const T* src, int srcStride, float* dest, int destStride, __m256 s, __m256 o)
+{
+    __m256 r[8];
+
+    for (int k = 0; k < 8; k++)
+    {
+        r[k] = _mm256_mul_ps (s, _mm256_sub_ps (Avx2::load (src + k * srcStride), o));
+    }
+
+    // Standard 8 x 8 transpose: interleave pairs, then quads, then swap 128-bit halves
+    const __m256 t0 = _mm256_unpacklo_ps (r[0], r[1]);
+    const __m256 t1 = _mm256_unpackhi_ps (r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps (r[2], r[3]);
+    const __m256 t3 = _mm256_unpackhi_ps (r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps (r[4], r[5]);
+    const __m256 t5 = _mm256_unpackhi_ps (r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps (r[6], r[7]);
+    const __m256 t7 = _mm256_unpackhi_ps (r[6], r[7]);
+
+    const __m256 u0 = _mm256_shuffle_ps (t0, t2, _MM_SHUFFLE (1, 0, 1, 0));
+    const __m256 u1 = _mm256_shuffle_ps (t0, t2, _MM_SHUFFLE (3, 2, 3, 2));
+    const __m256 u2 = _mm256_shuffle_ps (t1, t3, _MM_SHUFFLE (1, 0, 1, 0));
+    const __m256 u3 = _mm256_shuffle_ps (t1, t3, _MM_SHUFFLE (3, 2, 3, 2));
+    const __m256 u4 = _mm256_shuffle_ps (t4, t6, _MM_SHUFFLE (1, 0, 1, 0));
+    const __m256 u5 = _mm256_shuffle_ps (t4, t6, _MM_SHUFFLE (3, 2, 3, 2));
+    const __m256 u6 = _mm256_shuffle_ps (t5, t7, _MM_SHUFFLE (1, 0, 1, 0));
+    const __m256 u7 = _mm256_shuffle_ps (t5, t7, _MM_SHUFFLE (3, 2, 3, 2));
+
+    _mm256_storeu_ps (dest, _mm256_permute2f128_ps (u0, u4, 0x20));
+    _mm256_storeu_ps (dest + destStride, _mm256_permute2f128_ps (u1, u5, 0x20));
+    _mm256_storeu_ps (dest + 2 * destStride, _mm256_permute2f128_ps (u2, u6, 0x20));
+    _mm256_storeu_ps (dest + 3 * destStride, _mm256_permute2f128_ps (u3, u7, 0x20));
+    _mm256_storeu_ps (dest + 4 * destStride, _mm256_permute2f128_ps (u0, u4, 0x31));
+    _mm256_storeu_ps (dest + 5 * destStride, _mm256_permute2f128_ps (u1, u5, 0x31));
+    _mm256_storeu_ps (dest + 6 * destStride, _mm256_permute2f128_ps (u2, u6, 0x31));
+    _mm256_storeu_ps (dest + 7 * destStride, _mm256_permute2f128_ps (u3, u7, 0x31));
+}
+
+template <typename T>
+EPHYS_SOCKET_TARGET ("avx2")
+void convertInterleavedAvx2 (const std::byte* src, int numChannels, int numSamples, float* dest, int destStride, const float* scales, const float* offsets)
+{
+    const T* buf = (const T*) src;
+
+    for (int s0 = 0; s0 < numSamples; s0 += BLOCK_SAMPLES)
+    {
+        const int s1 = s0 + BLOCK_SAMPLES < numSamples ? s0 + BLOCK_SAMPLES : numSamples;
+
+        for (int ch0 = 0; ch0 < numChannels; ch0 += BLOCK_CHANNELS)
+        {
+            const int ch1 = ch0 + BLOCK_CHANNELS < numChannels ? ch0 + BLOCK_CHANNELS : numChannels;
+
+            int ch = ch0;
+
+            for (; ch + 8 <= ch1; ch += 8)
+            {
+                const __m256 s = _mm256_loadu_ps (scales + ch);
+                const __m256 o = _mm256_loadu_ps (offsets + ch);
+
+                int i = s0;
+
+                for (; i + 8 <= s1; i += 8)
+                {
+                    convertTileAvx2 (buf + (size_t) i * numChannels + ch, numChannels, dest + (size_t) ch * destStride + i, destStride, s, o);
+                }
+
+                transposeScalar<T> (src, numChannels, ch, ch + 8, i, s1, dest, destStride, scales, offsets);
+            }
+
+            transposeScalar<T> (src, numChannels, ch, ch1, s0, s1, dest, destStride, scales, offsets);
+        }
+    }
+}
+
+/** AVX-512F: 16 samples per step */
+struct Avx512
+{
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const uint8_t* p) { return _mm512_cvtepi32_ps (_mm512_cvtepu8_epi32 (_mm_loadu_si128 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const int8_t* p) { return _mm512_cvtepi32_ps (_mm512_cvtepi8_epi32 (_mm_loadu_si128 ((const __m128i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const uint16_t* p) { return _mm512_cvtepi32_ps (_mm512_cvtepu16_epi32 (_mm256_loadu_si256 ((const __m256i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const int16_t* p) { return _mm512_cvtepi32_ps (_mm512_cvtepi16_epi32 (_mm256_loadu_si256 ((const __m256i*) p))); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const int32_t* p) { return _mm512_cvtepi32_ps (_mm512_loadu_si512 (p)); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const float* p) { return _mm512_loadu_ps (p); }
+
+    EPHYS_SOCKET_TARGET ("avx512f")
+    static __m512 load (const double* p)
+    {
+        const __m256 lo = _mm512_cvtpd_ps (_mm512_loadu_pd (p));
+        const __m256 hi = _mm512_cvtpd_ps (_mm512_loadu_pd (p + 8));
+        return _mm512_castpd_ps (_mm512_insertf64x4 (_mm512_castpd256_pd512 (_mm256_castps_pd (lo)), _mm256_castps_pd (hi), 1));
+    }
+};
+
+template <typename T>
+EPHYS_SOCKET_TARGET ("avx512f")
+void convertAvx512 (const std::byte* src, float* dest, int count, float scale, float offset)
+{
+    const T* buf = (const T*) src;
+    const __m512 s = _mm512_set1_ps (scale);
+    const __m512 o = _mm512_set1_ps (offset);
+
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm512_storeu_ps (dest + i, _mm512_mul_ps (s, _mm512_sub_ps (Avx512::load (buf + i), o)));
+    }
+
+    convertScalar<T> (src + (size_t) i * sizeof (T), dest + i, count - i, scale, offset);
+}
+
+SimdLevel detectSimdLevel()
+{
+#if defined(_MSC_VER) && ! defined(__clang__)
+    int info[4];
+    __cpuid (info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid (info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    if (! sse2)
+        return SimdLevel::SCALAR;
+
+    if (! osxsave || maxLeaf < 7)
+        return SimdLevel::SSE2;
+
+    // The OS must also save the wider registers on context switches
+    const unsigned long long xcr0 = _xgetbv (0);
+
+    __cpuidex (info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    const bool avx512f = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+
+    if (avx512f)
+        return SimdLevel::AVX512;
+    if (avx2)
+        return SimdLevel::AVX2;
+
+    return SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports ("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports ("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports ("sse2"))
+        return SimdLevel::SSE2;
+
+    return SimdLevel::SCALAR;
+#endif
+}
+
+#else
+
+SimdLevel detectSimdLevel()
+{
+    return SimdLevel::SCALAR;
+}
+
+#endif
+
+} // namespace
+
+DataConverter::DataConverter()
+{
+    depth = U16;
+    simdLevel = getMaxSimdLevel();
+
+    selectKernels();
+}
+
+void DataConverter::setDepth (Depth depth_)
+{
+    depth = depth_;
+
+    selectKernels();
+}
+
+void DataConverter::setSimdLevel (SimdLevel level)
+{
+    simdLevel = (int) level < (int) getMaxSimdLevel() ? level : getMaxSimdLevel();
+
+    selectKernels();
+}
+
+SimdLevel DataConverter::getMaxSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+
+    return level;
+}
+
+const char* DataConverter::getSimdLevelName (SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::SSE2:
+            return "SSE2";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        default:
+            return "scalar";
+    }
+}
+
+template <typename T>
+void DataConverter::selectKernelsFor()
+{
+    kernel = &convertScalar<T>;
+    interleavedKernel = &convertInterleavedScalar<T>;
+
+#if EPHYS_SOCKET_X86
+    if (simdLevel == SimdLevel::AVX512)
+    {
+        kernel = &convertAvx512<T>;
+        interleavedKernel = &convertInterleavedAvx2<T>;
+    }
+    else if (simdLevel == SimdLevel::AVX2)
+    {
+        kernel = &convertAvx2<T>;
+        interleavedKernel = &convertInterleavedAvx2<T>;
+    }
+    else if (simdLevel == SimdLevel::SSE2)
+    {
+        kernel = &convertSse2<T>;
+        interleavedKernel = &convertInterleavedSse2<T>;
+    }
+#endif
+}
+
+void DataConverter::selectKernels()
+{
+    switch (depth)
+    {
+        case U8:
+            selectKernelsFor<uint8_t>();
+            break;
+        case S8:
+            selectKernelsFor<int8_t>();
+            break;
+        case S16:
+            selectKernelsFor<int16_t>();
+            break;
+        case S32:
+            selectKernelsFor<int32_t>();
+            break;
+        case F32:
+            selectKernelsFor<float>();
+            break;
+        case F64:
+            selectKernelsFor<double>();
+            break;
+        default:
+            selectKernelsFor<uint16_t>();
+            break;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __DATACONVERTERH__
+#define __DATACONVERTERH__
+
+#include "EphysSocketHeader.h"
+
+#include <cstddef>
+
+namespace EphysSocketNode
+{
+/** Memory order of the samples in an incoming matrix */
+enum Layout
+{
+    CHANNEL_MAJOR, // channels x samples, as sent by Bonsai's SendMatOverSocket
+    INTERLEAVED // samples x channels, one frame of every channel per sample
+};
+
+/** Instruction sets the conversion kernels can be dispatched to */
+enum class SimdLevel
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+/**
+    Converts raw samples of any Depth to scaled floats, computing
+    scale * (sample - offset) for every element.
+
+    Kernels are vectorized for SSE2, AVX2 and AVX-512 and picked at runtime from
+    what the CPU supports; other architectures use a portable scalar loop.
+
+    Interleaved input is transposed to the channel-major layout of the DataBuffer
+    in the same pass, one cache-sized block of channels and samples at a time.
+    Every channel then has its own scale and offset, applied to whole vectors of
+    channels before the transpose.
+*/
+class DataConverter
+{
+public:
+    /** Constructor */
+    DataConverter();
+
+    /** Selects the kernel for the given sample type */
+    void setDepth (Depth depth);
+
+    /** Returns the sample type the kernels convert */
+    Depth getDepth() const { return depth; }
+
+    /** Caps the instruction set used by the kernels (mainly for benchmarking) */
+    void setSimdLevel (SimdLevel level);
+
+    /** Returns the instruction set the current kernel uses */
+    SimdLevel getSimdLevel() const { return simdLevel; }
+
+    /** Converts count contiguous samples starting at src, which needs no particular alignment */
+    void convert (const std::byte* src, float* dest, int count, float scale, float offset) const
+    {
+        kernel (src, dest, count, scale, offset);
+    }
+
+    /** Converts a samples x channels matrix into channel rows that start destStride samples apart,
+        with the scale and offset of each channel taken from scales and offsets (numChannels each) */
+    void convertInterleaved (const std::byte* src, int numChannels, int numSamples, float* dest, int destStride, const float* scales, const float* offsets) const
+    {
+        interleavedKernel (src, numChannels, numSamples, dest, destStride, scales, offsets);
+    }
+
+    /** Returns the best instruction set supported by this CPU */
+    static SimdLevel getMaxSimdLevel();
+
+    /** Returns a printable name for an instruction set */
+    static const char* getSimdLevelName (SimdLevel level);
+
+private:
+    using Kernel = void (*) (const std::byte* src, float* dest, int count, float scale, float offset);
+    using InterleavedKernel = void (*) (const std::byte* src, int numChannels, int numSamples, float* dest, int destStride, const float* scales, const float* offsets);
+
+    void selectKernels();
+
+    template <typename T>
+    void selectKernelsFor();
+
+    Depth depth;
+    SimdLevel simdLevel;
+    Kernel kernel;
+    InterleavedKernel interleavedKernel;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,102 @@
+#include "DatagramBatch.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+
+using namespace EphysSocketNode;
+
+DatagramBatch::DatagramBatch()
+{
+    slotSize = 0;
+    numReceived = 0;
+    nextIndex = 0;
+}
+
+void DatagramBatch::resize (int maxDatagrams, int slotSize_)
+{
+    slotSize = slotSize_;
+
+    slots.resize ((size_t) maxDatagrams * slotSize);
+    sizes.resize ((size_t) maxDatagrams);
+
+#ifdef __linux__
+    buffers.resize ((size_t) maxDatagrams);
+    messages.resize ((size_t) maxDatagrams);
+
+    for (int i = 0; i < maxDatagrams; i++)
+    {
+        buffers[i].iov_base = slots.data() + (size_t) i * slotSize;
+        buffers[i].iov_len = (size_t) slotSize;
+
+        messages[i] = {};
+        messages[i].msg_hdr.msg_iov = &buffers[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    clear();
+}
+
+void DatagramBatch::clear()
+{
+    numReceived = 0;
+    nextIndex = 0;
+}
+
+int DatagramBatch::receive (intptr_t socketHandle)
+{
+    if (hasPending())
+        return 0;
+
+    clear();
+
+    if (sizes.empty())
+        return -1;
+
+#ifdef __linux__
+    const int rc = recvmmsg ((int) socketHandle, messages.data(), (unsigned int) messages.size(), MSG_DONTWAIT, nullptr);
+
+    if (rc < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+    for (int i = 0; i < rc; i++)
+        sizes[i] = (int) std::min (messages[i].msg_len, (unsigned int) slotSize);
+#else
+#ifdef _WIN32
+    const SOCKET handle = (SOCKET) socketHandle;
+#else
+    const int handle = (int) socketHandle;
+#endif
+
+    const int size = (int) recv (handle, (char*) slots.data(), slotSize, 0);
+
+    if (size < 0)
+        return -1;
+
+    sizes[0] = size;
+
+    const int rc = size > 0 ? 1 : 0;
+#endif
+
+    numReceived = rc;
+
+    return rc;
+}
+
+bool DatagramBatch::next (const std::byte*& data, int& size)
+{
+    if (! hasPending())
+        return false;
+
+    data = getData (nextIndex);
+    size = getSize (nextIndex);
+    nextIndex++;
+
+    return true;
+}
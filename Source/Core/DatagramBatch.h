@@ -0,0 +1,68 @@
+#ifndef __DATAGRAMBATCHH__
+#define __DATAGRAMBATCHH__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+namespace EphysSocketNode
+{
+/**
+    Receives every datagram waiting on a socket with one system call (recvmmsg
+    on Linux; one recv per call elsewhere) and hands them out one at a time.
+
+    Each datagram gets a slot of the same size; a longer one is truncated to
+    it, as a plain recv into a buffer of that size would.
+*/
+class DatagramBatch
+{
+public:
+    /** Constructor */
+    DatagramBatch();
+
+    /** Allocates maxDatagrams slots of slotSize bytes each, discarding any pending datagrams */
+    void resize (int maxDatagrams, int slotSize);
+
+    /** Discards the datagrams not handed out yet */
+    void clear();
+
+    /** Receives the datagrams waiting on a UDP socket, without blocking, once every pending one has been
+        handed out. Returns the number received (0 if none were waiting) or -1 on an error. */
+    int receive (intptr_t socketHandle);
+
+    /** Hands out the next datagram received, or returns false if there is none */
+    bool next (const std::byte*& data, int& size);
+
+    /** The i-th datagram of the last batch received, whether handed out yet or not */
+    const std::byte* getData (int i) const { return slots.data() + (size_t) i * slotSize; }
+    int getSize (int i) const { return sizes[i]; }
+
+    /** Returns the number of datagrams a batch can hold, 0 until resized */
+    int getNumSlots() const { return (int) sizes.size(); }
+
+    /** Returns true if datagrams were received but not handed out yet */
+    bool hasPending() const { return nextIndex < numReceived; }
+
+private:
+    int slotSize;
+
+    std::vector<std::byte> slots;
+    std::vector<int> sizes;
+
+#ifdef __linux__
+    /** One message per slot, set up once for every recvmmsg call */
+    std::vector<iovec> buffers;
+    std::vector<mmsghdr> messages;
+#endif
+
+    int numReceived;
+    int nextIndex;
+};
+} // namespace EphysSocketNode
+
+#endif
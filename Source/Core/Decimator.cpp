@@ -0,0 +1,220 @@
+#include "Decimator.h"
+#include "SimdSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+const double PI = 3.14159265358979323846;
+
+/** Taps are padded to a multiple of this, so the kernels never need a remainder loop */
+const int TAP_ALIGNMENT = 8;
+
+float dotScalar (const float* a, const float* b, int count)
+{
+    float sum = 0.0f;
+
+    for (int i = 0; i < count; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+#if EPHYS_SOCKET_X86
+EPHYS_SOCKET_TARGET ("sse2")
+inline float sumLanes (__m128 v)
+{
+    const __m128 pairs = _mm_add_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1)));
+    return _mm_cvtss_f32 (_mm_add_ss (pairs, _mm_movehl_ps (pairs, pairs)));
+}
+
+/** SSE2: 8 taps per step, in two accumulators */
+EPHYS_SOCKET_TARGET ("sse2")
+float dotSse2 (const float* a, const float* b, int count)
+{
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    for (int i = 0; i < count; i += 8)
+    {
+        sum0 = _mm_add_ps (sum0, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+        sum1 = _mm_add_ps (sum1, _mm_mul_ps (_mm_loadu_ps (a + i + 4), _mm_loadu_ps (b + i + 4)));
+    }
+
+    return sumLanes (_mm_add_ps (sum0, sum1));
+}
+
+/** AVX2: 16 taps per step, in two accumulators, then the last 8 if there are any */
+EPHYS_SOCKET_TARGET ("avx2")
+float dotAvx2 (const float* a, const float* b, int count)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i)));
+        sum1 = _mm256_add_ps (sum1, _mm256_mul_ps (_mm256_loadu_ps (a + i + 8), _mm256_loadu_ps (b + i + 8)));
+    }
+
+    if (i < count)
+        sum0 = _mm256_add_ps (sum0, _mm256_mul_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i)));
+
+    const __m256 sum = _mm256_add_ps (sum0, sum1);
+
+    return sumLanes (_mm_add_ps (_mm256_castps256_ps128 (sum), _mm256_extractf128_ps (sum, 1)));
+}
+#endif
+
+/** Blackman-windowed sinc low-pass of the given length, cut off at cutoff cycles per sample, with unity gain at DC */
+std::vector<double> designLowPass (int length, double cutoff)
+{
+    std::vector<double> h ((size_t) length, 1.0);
+
+    if (length == 1)
+        return h;
+
+    const double centre = (length - 1) / 2.0;
+    double sum = 0.0;
+
+    for (int n = 0; n < length; n++)
+    {
+        const double x = n - centre;
+        const double sinc = x == 0.0 ? 2.0 * cutoff : std::sin (2.0 * PI * cutoff * x) / (PI * x);
+        const double window = 0.42 - 0.5 * std::cos (2.0 * PI * n / (length - 1)) + 0.08 * std::cos (4.0 * PI * n / (length - 1));
+
+        h[n] = sinc * window;
+        sum += h[n];
+    }
+
+    for (double& tap : h)
+        tap /= sum;
+
+    return h;
+}
+} // namespace
+
+Decimator::Decimator()
+{
+    factor = 1;
+    delay = 0;
+    numChannels = 0;
+    maxInputSamples = 0;
+    numTaps = 0;
+    lineLength = 0;
+    next = 0;
+    primed = false;
+
+    setSimdLevel (DataConverter::getMaxSimdLevel());
+}
+
+void Decimator::prepare (int factor_, int numChannels_, int maxInputSamples_)
+{
+    factor = factor_ < 1 ? 1 : factor_ > MAX_FACTOR ? MAX_FACTOR : factor_;
+    numChannels = numChannels_;
+    maxInputSamples = maxInputSamples_;
+
+    const int length = factor > 1 ? TAPS_PER_PHASE * factor + 1 : 1;
+    const std::vector<double> h = designLowPass (length, CUTOFF * 0.5 / factor);
+
+    delay = (length - 1) / 2;
+    numTaps = (length + TAP_ALIGNMENT - 1) / TAP_ALIGNMENT * TAP_ALIGNMENT;
+
+    // The last tap lines up with the newest input, so the padding multiplies the oldest ones
+    taps.assign ((size_t) numTaps, 0.0f);
+
+    for (int n = 0; n < length; n++)
+        taps[numTaps - length + n] = (float) h[n];
+
+    lineLength = numTaps - 1 + maxInputSamples;
+
+    lines.assign ((size_t) numChannels * lineLength, 0.0f);
+    timestampLine.assign ((size_t) lineLength, 0.0);
+    ttlLine.assign ((size_t) lineLength, 0);
+
+    reset();
+}
+
+void Decimator::reset()
+{
+    next = 0;
+    primed = false;
+}
+
+void Decimator::setSimdLevel (SimdLevel level)
+{
+    simdLevel = (int) level < (int) DataConverter::getMaxSimdLevel() ? level : DataConverter::getMaxSimdLevel();
+
+    dot = &dotScalar;
+
+#if EPHYS_SOCKET_X86
+    if (simdLevel == SimdLevel::AVX2 || simdLevel == SimdLevel::AVX512)
+        dot = &dotAvx2;
+    else if (simdLevel == SimdLevel::SSE2)
+        dot = &dotSse2;
+#endif
+}
+
+int Decimator::process (const float* src, int srcStride, const double* timestamps, const uint64_t* ttlWords, int numSamples, float* dest, double* destTimestamps, uint64_t* destTtl)
+{
+    if (numSamples <= 0 || numSamples > maxInputSamples)
+        return 0;
+
+    const int history = numTaps - 1;
+
+    // A new signal starts as if its first sample had always been there, and its first output is
+    // centred on that sample, so every output has a timestamp and TTL word of its own
+    if (! primed)
+    {
+        for (int ch = 0; ch < numChannels; ch++)
+            std::fill_n (lines.begin() + (size_t) ch * lineLength, history, src[(size_t) ch * srcStride]);
+
+        next = delay;
+        primed = true;
+    }
+
+    for (int ch = 0; ch < numChannels; ch++)
+        std::memcpy (lines.data() + (size_t) ch * lineLength + history, src + (size_t) ch * srcStride, sizeof (float) * numSamples);
+
+    std::memcpy (timestampLine.data() + history, timestamps, sizeof (double) * numSamples);
+    std::memcpy (ttlLine.data() + history, ttlWords, sizeof (uint64_t) * numSamples);
+
+    const int numOutputs = next < numSamples ? (numSamples - next - 1) / factor + 1 : 0;
+
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        const float* line = lines.data() + (size_t) ch * lineLength;
+        float* out = dest + (size_t) ch * numOutputs;
+
+        for (int k = 0; k < numOutputs; k++)
+            out[k] = dot (taps.data(), line + next + k * factor, numTaps);
+    }
+
+    for (int k = 0; k < numOutputs; k++)
+    {
+        const int centre = history + next + k * factor - delay;
+
+        destTimestamps[k] = timestampLine[centre];
+        destTtl[k] = ttlLine[centre];
+    }
+
+    next += numOutputs * factor - numSamples;
+
+    // Keep the last inputs as the history of the next block
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        float* line = lines.data() + (size_t) ch * lineLength;
+        std::memmove (line, line + numSamples, sizeof (float) * history);
+    }
+
+    std::memmove (timestampLine.data(), timestampLine.data() + numSamples, sizeof (double) * history);
+    std::memmove (ttlLine.data(), ttlLine.data() + numSamples, sizeof (uint64_t) * history);
+
+    return numOutputs;
+}
@@ -0,0 +1,100 @@
+#ifndef __DECIMATORH__
+#define __DECIMATORH__
+
+#include "DataConverter.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/**
+    Reduces the sample rate of converted blocks by an integer factor M, so a
+    high-rate stream reaches the DataBuffer at the rate downstream processing
+    needs and nothing past it ever sees the full-rate data.
+
+    Every channel goes through a linear-phase low-pass filter (a Blackman-
+    windowed sinc of TAPS_PER_PHASE * M + 1 taps, cut off at CUTOFF of the
+    output Nyquist frequency) that is only evaluated at the samples kept: the
+    polyphase form of filtering then discarding M - 1 samples out of M. Each
+    output is one dot product over the channel's recent input, vectorized with
+    SSE2 or AVX2.
+
+    The filter delays the signal by getDelay() input samples, so every output
+    takes the timestamp and TTL word of the input sample it is centred on, and
+    events stay aligned with the data. TTL words are sampled, not filtered: a
+    pulse shorter than M input samples can fall between two outputs.
+
+    Blocks are filtered as one continuous signal; reset() starts a new one,
+    e.g. after a gap too long to fill.
+*/
+class Decimator
+{
+public:
+    /** Filter length per output phase, and the passband edge as a fraction of the output Nyquist frequency */
+    static constexpr int TAPS_PER_PHASE = 24;
+    static constexpr float CUTOFF = 0.8f;
+
+    /** Largest decimation factor supported */
+    static constexpr int MAX_FACTOR = 256;
+
+    /** Constructor */
+    Decimator();
+
+    /** Designs the filter for the given factor (1 = pass-through) and allocates room for
+        numChannels channels and blocks of up to maxInputSamples samples */
+    void prepare (int factor, int numChannels, int maxInputSamples);
+
+    /** Forgets the signal so far; the next block starts a new one */
+    void reset();
+
+    /** Caps the instruction set used by the filter (mainly for benchmarking) */
+    void setSimdLevel (SimdLevel level);
+
+    /** Returns the instruction set the filter uses */
+    SimdLevel getSimdLevel() const { return simdLevel; }
+
+    /** Returns the decimation factor, 1 when samples pass through untouched */
+    int getFactor() const { return factor; }
+
+    /** Returns the delay of the filter in input samples */
+    int getDelay() const { return delay; }
+
+    /** Returns the largest number of outputs a block of numSamples inputs can produce */
+    int getMaxOutputSamples (int numSamples) const { return numSamples / factor + 1; }
+
+    /** Filters a block of up to maxInputSamples samples per channel, whose rows start srcStride samples apart,
+        with a timestamp and TTL word per sample. Writes the outputs as channel rows that are as long
+        as the number of outputs, with their timestamps and TTL words, and returns that number. */
+    int process (const float* src, int srcStride, const double* timestamps, const uint64_t* ttlWords, int numSamples, float* dest, double* destTimestamps, uint64_t* destTtl);
+
+private:
+    using DotKernel = float (*) (const float* a, const float* b, int count);
+
+    int factor;
+    int delay;
+    int numChannels;
+    int maxInputSamples;
+
+    /** Taps, zero-padded at the front to a multiple of 8 */
+    std::vector<float> taps;
+    int numTaps;
+
+    /** Per channel, the last numTaps - 1 inputs followed by the block being filtered */
+    std::vector<float> lines;
+    int lineLength;
+
+    /** Timestamps and TTL words of the same inputs */
+    std::vector<double> timestampLine;
+    std::vector<uint64_t> ttlLine;
+
+    /** Position of the next output in the next block, counted from its first sample */
+    int next;
+    bool primed;
+
+    SimdLevel simdLevel;
+    DotKernel dot;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,366 @@
+#include "DeltaCodec.h"
+#include "SimdSupport.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+const int GROUP = DeltaCodec::GROUP_CHANNELS;
+const int BLOCK = DeltaCodec::BLOCK_SAMPLES;
+
+/** Bytes of a group's first samples, and of one packed word of all its lanes */
+const int FIRST_SAMPLES_SIZE = GROUP * 2;
+const int WORD_SIZE = GROUP * 2;
+
+/** Maps small negative and positive differences alike to small codes: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ... */
+inline uint16_t zigzag (uint16_t delta)
+{
+    return (uint16_t) ((delta << 1) ^ ((delta & 0x8000) != 0 ? 0xffff : 0));
+}
+
+inline uint16_t unzigzag (uint16_t code)
+{
+    return (uint16_t) ((code >> 1) ^ (uint16_t) (0 - (code & 1)));
+}
+
+/** Byte position of channel ch, sample s in a matrix of 16-bit samples */
+inline size_t getSampleOffset (int ch, int s, int numChannels, int numSamples, Layout layout)
+{
+    return 2 * (layout == INTERLEAVED ? (size_t) s * numChannels + ch : (size_t) ch * numSamples + s);
+}
+
+inline uint16_t loadSample (const std::byte* matrix, size_t offset)
+{
+    uint16_t value;
+    std::memcpy (&value, matrix + offset, 2);
+    return value;
+}
+
+/** Lane l of packed word k of a block */
+inline uint16_t loadWord (const std::byte* words, int k, int l)
+{
+    return loadSample (words, (size_t) k * WORD_SIZE + 2 * l);
+}
+
+/** Writes the first numSamples rows of a decoded tile (one row of GROUP lanes per sample) for
+    channels ch0 to ch0 + numLanes - 1, starting at sample s0 */
+void storeTile (const uint16_t* tile, int numRows, int numLanes, std::byte* matrix, int numChannels, int numSamples, int ch0, int s0, Layout layout)
+{
+    if (layout == INTERLEAVED)
+    {
+        for (int t = 0; t < numRows; t++)
+            std::memcpy (matrix + getSampleOffset (ch0, s0 + t, numChannels, numSamples, layout), tile + t * GROUP, (size_t) numLanes * 2);
+
+        return;
+    }
+
+    for (int l = 0; l < numLanes; l++)
+    {
+        std::byte* row = matrix + getSampleOffset (ch0 + l, s0, numChannels, numSamples, layout);
+
+        for (int t = 0; t < numRows; t++)
+            std::memcpy (row + 2 * t, tile + t * GROUP + l, 2);
+    }
+}
+
+/** Unpacks one block into tile, one row of GROUP lanes per sample, continuing from the previous sample of each lane */
+void unpackBlockScalar (const std::byte* words, int width, uint16_t* previous, uint16_t* tile)
+{
+    const uint32_t mask = (1u << width) - 1;
+
+    for (int l = 0; l < GROUP; l++)
+    {
+        uint16_t value = previous[l];
+
+        for (int t = 0; t < BLOCK; t++)
+        {
+            uint32_t code = 0;
+
+            if (width > 0)
+            {
+                const int bit = t * width;
+                const int k = bit >> 4;
+                const int shift = bit & 15;
+
+                code = (uint32_t) loadWord (words, k, l) >> shift;
+
+                if (shift + width > 16)
+                    code |= (uint32_t) loadWord (words, k + 1, l) << (16 - shift);
+            }
+
+            value = (uint16_t) (value + unzigzag ((uint16_t) (code & mask)));
+            tile[t * GROUP + l] = value;
+        }
+
+        previous[l] = value;
+    }
+}
+
+#if EPHYS_SOCKET_X86
+
+/** unpackBlockScalar() for all GROUP lanes at once */
+EPHYS_SOCKET_TARGET ("sse2")
+void unpackBlockSse2 (const std::byte* words, int width, uint16_t* previous, uint16_t* tile)
+{
+    __m128i value = _mm_loadu_si128 ((const __m128i*) previous);
+
+    if (width == 0)
+    {
+        for (int t = 0; t < BLOCK; t++)
+            _mm_store_si128 ((__m128i*) (tile + t * GROUP), value);
+
+        return;
+    }
+
+    __m128i packed[BLOCK];
+
+    for (int k = 0; k < width; k++)
+        packed[k] = _mm_loadu_si128 ((const __m128i*) (words + (size_t) k * WORD_SIZE));
+
+    const __m128i mask = _mm_set1_epi16 ((short) ((1 << width) - 1));
+    const __m128i one = _mm_set1_epi16 (1);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int t = 0; t < BLOCK; t++)
+    {
+        const int bit = t * width;
+        const int k = bit >> 4;
+        const int shift = bit & 15;
+
+        __m128i code = _mm_srl_epi16 (packed[k], _mm_cvtsi32_si128 (shift));
+
+        if (shift + width > 16)
+            code = _mm_or_si128 (code, _mm_sll_epi16 (packed[k + 1], _mm_cvtsi32_si128 (16 - shift)));
+
+        code = _mm_and_si128 (code, mask);
+
+        const __m128i delta = _mm_xor_si128 (_mm_srli_epi16 (code, 1), _mm_sub_epi16 (zero, _mm_and_si128 (code, one)));
+        value = _mm_add_epi16 (value, delta);
+
+        _mm_store_si128 ((__m128i*) (tile + t * GROUP), value);
+    }
+
+    _mm_storeu_si128 ((__m128i*) previous, value);
+}
+
+/** Transposes 8 rows of 8 lanes into 8 rows of 8 samples, one per lane */
+EPHYS_SOCKET_TARGET ("sse2")
+void transpose8x8Sse2 (const uint16_t* tile, __m128i* columns)
+{
+    __m128i r[8];
+
+    for (int t = 0; t < 8; t++)
+        r[t] = _mm_load_si128 ((const __m128i*) (tile + t * GROUP));
+
+    const __m128i a0 = _mm_unpacklo_epi16 (r[0], r[1]);
+    const __m128i a1 = _mm_unpackhi_epi16 (r[0], r[1]);
+    const __m128i a2 = _mm_unpacklo_epi16 (r[2], r[3]);
+    const __m128i a3 = _mm_unpackhi_epi16 (r[2], r[3]);
+    const __m128i a4 = _mm_unpacklo_epi16 (r[4], r[5]);
+    const __m128i a5 = _mm_unpackhi_epi16 (r[4], r[5]);
+    const __m128i a6 = _mm_unpacklo_epi16 (r[6], r[7]);
+    const __m128i a7 = _mm_unpackhi_epi16 (r[6], r[7]);
+
+    const __m128i b0 = _mm_unpacklo_epi32 (a0, a2);
+    const __m128i b1 = _mm_unpackhi_epi32 (a0, a2);
+    const __m128i b2 = _mm_unpacklo_epi32 (a1, a3);
+    const __m128i b3 = _mm_unpackhi_epi32 (a1, a3);
+    const __m128i b4 = _mm_unpacklo_epi32 (a4, a6);
+    const __m128i b5 = _mm_unpackhi_epi32 (a4, a6);
+    const __m128i b6 = _mm_unpacklo_epi32 (a5, a7);
+    const __m128i b7 = _mm_unpackhi_epi32 (a5, a7);
+
+    columns[0] = _mm_unpacklo_epi64 (b0, b4);
+    columns[1] = _mm_unpackhi_epi64 (b0, b4);
+    columns[2] = _mm_unpacklo_epi64 (b1, b5);
+    columns[3] = _mm_unpackhi_epi64 (b1, b5);
+    columns[4] = _mm_unpacklo_epi64 (b2, b6);
+    columns[5] = _mm_unpackhi_epi64 (b2, b6);
+    columns[6] = _mm_unpacklo_epi64 (b3, b7);
+    columns[7] = _mm_unpackhi_epi64 (b3, b7);
+}
+
+/** storeTile() for a whole channel-major tile: every channel gets BLOCK contiguous samples */
+EPHYS_SOCKET_TARGET ("sse2")
+void storeChannelMajorTileSse2 (const uint16_t* tile, std::byte* matrix, int numSamples, int ch0, int s0)
+{
+    __m128i first[8];
+    __m128i second[8];
+
+    transpose8x8Sse2 (tile, first);
+    transpose8x8Sse2 (tile + 8 * GROUP, second);
+
+    for (int l = 0; l < GROUP; l++)
+    {
+        std::byte* row = matrix + 2 * ((size_t) (ch0 + l) * numSamples + s0);
+
+        _mm_storeu_si128 ((__m128i*) row, first[l]);
+        _mm_storeu_si128 ((__m128i*) (row + 16), second[l]);
+    }
+}
+
+#endif
+
+} // namespace
+
+DeltaCodec::DeltaCodec()
+{
+    simdLevel = DataConverter::getMaxSimdLevel();
+}
+
+void DeltaCodec::setSimdLevel (SimdLevel level)
+{
+    simdLevel = (int) level < (int) DataConverter::getMaxSimdLevel() ? level : DataConverter::getMaxSimdLevel();
+}
+
+bool DeltaCodec::isSupported (Depth depth, int elementSize)
+{
+    return (depth == U16 || depth == S16) && elementSize == 2;
+}
+
+int DeltaCodec::getMaxCompressedSize (int numChannels, int numSamples)
+{
+    const int numGroups = (numChannels + GROUP - 1) / GROUP;
+    const int numBlocks = numSamples > 1 ? (numSamples - 1 + BLOCK - 1) / BLOCK : 0;
+
+    return numGroups * (FIRST_SAMPLES_SIZE + numBlocks * (1 + 16 * WORD_SIZE));
+}
+
+int DeltaCodec::encode (const std::byte* matrix, int numChannels, int numSamples, Layout layout, std::byte* dest, int maxBytes)
+{
+    int size = 0;
+
+    for (int ch0 = 0; ch0 < numChannels; ch0 += GROUP)
+    {
+        const int numLanes = numChannels - ch0 < GROUP ? numChannels - ch0 : GROUP;
+
+        uint16_t previous[GROUP] = {};
+
+        if (numSamples > 0)
+        {
+            for (int l = 0; l < numLanes; l++)
+                previous[l] = loadSample (matrix, getSampleOffset (ch0 + l, 0, numChannels, numSamples, layout));
+        }
+
+        if (size + FIRST_SAMPLES_SIZE > maxBytes)
+            return -1;
+
+        std::memcpy (dest + size, previous, FIRST_SAMPLES_SIZE);
+        size += FIRST_SAMPLES_SIZE;
+
+        for (int s0 = 1; s0 < numSamples; s0 += BLOCK)
+        {
+            const int numRows = numSamples - s0 < BLOCK ? numSamples - s0 : BLOCK;
+
+            uint16_t codes[BLOCK][GROUP] = {};
+            uint32_t combined = 0;
+
+            for (int t = 0; t < numRows; t++)
+            {
+                for (int l = 0; l < numLanes; l++)
+                {
+                    const uint16_t value = loadSample (matrix, getSampleOffset (ch0 + l, s0 + t, numChannels, numSamples, layout));
+
+                    codes[t][l] = zigzag ((uint16_t) (value - previous[l]));
+                    combined |= codes[t][l];
+                    previous[l] = value;
+                }
+            }
+
+            int width = 0;
+
+            while (width < 16 && (combined >> width) != 0)
+                width++;
+
+            if (size + 1 + width * WORD_SIZE > maxBytes)
+                return -1;
+
+            uint16_t words[16][GROUP] = {};
+
+            for (int t = 0; t < BLOCK && width > 0; t++)
+            {
+                const int bit = t * width;
+                const int k = bit >> 4;
+                const int shift = bit & 15;
+
+                for (int l = 0; l < GROUP; l++)
+                {
+                    words[k][l] |= (uint16_t) (codes[t][l] << shift);
+
+                    if (shift + width > 16)
+                        words[k + 1][l] |= (uint16_t) (codes[t][l] >> (16 - shift));
+                }
+            }
+
+            dest[size] = (std::byte) width;
+            std::memcpy (dest + size + 1, words, (size_t) width * WORD_SIZE);
+            size += 1 + width * WORD_SIZE;
+        }
+    }
+
+    return size;
+}
+
+bool DeltaCodec::decode (const std::byte* src, int numBytes, int numChannels, int numSamples, Layout layout, std::byte* matrix) const
+{
+    const std::byte* const end = src + numBytes;
+
+#if EPHYS_SOCKET_X86
+    const bool sse2 = simdLevel != SimdLevel::SCALAR;
+#endif
+
+    alignas (16) uint16_t tile[BLOCK * GROUP];
+
+    for (int ch0 = 0; ch0 < numChannels; ch0 += GROUP)
+    {
+        const int numLanes = numChannels - ch0 < GROUP ? numChannels - ch0 : GROUP;
+
+        if (end - src < FIRST_SAMPLES_SIZE)
+            return false;
+
+        alignas (16) uint16_t previous[GROUP];
+        std::memcpy (previous, src, FIRST_SAMPLES_SIZE);
+        src += FIRST_SAMPLES_SIZE;
+
+        if (numSamples > 0)
+            storeTile (previous, 1, numLanes, matrix, numChannels, numSamples, ch0, 0, layout);
+
+        for (int s0 = 1; s0 < numSamples; s0 += BLOCK)
+        {
+            if (src == end)
+                return false;
+
+            const int width = (int) src[0];
+
+            if (width > 16 || end - src - 1 < width * WORD_SIZE)
+                return false;
+
+            const int numRows = numSamples - s0 < BLOCK ? numSamples - s0 : BLOCK;
+
+#if EPHYS_SOCKET_X86
+            if (sse2)
+            {
+                unpackBlockSse2 (src + 1, width, previous, tile);
+
+                if (layout == CHANNEL_MAJOR && numRows == BLOCK && numLanes == GROUP)
+                    storeChannelMajorTileSse2 (tile, matrix, numSamples, ch0, s0);
+                else
+                    storeTile (tile, numRows, numLanes, matrix, numChannels, numSamples, ch0, s0, layout);
+
+                src += 1 + width * WORD_SIZE;
+                continue;
+            }
+#endif
+
+            unpackBlockScalar (src + 1, width, previous, tile);
+            storeTile (tile, numRows, numLanes, matrix, numChannels, numSamples, ch0, s0, layout);
+
+            src += 1 + width * WORD_SIZE;
+        }
+    }
+
+    return src == end;
+}
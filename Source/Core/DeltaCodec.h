@@ -0,0 +1,71 @@
+#ifndef __DELTACODECH__
+#define __DELTACODECH__
+
+#include "DataConverter.h"
+
+#include <cstddef>
+
+namespace EphysSocketNode
+{
+/**
+    Lossless compression of 16-bit matrices (U16 and S16), carried by packets
+    flagged with FLAG_COMPRESSED. Every channel is delta-coded along time, and
+    the deltas are bit-packed in blocks that each have their own bit width, so
+    quiet stretches take a few bits per sample and a spike only widens its block.
+
+    Channels are coded in groups of GROUP_CHANNELS, one per 16-bit lane of a
+    128-bit vector, so the decoder unpacks a sample of the whole group, undoes
+    the delta and stores it with a handful of SSE2 instructions. For each group,
+    in channel order:
+
+        16 bytes        sample 0 of every channel of the group (uint16, little-endian)
+        then, for each block of BLOCK_SAMPLES samples from sample 1 on:
+            1 byte      bit width b of the block, 0 to 16
+            16 * b      b words of GROUP_CHANNELS lanes (uint16, little-endian); bits
+                        t * b to t * b + b - 1 of lane l, counting from bit 0 of the
+                        first word, hold the zigzag-coded difference between sample t
+                        of the block and the sample before it, for the group's channel l
+
+    Channels past the last one in the final group, and samples past the last
+    one in the final block, are coded as zero deltas. The payload decodes to
+    exactly the matrix a raw packet would have carried, in the stream's layout.
+
+    A matrix of wideband noise can come out slightly larger than raw; encode()
+    then fails, and the sender sends that matrix uncompressed instead.
+*/
+class DeltaCodec
+{
+public:
+    /** Channels coded side by side, and samples sharing a bit width */
+    static constexpr int GROUP_CHANNELS = 8;
+    static constexpr int BLOCK_SAMPLES = 16;
+
+    /** Constructor */
+    DeltaCodec();
+
+    /** Caps the instruction set used by the decoder (mainly for benchmarking) */
+    void setSimdLevel (SimdLevel level);
+
+    /** Returns the instruction set the decoder uses */
+    SimdLevel getSimdLevel() const { return simdLevel; }
+
+    /** Returns true if matrices of this sample type can be compressed */
+    static bool isSupported (Depth depth, int elementSize);
+
+    /** Returns the size of the largest payload a numChannels x numSamples matrix can compress to */
+    static int getMaxCompressedSize (int numChannels, int numSamples);
+
+    /** Reference encoder for senders: compresses a numChannels x numSamples matrix of 16-bit samples
+        in the given layout into dest. Returns the size of the payload, or -1 if it needs more than maxBytes. */
+    static int encode (const std::byte* matrix, int numChannels, int numSamples, Layout layout, std::byte* dest, int maxBytes);
+
+    /** Decodes numBytes of payload into a numChannels x numSamples matrix in the given layout.
+        Returns false if the payload is malformed, leaving the matrix partly written. */
+    bool decode (const std::byte* src, int numBytes, int numChannels, int numSamples, Layout layout, std::byte* matrix) const;
+
+private:
+    SimdLevel simdLevel;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,190 @@
+#include "EphysSocketHeader.h"
+
+#include <limits>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+inline uint32_t readUInt16 (const std::byte* bytes)
+{
+    return (uint32_t) bytes[1] << 8 | (uint32_t) bytes[0];
+}
+
+inline uint32_t readUInt32 (const std::byte* bytes)
+{
+    return (uint32_t) bytes[3] << 24 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[0];
+}
+
+inline int64_t readInt64 (const std::byte* bytes)
+{
+    return (int64_t) ((uint64_t) readUInt32 (bytes + 4) << 32 | (uint64_t) readUInt32 (bytes));
+}
+
+inline void writeLittleEndian (std::byte* dest, uint64_t value, int numBytes)
+{
+    for (int i = 0; i < numBytes; i++)
+        dest[i] = (std::byte) (value >> (8 * i));
+}
+} // namespace
+
+EphysSocketHeader::EphysSocketHeader()
+{
+    offset = 0;
+    num_bytes = 1024;
+    depth = U16;
+    element_size = 2;
+    num_channels = 1;
+    num_samp = 512;
+
+    flags = 0;
+    extension_size = 0;
+    sample_index = -1;
+    sender_time_ns = 0;
+    checksum = 0;
+    ttl_rows = 0;
+    ttl_bits = 0;
+}
+
+EphysSocketHeader::EphysSocketHeader (std::vector<std::byte>& header_bytes) : EphysSocketHeader (header_bytes.data())
+{
+}
+
+EphysSocketHeader::EphysSocketHeader (std::vector<std::byte>& header_bytes, int _offset) : EphysSocketHeader (header_bytes.data() + _offset)
+{
+}
+
+EphysSocketHeader::EphysSocketHeader (const std::byte* header_bytes)
+{
+    offset = (int) header_bytes[3] << 24 | (int) header_bytes[2] << 16 | (int) header_bytes[1] << 8 | (int) header_bytes[0];
+    num_bytes = (int) header_bytes[7] << 24 | (int) header_bytes[6] << 16 | (int) header_bytes[5] << 8 | (int) header_bytes[4];
+    depth = (Depth) header_bytes[8];
+    flags = (int) header_bytes[9];
+    element_size = (int) header_bytes[13] << 24 | (int) header_bytes[12] << 16 | (int) header_bytes[11] << 8 | (int) header_bytes[10];
+    num_channels = (int) header_bytes[17] << 24 | (int) header_bytes[16] << 16 | (int) header_bytes[15] << 8 | (int) header_bytes[14];
+    num_samp = (int) header_bytes[21] << 24 | (int) header_bytes[20] << 16 | (int) header_bytes[19] << 8 | (int) header_bytes[18];
+
+    extension_size = 0;
+    sample_index = -1;
+    sender_time_ns = 0;
+    checksum = 0;
+    ttl_rows = 0;
+    ttl_bits = 0;
+}
+
+EphysSocketHeader::EphysSocketHeader (int _num_bytes, Depth _depth, int _element_size, int _num_samp, int _num_channels)
+{
+    offset = 0;
+    num_bytes = _num_bytes;
+    depth = _depth;
+    element_size = _element_size;
+    num_samp = _num_samp;
+    num_channels = _num_channels;
+
+    flags = 0;
+    extension_size = 0;
+    sample_index = -1;
+    sender_time_ns = 0;
+    checksum = 0;
+    ttl_rows = 0;
+    ttl_bits = 0;
+}
+
+int EphysSocketHeader::getExtensionSize (const std::byte* header_bytes)
+{
+    const std::byte* extension = header_bytes + HEADER_SIZE;
+    const int size = (int) readUInt16 (extension + 6);
+
+    if (readUInt32 (extension) != EXTENSION_MAGIC || (int) readUInt16 (extension + 4) < EXTENSION_VERSION || size < EXTENSION_SIZE || size > MAX_EXTENSION_SIZE)
+        return -1;
+
+    return size;
+}
+
+bool EphysSocketHeader::parseExtension (const std::byte* header_bytes)
+{
+    if (! isExtended())
+        return false;
+
+    const int size = getExtensionSize (header_bytes);
+
+    if (size < 0)
+        return false;
+
+    const std::byte* extension = header_bytes + HEADER_SIZE;
+
+    extension_size = size;
+    sample_index = readInt64 (extension + 8);
+    sender_time_ns = readInt64 (extension + 16);
+    checksum = readUInt32 (extension + 24);
+    ttl_rows = (int) extension[28];
+    ttl_bits = (int) extension[29];
+
+    return true;
+}
+
+bool EphysSocketHeader::isValid() const
+{
+    const int depth_size = getDepthSize (depth);
+
+    if (num_samp <= 0 || num_channels <= 0 || depth_size == 0 || element_size != depth_size)
+        return false;
+
+    return (int64_t) num_channels * num_samp * element_size <= std::numeric_limits<int>::max() - HEADER_SIZE - MAX_EXTENSION_SIZE;
+}
+
+int EphysSocketHeader::getPayloadSize (int matrixSize) const
+{
+    if (offset == 0 && ! isCompressed() && (num_bytes <= 0 || num_bytes > matrixSize))
+        return matrixSize;
+
+    return num_bytes;
+}
+
+int EphysSocketHeader::getDepthSize (Depth depth)
+{
+    switch (depth)
+    {
+        case U8:
+        case S8:
+            return 1;
+        case U16:
+        case S16:
+            return 2;
+        case S32:
+        case F32:
+            return 4;
+        case F64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+void EphysSocketHeader::write (std::byte* dest) const
+{
+    writeLittleEndian (dest, (uint32_t) offset, 4);
+    writeLittleEndian (dest + 4, (uint32_t) num_bytes, 4);
+    writeLittleEndian (dest + 8, (uint32_t) depth, 1);
+    writeLittleEndian (dest + 9, (uint32_t) flags, 1);
+    writeLittleEndian (dest + 10, (uint32_t) element_size, 4);
+    writeLittleEndian (dest + 14, (uint32_t) num_channels, 4);
+    writeLittleEndian (dest + 18, (uint32_t) num_samp, 4);
+
+    if (! isExtended())
+        return;
+
+    std::byte* extension = dest + HEADER_SIZE;
+
+    writeLittleEndian (extension, EXTENSION_MAGIC, 4);
+    writeLittleEndian (extension + 4, EXTENSION_VERSION, 2);
+    writeLittleEndian (extension + 6, (uint32_t) extension_size, 2);
+    writeLittleEndian (extension + 8, (uint64_t) sample_index, 8);
+    writeLittleEndian (extension + 16, (uint64_t) sender_time_ns, 8);
+    writeLittleEndian (extension + 24, checksum, 4);
+    writeLittleEndian (extension + 28, (uint32_t) ttl_rows, 1);
+    writeLittleEndian (extension + 29, (uint32_t) ttl_bits, 1);
+
+    for (int i = 30; i < extension_size; i++)
+        extension[i] = std::byte { 0 };
+}
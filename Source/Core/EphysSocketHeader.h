@@ -0,0 +1,120 @@
+#ifndef __EPHYSHEADERH__
+#define __EPHYSHEADERH__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace EphysSocketNode
+{
+enum Depth
+{
+    U8,
+    S8,
+    U16,
+    S16,
+    S32,
+    F32,
+    F64
+};
+
+/** Socket parameters */
+const int HEADER_SIZE = 22;
+
+/** Flags in the high byte of the depth field. Senders that predate them leave it zero. */
+enum HeaderFlags
+{
+    FLAG_EXTENDED = 0x01, // an extension follows the header
+    FLAG_CHECKSUM = 0x02, // the extension holds the CRC32C of the payload
+    FLAG_COMPRESSED = 0x04 // the payload is a whole matrix compressed by DeltaCodec, num_bytes long
+};
+
+/** Extension that follows the header when FLAG_EXTENDED is set:
+
+        bytes 0-3     magic, "EPH2"
+        bytes 4-5     version
+        bytes 6-7     size of the extension in bytes, at least EXTENSION_SIZE
+        bytes 8-15    index of the first sample of the matrix since the sender started
+        bytes 16-23   sender time when the matrix was sent, in nanoseconds since the Unix epoch
+        bytes 24-27   CRC32C of this packet's payload, if FLAG_CHECKSUM is set
+        byte  28      number of digital rows at the end of the matrix, 0 if none
+        byte  29      digital lines per row, 0 for the element width
+        bytes 30-31   reserved, zero
+
+    Every fragment of a matrix carries the same sample index and sender time.
+    Later versions may append fields; receivers skip the bytes they don't know. */
+const int EXTENSION_SIZE = 32;
+const int MAX_EXTENSION_SIZE = 256;
+const uint32_t EXTENSION_MAGIC = 0x32485045;
+const int EXTENSION_VERSION = 2;
+
+/** Bytes of the extension needed to know its size */
+const int EXTENSION_PREAMBLE_SIZE = 8;
+
+struct EphysSocketHeader
+{
+public:
+    EphysSocketHeader();
+
+    EphysSocketHeader (std::vector<std::byte>& header_bytes);
+
+    EphysSocketHeader (std::vector<std::byte>& header_bytes, int _offset);
+
+    /** Parses the 22-byte header; the extension, if any, is parsed by parseExtension() */
+    EphysSocketHeader (const std::byte* header_bytes);
+
+    EphysSocketHeader (int _num_bytes, Depth _depth, int _element_size, int _num_samp, int _num_channels);
+
+    /** Parses the extension that follows the header in header_bytes, which must hold the
+        whole extension. Returns false if it isn't a valid extension. */
+    bool parseExtension (const std::byte* header_bytes);
+
+    /** Returns the size of the extension from its preamble (the EXTENSION_PREAMBLE_SIZE bytes
+        after the header), or -1 if the preamble isn't valid */
+    static int getExtensionSize (const std::byte* header_bytes);
+
+    /** Writes the header, and the extension if FLAG_EXTENDED is set, to dest (getSize() bytes).
+        The checksum is written as is; the sender computes it over the payload. */
+    void write (std::byte* dest) const;
+
+    /** Returns true if the matrix the header describes can be received: at least one sample and
+        channel, a known depth, elements of its size, and a size that fits in an int */
+    bool isValid() const;
+
+    /** Returns the size of the payload that follows the header, for matrices of matrixSize bytes.
+        Senders that predate fragmentation may leave num_bytes 0 or out of range in a packet
+        that carries a whole matrix; its payload is then the matrix. */
+    int getPayloadSize (int matrixSize) const;
+
+    /** Returns the size of a sample of the given depth in bytes, or 0 if the depth is unknown */
+    static int getDepthSize (Depth depth);
+
+    bool isExtended() const { return (flags & FLAG_EXTENDED) != 0; }
+
+    bool hasChecksum() const { return (flags & (FLAG_EXTENDED | FLAG_CHECKSUM)) == (FLAG_EXTENDED | FLAG_CHECKSUM); }
+
+    bool isCompressed() const { return (flags & FLAG_COMPRESSED) != 0; }
+
+    /** Returns the size of the header including its extension */
+    int getSize() const { return HEADER_SIZE + (isExtended() ? extension_size : 0); }
+
+    int offset;
+    int num_bytes;
+    Depth depth;
+    int element_size;
+    int num_samp;
+    int num_channels;
+
+    int flags;
+
+    /** Extension fields, valid once parseExtension() succeeded */
+    int extension_size;
+    int64_t sample_index;
+    int64_t sender_time_ns;
+    uint32_t checksum;
+    int ttl_rows;
+    int ttl_bits;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,47 @@
+#include "FrameReader.h"
+
+#include <algorithm>
+
+using namespace EphysSocketNode;
+
+FrameReader::FrameReader() : header (HEADER_SIZE)
+{
+}
+
+void FrameReader::reset (int matrixSize, int headerSize, Layout layout)
+{
+    assembler.reset (matrixSize, headerSize, layout);
+    header.resize (headerSize);
+    discard.resize (matrixSize);
+}
+
+ReadStatus FrameReader::readPacket (ByteSource& source, std::byte* packet)
+{
+    ReadStatus status = source.read (header.data(), (int) header.size(), false);
+
+    if (status != PACKET_READY)
+    {
+        return status;
+    }
+
+    const EphysSocketHeader fragment (header.data());
+    const int payloadSize = fragment.getPayloadSize ((int) discard.size());
+
+    // A header of another size can't be framed either: the stream would be read out of step from here
+    if (payloadSize < 0 || payloadSize > (int) discard.size() || fragment.isExtended() != (header.size() > HEADER_SIZE))
+    {
+        std::copy (header.begin(), header.end(), packet);
+        return INVALID_HEADER;
+    }
+
+    std::byte* payload = assembler.beginFragment (header.data(), packet);
+
+    status = source.read (payload != nullptr ? payload : discard.data(), payloadSize, true);
+
+    if (status != PACKET_READY)
+    {
+        return status;
+    }
+
+    return payload != nullptr && assembler.finishFragment() ? PACKET_READY : NO_DATA;
+}
@@ -0,0 +1,64 @@
+#ifndef __FRAMEREADERH__
+#define __FRAMEREADERH__
+
+#include "PacketAssembler.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/** Outcome of waiting for the next packet */
+enum ReadStatus
+{
+    PACKET_READY,
+    NO_DATA,
+    STREAM_CLOSED,
+    READ_ERROR,
+    INVALID_HEADER
+};
+
+/** A connected byte stream, such as a TCP socket, that packets are framed from */
+class ByteSource
+{
+public:
+    virtual ~ByteSource() = default;
+
+    /** Reads exactly numBytes into dest and returns PACKET_READY, or gives up with another status.
+        Returns NO_DATA if nothing arrived in time, unless midFragment is set or part of the bytes has arrived. */
+    virtual ReadStatus read (std::byte* dest, int numBytes, bool midFragment) = 0;
+};
+
+/**
+    Frames a byte stream into fragments (header + num_bytes of payload) and
+    reassembles them, reading every payload straight into its place in the packet.
+*/
+class FrameReader
+{
+public:
+    /** Constructor */
+    FrameReader();
+
+    /** Sets the size of the matrices to assemble, the header (including any extension) in front of
+        every fragment and the layout compressed matrices are decoded to, and discards any partial matrix */
+    void reset (int matrixSize, int headerSize = HEADER_SIZE, Layout layout = CHANNEL_MAJOR);
+
+    /** Reads the next fragment from source into packet (header + matrix).
+        Returns PACKET_READY once the matrix is complete, and NO_DATA if the fragment didn't complete it. */
+    ReadStatus readPacket (ByteSource& source, std::byte* packet);
+
+    /** Returns the reassembly state and counters */
+    PacketAssembler& getAssembler() { return assembler; }
+    const PacketAssembler& getAssembler() const { return assembler; }
+
+private:
+    PacketAssembler assembler;
+
+    std::vector<std::byte> header;
+
+    /** Receives payloads that the assembler rejects, to keep the stream aligned */
+    std::vector<std::byte> discard;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,65 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+using namespace EphysSocketNode;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bin : bins)
+        bin.store (0, std::memory_order_relaxed);
+
+    count = 0;
+    totalNs = 0;
+    maxNs = 0;
+}
+
+void LatencyHistogram::record (int64_t latencyNs)
+{
+    latencyNs = std::max ((int64_t) 0, latencyNs);
+
+    const int bin = (int) std::min ((int64_t) NUM_BINS - 1, latencyNs / (BIN_US * 1000));
+
+    // Only one thread records, so the read-modify-writes need not be atomic
+    bins[bin].store (bins[bin].load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    totalNs.store (totalNs.load (std::memory_order_relaxed) + latencyNs, std::memory_order_relaxed);
+
+    if (latencyNs > maxNs.load (std::memory_order_relaxed))
+        maxNs.store (latencyNs, std::memory_order_relaxed);
+
+    count.store (count.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+double LatencyHistogram::getMeanUs() const
+{
+    const int64_t n = count;
+
+    return n > 0 ? totalNs / 1e3 / n : 0.0;
+}
+
+double LatencyHistogram::getPercentileUs (double p) const
+{
+    const int64_t n = count;
+
+    if (n == 0)
+        return 0.0;
+
+    const int64_t rank = std::max ((int64_t) 1, (int64_t) (std::clamp (p, 0.0, 1.0) * n + 0.5));
+    int64_t seen = 0;
+
+    for (int bin = 0; bin < NUM_BINS - 1; bin++)
+    {
+        seen += bins[bin].load (std::memory_order_relaxed);
+
+        if (seen >= rank)
+            return std::min ((double) (bin + 1) * BIN_US, getMaxUs());
+    }
+
+    return getMaxUs();
+}
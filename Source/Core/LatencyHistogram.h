@@ -0,0 +1,55 @@
+#ifndef __LATENCYHISTOGRAMH__
+#define __LATENCYHISTOGRAMH__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/**
+    Distribution of per-packet latencies, in fixed bins so that recording one
+    never allocates. Latencies are binned to BIN_US microseconds up to
+    MAX_BINNED_US; longer ones only count towards the mean, the maximum and the
+    last bin.
+
+    One thread records; any thread may read the statistics while it does.
+*/
+class LatencyHistogram
+{
+public:
+    /** Width of one bin, and the longest latency binned on its own */
+    static constexpr int BIN_US = 10;
+    static constexpr int MAX_BINNED_US = 10000;
+
+    /** Constructor */
+    LatencyHistogram();
+
+    /** Forgets every recorded latency */
+    void reset();
+
+    /** Records one latency, in nanoseconds */
+    void record (int64_t latencyNs);
+
+    int64_t getCount() const { return count; }
+
+    double getMeanUs() const;
+
+    double getMaxUs() const { return maxNs / 1e3; }
+
+    /** Returns the latency that a fraction p (0 to 1) of the recorded ones did not exceed,
+        to within one bin, or the maximum if it falls in the last bin */
+    double getPercentileUs (double p) const;
+
+private:
+    static constexpr int NUM_BINS = MAX_BINNED_US / BIN_US + 1;
+
+    std::array<std::atomic<int64_t>, NUM_BINS> bins;
+
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> totalNs;
+    std::atomic<int64_t> maxNs;
+};
+} // namespace EphysSocketNode
+
+#endif
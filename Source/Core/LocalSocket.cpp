@@ -0,0 +1,124 @@
+#include "LocalSocket.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace EphysSocketNode;
+
+LocalSocket::LocalSocket()
+{
+    handle = -1;
+}
+
+LocalSocket::~LocalSocket()
+{
+    close();
+}
+
+bool LocalSocket::isSupported()
+{
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+#ifdef _WIN32
+
+bool LocalSocket::connect (const std::string&) { return false; }
+void LocalSocket::close() {}
+int LocalSocket::waitUntilReady (int) { return -1; }
+int LocalSocket::read (std::byte*, int, bool) { return -1; }
+
+#else
+
+bool LocalSocket::connect (const std::string& path)
+{
+    close();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if (path.empty() || path.size() >= sizeof (address.sun_path))
+        return false;
+
+    std::memcpy (address.sun_path, path.c_str(), path.size() + 1);
+
+    handle = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+    if (handle < 0)
+        return false;
+
+    if (::connect (handle, (const sockaddr*) &address, sizeof (address)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void LocalSocket::close()
+{
+    if (handle >= 0)
+    {
+        ::close (handle);
+        handle = -1;
+    }
+}
+
+int LocalSocket::waitUntilReady (int timeoutMs)
+{
+    if (handle < 0)
+        return -1;
+
+    pollfd fd { handle, POLLIN, 0 };
+
+    const int rc = poll (&fd, 1, timeoutMs);
+
+    if (rc < 0)
+        return errno == EINTR ? 0 : -1;
+
+    return rc > 0 ? 1 : 0;
+}
+
+int LocalSocket::read (std::byte* dest, int numBytes, bool block)
+{
+    if (handle < 0)
+        return -1;
+
+    // Like StreamingSocket, a read that doesn't block returns 0 rather than waiting for the first byte
+    if (! block && waitUntilReady (0) == 0)
+        return 0;
+
+    int bytesRead = 0;
+
+    while (bytesRead < numBytes)
+    {
+        const ssize_t rc = recv (handle, dest + bytesRead, (size_t) (numBytes - bytesRead), block ? MSG_WAITALL : 0);
+
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return bytesRead > 0 ? bytesRead : -1;
+        }
+
+        if (rc == 0 || ! block)
+            return bytesRead + (int) rc;
+
+        bytesRead += (int) rc;
+    }
+
+    return bytesRead;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __LOCALSOCKETH__
+#define __LOCALSOCKETH__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace EphysSocketNode
+{
+/**
+    Client end of a Unix domain stream socket, for a sender on the same
+    machine. It carries the same byte stream as a TCP connection, without
+    going through the loopback network stack.
+
+    Mirrors the parts of JUCE's StreamingSocket that the receive path uses.
+    Not available on Windows, where connect() fails.
+*/
+class LocalSocket
+{
+public:
+    /** Constructor */
+    LocalSocket();
+
+    /** Destructor; closes the socket */
+    ~LocalSocket();
+
+    /** Connects to the socket file at path, which the sender listens on. Returns false if
+        nothing listens there or the path is too long. */
+    bool connect (const std::string& path);
+
+    /** Closes the connection */
+    void close();
+
+    bool isConnected() const { return handle >= 0; }
+
+    /** Waits up to timeoutMs for bytes (or the end of the stream) to read. Returns 1 if there are,
+        0 on a timeout and -1 on an error. */
+    int waitUntilReady (int timeoutMs);
+
+    /** Reads up to numBytes of what has arrived, or exactly numBytes if block is set. Returns the number
+        read, 0 at the end of the stream (or if nothing has arrived and block isn't set) or -1 on an error. */
+    int read (std::byte* dest, int numBytes, bool block);
+
+    /** Returns the native handle, for socket options, or -1 if not connected */
+    intptr_t getRawSocketHandle() const { return handle; }
+
+    /** Returns true if Unix domain sockets are supported on this platform */
+    static bool isSupported();
+
+private:
+    int handle;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,114 @@
+#include "LowLatency.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <Windows.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#endif
+
+using namespace EphysSocketNode;
+
+namespace
+{
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+using OptionLength = int;
+#else
+using NativeSocket = int;
+using OptionLength = socklen_t;
+#endif
+} // namespace
+
+bool EphysSocketNode::setTcpNoDelay (intptr_t socketHandle)
+{
+    const int noDelay = 1;
+
+    return setsockopt ((NativeSocket) socketHandle, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof (noDelay)) == 0;
+}
+
+bool EphysSocketNode::setTcpQuickAck (intptr_t socketHandle)
+{
+#ifdef TCP_QUICKACK
+    const int quickAck = 1;
+
+    return setsockopt ((NativeSocket) socketHandle, IPPROTO_TCP, TCP_QUICKACK, (const char*) &quickAck, sizeof (quickAck)) == 0;
+#else
+    return false;
+#endif
+}
+
+bool EphysSocketNode::setTcpKeepAlive (intptr_t socketHandle, int idleSeconds, int intervalSeconds)
+{
+    const int keepAlive = 1;
+
+    if (setsockopt ((NativeSocket) socketHandle, SOL_SOCKET, SO_KEEPALIVE, (const char*) &keepAlive, sizeof (keepAlive)) != 0)
+        return false;
+
+#if defined(TCP_KEEPIDLE)
+    setsockopt ((NativeSocket) socketHandle, IPPROTO_TCP, TCP_KEEPIDLE, (const char*) &idleSeconds, sizeof (idleSeconds));
+#elif defined(TCP_KEEPALIVE)
+    setsockopt ((NativeSocket) socketHandle, IPPROTO_TCP, TCP_KEEPALIVE, (const char*) &idleSeconds, sizeof (idleSeconds));
+#endif
+
+#if defined(TCP_KEEPINTVL)
+    setsockopt ((NativeSocket) socketHandle, IPPROTO_TCP, TCP_KEEPINTVL, (const char*) &intervalSeconds, sizeof (intervalSeconds));
+#endif
+
+    return true;
+}
+
+bool EphysSocketNode::setReceiveBufferSize (intptr_t socketHandle, int numBytes)
+{
+    return setsockopt ((NativeSocket) socketHandle, SOL_SOCKET, SO_RCVBUF, (const char*) &numBytes, sizeof (numBytes)) == 0;
+}
+
+int EphysSocketNode::getReceiveBufferSize (intptr_t socketHandle)
+{
+    int numBytes = 0;
+    OptionLength length = sizeof (numBytes);
+
+    if (getsockopt ((NativeSocket) socketHandle, SOL_SOCKET, SO_RCVBUF, (char*) &numBytes, &length) != 0)
+        return -1;
+
+    return numBytes;
+}
+
+bool EphysSocketNode::raiseThreadPriority()
+{
+#ifdef _WIN32
+    return SetThreadPriority (GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    // Round-robin rather than FIFO, so a receiver that polls without sleeping can't lock out its peers
+    sched_param param {};
+    param.sched_priority = sched_get_priority_min (SCHED_RR) + 1;
+
+    return pthread_setschedparam (pthread_self(), SCHED_RR, &param) == 0;
+#endif
+}
+
+bool EphysSocketNode::pinThreadToCpu (int cpu)
+{
+    if (cpu < 0)
+        return false;
+
+#if defined(_WIN32)
+    return cpu < 64 && SetThreadAffinityMask (GetCurrentThread(), (DWORD_PTR) 1 << cpu) != 0;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t cpus;
+    CPU_ZERO (&cpus);
+    CPU_SET (cpu, &cpus);
+
+    return pthread_setaffinity_np (pthread_self(), sizeof (cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef __LOWLATENCYH__
+#define __LOWLATENCYH__
+
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/** Disables Nagle's algorithm on a TCP socket, so small writes go out right away instead of
+    being coalesced. Returns false if it failed. */
+bool setTcpNoDelay (intptr_t socketHandle);
+
+/** Acknowledges received TCP segments right away instead of delaying the ACK, which a sender
+    that does use Nagle's algorithm waits for. Linux only; it lasts until the next read,
+    so it must be set again after every one. Returns false if it isn't supported. */
+bool setTcpQuickAck (intptr_t socketHandle);
+
+/** Has the kernel probe an idle TCP connection after idleSeconds, then every intervalSeconds, and drop it
+    if the peer stays silent, so a sender that vanished without closing is noticed even without reading.
+    The timings are left at the OS defaults where they can't be set. Returns false if it failed. */
+bool setTcpKeepAlive (intptr_t socketHandle, int idleSeconds, int intervalSeconds);
+
+/** Asks for a kernel receive buffer of the given size; the OS may grant more or less */
+bool setReceiveBufferSize (intptr_t socketHandle, int numBytes);
+
+/** Returns the size of the kernel receive buffer, or -1 if it can't be read */
+int getReceiveBufferSize (intptr_t socketHandle);
+
+/** Moves the calling thread to a real-time (Linux, macOS) or time-critical (Windows) priority.
+    Returns false if the process isn't allowed to, e.g. without an rtprio limit on Linux. */
+bool raiseThreadPriority();
+
+/** Keeps the calling thread on one CPU (Linux, Windows). Returns false if it can't, including on macOS. */
+bool pinThreadToCpu (int cpu);
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,215 @@
+#include "PacketAssembler.h"
+#include "Crc32c.h"
+
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+PacketAssembler::PacketAssembler()
+{
+    matrixSize = 0;
+    headerSize = HEADER_SIZE;
+    layout = CHANNEL_MAJOR;
+    current = nullptr;
+    expectedOffset = 0;
+    pendingEnd = 0;
+
+    currentSampleIndex = -1;
+    pendingChecksum = false;
+    expectedChecksum = 0;
+
+    pendingCompressed = false;
+    pendingChannels = 0;
+    pendingSamples = 0;
+
+    resetCounters();
+}
+
+void PacketAssembler::reset (int matrixSize_, int headerSize_, Layout layout_)
+{
+    matrixSize = matrixSize_;
+    headerSize = headerSize_;
+    layout = layout_;
+    current = nullptr;
+    expectedOffset = 0;
+    pendingEnd = 0;
+    pendingChecksum = false;
+    pendingCompressed = false;
+
+    compressed.resize ((size_t) matrixSize);
+}
+
+void PacketAssembler::resetCounters()
+{
+    numMissing = 0;
+    numOutOfOrder = 0;
+    numInvalid = 0;
+    numChecksumErrors = 0;
+    numDropped = 0;
+    numDecompressed = 0;
+    numCompressedBytes = 0;
+}
+
+void PacketAssembler::drop()
+{
+    if (current != nullptr)
+        numDropped++;
+
+    current = nullptr;
+    expectedOffset = 0;
+    pendingEnd = 0;
+    pendingChecksum = false;
+    pendingCompressed = false;
+}
+
+std::byte* PacketAssembler::beginFragment (const std::byte* header_bytes, std::byte* packet)
+{
+    EphysSocketHeader header (header_bytes);
+
+    const bool extended = headerSize > HEADER_SIZE;
+
+    if (header.isExtended() != extended || (extended && (! header.parseExtension (header_bytes) || header.getSize() != headerSize)))
+    {
+        numInvalid++;
+        drop();
+        return nullptr;
+    }
+
+    const int payloadSize = header.getPayloadSize (matrixSize);
+
+    if (header.offset < 0 || payloadSize <= 0 || payloadSize > matrixSize - header.offset)
+    {
+        numInvalid++;
+        drop();
+        return nullptr;
+    }
+
+    if (header.isCompressed() && (header.offset != 0 || ! DeltaCodec::isSupported (header.depth, header.element_size) || (int64_t) header.num_channels * header.num_samp * 2 != matrixSize))
+    {
+        numInvalid++;
+        drop();
+        return nullptr;
+    }
+
+    if (header.offset == 0)
+    {
+        if (current != nullptr)
+            numMissing++;
+
+        drop();
+        current = packet;
+        currentSampleIndex = header.sample_index;
+    }
+    else if (current == nullptr)
+    {
+        return nullptr;
+    }
+    else if (packet != current)
+    {
+        drop(); // The destination changed under a partial matrix (e.g. the queue was full)
+        return nullptr;
+    }
+    else if (header.sample_index != currentSampleIndex)
+    {
+        numMissing++;
+        drop();
+        return nullptr;
+    }
+    else if (header.offset > expectedOffset)
+    {
+        numMissing++;
+        drop();
+        return nullptr;
+    }
+    else if (header.offset < expectedOffset)
+    {
+        numOutOfOrder++;
+        drop();
+        return nullptr;
+    }
+
+    if (header_bytes != packet)
+        std::memcpy (packet, header_bytes, headerSize);
+
+    pendingEnd = header.offset + payloadSize;
+    pendingChecksum = header.hasChecksum();
+    expectedChecksum = header.checksum;
+
+    pendingCompressed = header.isCompressed();
+    pendingChannels = header.num_channels;
+    pendingSamples = header.num_samp;
+
+    return pendingCompressed ? compressed.data() : packet + headerSize + header.offset;
+}
+
+bool PacketAssembler::finishFragment()
+{
+    if (current == nullptr)
+        return false;
+
+    const std::byte* payload = pendingCompressed ? compressed.data() : current + headerSize + expectedOffset;
+
+    if (pendingChecksum && crc32c (payload, (size_t) (pendingEnd - expectedOffset)) != expectedChecksum)
+    {
+        numChecksumErrors++;
+        drop();
+        return false;
+    }
+
+    if (pendingCompressed)
+    {
+        if (! codec.decode (payload, pendingEnd, pendingChannels, pendingSamples, layout, current + headerSize))
+        {
+            numInvalid++;
+            drop();
+            return false;
+        }
+
+        numDecompressed++;
+        numCompressedBytes += pendingEnd;
+
+        pendingEnd = matrixSize;
+        pendingCompressed = false;
+    }
+
+    expectedOffset = pendingEnd;
+
+    if (expectedOffset < matrixSize)
+        return false;
+
+    current = nullptr;
+    expectedOffset = 0;
+    pendingEnd = 0;
+    pendingChecksum = false;
+
+    return true;
+}
+
+bool PacketAssembler::addFragment (const std::byte* fragment, int fragmentSize, std::byte* packet)
+{
+    if (fragmentSize < headerSize)
+    {
+        numInvalid++;
+        drop();
+        return false;
+    }
+
+    std::byte* payload = beginFragment (fragment, packet);
+
+    if (payload == nullptr)
+        return false;
+
+    const int payloadSize = pendingEnd - expectedOffset;
+
+    if (payloadSize > fragmentSize - headerSize)
+    {
+        numInvalid++;
+        drop();
+        return false;
+    }
+
+    if (payload != fragment + headerSize)
+        std::memcpy (payload, fragment + headerSize, payloadSize);
+
+    return finishFragment();
+}
@@ -0,0 +1,129 @@
+#ifndef __PACKETASSEMBLERH__
+#define __PACKETASSEMBLERH__
+
+#include "DeltaCodec.h"
+#include "EphysSocketHeader.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/**
+    Reassembles matrices that the sender split over several packets.
+
+    Every fragment carries the full header: offset is the byte position of its
+    payload within the matrix and num_bytes the size of that payload. An
+    unfragmented packet is simply a single fragment with offset 0.
+
+    Payloads are written straight into the packet being assembled (a header
+    followed by the matrix), so a matrix is never copied once it's complete.
+
+    The header carries no matrix index, so fragments must arrive in order. A
+    missing, repeated or out-of-order fragment drops the partial matrix, and
+    reassembly resumes at the next fragment with offset 0. With an extended
+    header, a fragment whose sample index differs from the rest of the matrix
+    counts as missing too, and one whose checksum doesn't match its payload
+    drops the matrix.
+
+    A compressed matrix (FLAG_COMPRESSED) is never fragmented: its payload is
+    received into a buffer of the assembler's and decoded into the packet, so
+    the packet holds the same raw matrix either way.
+*/
+class PacketAssembler
+{
+public:
+    /** Constructor */
+    PacketAssembler();
+
+    /** Sets the size of the matrices to assemble, the header (including any extension) in front of
+        every fragment and the layout compressed matrices are decoded to, and discards any partial matrix */
+    void reset (int matrixSize, int headerSize = HEADER_SIZE, Layout layout = CHANNEL_MAJOR);
+
+    /** Changes the layout compressed matrices are decoded to; may be called from any thread */
+    void setLayout (Layout layout_) { layout = layout_; }
+
+    /** Returns the size of the header in front of every fragment */
+    int getHeaderSize() const { return headerSize; }
+
+    /** Zeroes the fragment counters */
+    void resetCounters();
+
+    /** Validates the header of the next fragment and returns where its num_bytes of payload
+        belong in packet, or nullptr if the payload must be skipped */
+    std::byte* beginFragment (const std::byte* header_bytes, std::byte* packet);
+
+    /** Marks the payload of the fragment begun last as received.
+        Returns true once the matrix in packet is complete. */
+    bool finishFragment();
+
+    /** Copies one fragment received in a single piece (header + payload, e.g. a datagram)
+        into packet. A fragment that was received at the start of packet is used in place.
+        Returns true once the matrix in packet is complete. */
+    bool addFragment (const std::byte* fragment, int fragmentSize, std::byte* packet);
+
+    /** Returns true if part of a matrix has been received */
+    bool isAssembling() const { return current != nullptr; }
+
+    /** Returns the number of gaps, where one or more fragments never arrived */
+    int64_t getNumMissing() const { return numMissing; }
+
+    /** Returns the number of fragments that arrived behind the expected offset */
+    int64_t getNumOutOfOrder() const { return numOutOfOrder; }
+
+    /** Returns the number of fragments whose offset and size don't fit in the matrix, or whose
+        compressed payload doesn't decode to it */
+    int64_t getNumInvalid() const { return numInvalid; }
+
+    /** Returns the number of fragments whose payload didn't match their checksum */
+    int64_t getNumChecksumErrors() const { return numChecksumErrors; }
+
+    /** Returns the number of partial matrices dropped, for any reason */
+    int64_t getNumDropped() const { return numDropped; }
+
+    /** Returns the number of compressed matrices decoded, and the bytes they took on the wire */
+    int64_t getNumDecompressed() const { return numDecompressed; }
+    int64_t getNumCompressedBytes() const { return numCompressedBytes; }
+
+    /** Returns the decoder of compressed matrices */
+    DeltaCodec& getCodec() { return codec; }
+
+private:
+    /** Drops the matrix being assembled, if any */
+    void drop();
+
+    int matrixSize;
+    int headerSize;
+    std::atomic<Layout> layout;
+
+    /** Packet being assembled, the offset its next fragment must have and the end of the pending payload */
+    std::byte* current;
+    int expectedOffset;
+    int pendingEnd;
+
+    /** Sample index of the matrix being assembled, and the checksum of the pending payload */
+    int64_t currentSampleIndex;
+    bool pendingChecksum;
+    uint32_t expectedChecksum;
+
+    /** Compressed payload pending, received into compressed and decoded by finishFragment() */
+    bool pendingCompressed;
+    int pendingChannels;
+    int pendingSamples;
+    std::vector<std::byte> compressed;
+    DeltaCodec codec;
+
+    /** Written by the receiving thread, read by any thread */
+    std::atomic<int64_t> numMissing;
+    std::atomic<int64_t> numOutOfOrder;
+    std::atomic<int64_t> numInvalid;
+    std::atomic<int64_t> numChecksumErrors;
+    std::atomic<int64_t> numDropped;
+    std::atomic<int64_t> numDecompressed;
+    std::atomic<int64_t> numCompressedBytes;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,335 @@
+#include "PacketCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+inline int64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void writeLittleEndian (std::byte* dest, uint64_t value, int numBytes)
+{
+    for (int i = 0; i < numBytes; i++)
+        dest[i] = (std::byte) (value >> (8 * i));
+}
+
+inline uint64_t readLittleEndian (const std::byte* bytes, int numBytes)
+{
+    uint64_t value = 0;
+
+    for (int i = numBytes - 1; i >= 0; i--)
+        value = value << 8 | (uint64_t) bytes[i];
+
+    return value;
+}
+} // namespace
+
+CaptureWriter::CaptureWriter()
+{
+    file = nullptr;
+    startNs = 0;
+    stopping = false;
+
+    numRecords = 0;
+    numBytes = 0;
+    numDropped = 0;
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open (const std::string& path, CaptureKind kind)
+{
+    close();
+
+    file = std::fopen (path.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    const int64_t startUnixNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::byte header[CAPTURE_HEADER_SIZE] = {};
+    writeLittleEndian (header, CAPTURE_MAGIC, 4);
+    writeLittleEndian (header + 4, CAPTURE_VERSION, 2);
+    writeLittleEndian (header + 6, (uint64_t) kind, 1);
+    writeLittleEndian (header + 8, (uint64_t) startUnixNs, 8);
+
+    if (std::fwrite (header, 1, sizeof (header), file) != sizeof (header))
+    {
+        std::fclose (file);
+        file = nullptr;
+        return false;
+    }
+
+    active.clear();
+    flushing.clear();
+    active.reserve (BUFFER_SIZE);
+    flushing.reserve (BUFFER_SIZE);
+
+    numRecords = 0;
+    numBytes = 0;
+    numDropped = 0;
+
+    startNs = steadyNowNs();
+    stopping = false;
+    writer = std::thread ([this]
+                          { writeLoop(); });
+
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (file == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+    }
+
+    flushNeeded.notify_one();
+    writer.join();
+
+    std::fwrite (active.data(), 1, active.size(), file);
+    std::fclose (file);
+
+    file = nullptr;
+    active.clear();
+    flushing.clear();
+}
+
+void CaptureWriter::append (int64_t arrivalNs, const std::byte* data, int size)
+{
+    if (file == nullptr || size <= 0)
+        return;
+
+    const size_t recordSize = CAPTURE_RECORD_HEADER_SIZE + (size_t) size;
+
+    std::lock_guard<std::mutex> lock (mutex);
+
+    if (active.size() + recordSize > BUFFER_SIZE)
+    {
+        if (! flushing.empty() || recordSize > BUFFER_SIZE)
+        {
+            numDropped++; // The disk is still busy with the other buffer; never wait for it
+            return;
+        }
+
+        active.swap (flushing);
+        flushNeeded.notify_one();
+    }
+
+    const size_t at = active.size();
+    active.resize (at + recordSize);
+
+    writeLittleEndian (active.data() + at, (uint64_t) (arrivalNs - startNs), 8);
+    writeLittleEndian (active.data() + at + 8, (uint64_t) size, 4);
+    std::memcpy (active.data() + at + CAPTURE_RECORD_HEADER_SIZE, data, (size_t) size);
+
+    numRecords++;
+    numBytes += size;
+}
+
+void CaptureWriter::writeLoop()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    while (true)
+    {
+        flushNeeded.wait (lock, [this]
+                          { return stopping || ! flushing.empty(); });
+
+        if (flushing.empty())
+            return;
+
+        // Write without the lock so append() can keep filling the other buffer
+        lock.unlock();
+        std::fwrite (flushing.data(), 1, flushing.size(), file);
+        lock.lock();
+
+        flushing.clear();
+    }
+}
+
+ReplaySource::ReplaySource()
+{
+    input = nullptr;
+    kind = CAPTURE_STREAM;
+    realTime = true;
+
+    recordTimeNs = 0;
+    position = 0;
+    finished = true;
+
+    startNs = 0;
+    firstRecordNs = 0;
+
+    numRecords = 0;
+}
+
+bool ReplaySource::open (const std::string& path, bool realTime_)
+{
+    close();
+
+    input = std::fopen (path.c_str(), "rb");
+
+    if (input == nullptr)
+        return false;
+
+    std::setvbuf (input, nullptr, _IOFBF, 1 << 20);
+
+    std::byte header[CAPTURE_HEADER_SIZE];
+
+    if (std::fread (header, 1, sizeof (header), input) != sizeof (header)
+        || readLittleEndian (header, 4) != CAPTURE_MAGIC
+        || (int) readLittleEndian (header + 4, 2) != CAPTURE_VERSION
+        || (int) header[6] > CAPTURE_DATAGRAMS)
+    {
+        close();
+        return false;
+    }
+
+    kind = (CaptureKind) header[6];
+    realTime = realTime_;
+
+    record.clear();
+    position = 0;
+    finished = false;
+    numRecords = 0;
+
+    return true;
+}
+
+void ReplaySource::close()
+{
+    if (input != nullptr)
+        std::fclose (input);
+
+    input = nullptr;
+    finished = true;
+}
+
+void ReplaySource::resume()
+{
+    if (numRecords == 0)
+        return;
+
+    startNs = steadyNowNs();
+    firstRecordNs = recordTimeNs;
+}
+
+bool ReplaySource::isFinished() const
+{
+    return finished && position >= record.size();
+}
+
+bool ReplaySource::loadRecord()
+{
+    while (position >= record.size())
+    {
+        if (finished)
+            return false;
+
+        std::byte recordHeader[CAPTURE_RECORD_HEADER_SIZE];
+
+        if (std::fread (recordHeader, 1, sizeof (recordHeader), input) != sizeof (recordHeader))
+        {
+            finished = true;
+            return false;
+        }
+
+        recordTimeNs = (int64_t) readLittleEndian (recordHeader, 8);
+        record.resize ((size_t) readLittleEndian (recordHeader + 8, 4));
+        position = 0;
+
+        if (std::fread (record.data(), 1, record.size(), input) != record.size())
+        {
+            record.clear();
+            finished = true;
+            return false;
+        }
+
+        if (numRecords++ == 0)
+        {
+            startNs = steadyNowNs();
+            firstRecordNs = recordTimeNs;
+        }
+    }
+
+    return true;
+}
+
+bool ReplaySource::waitForRecord (int timeoutMs)
+{
+    if (! realTime)
+        return true;
+
+    const int64_t dueNs = startNs + (recordTimeNs - firstRecordNs);
+    const int64_t waitNs = dueNs - steadyNowNs();
+
+    if (waitNs <= 0)
+        return true;
+
+    if (timeoutMs >= 0 && waitNs > (int64_t) timeoutMs * 1000000)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (timeoutMs));
+        return false;
+    }
+
+    std::this_thread::sleep_for (std::chrono::nanoseconds (waitNs));
+
+    return true;
+}
+
+int ReplaySource::waitUntilReady (int timeoutMs)
+{
+    if (input == nullptr)
+        return -1;
+
+    if (! loadRecord())
+        return 1;
+
+    return waitForRecord (timeoutMs) ? 1 : 0;
+}
+
+int ReplaySource::read (std::byte* dest, int numBytes, bool block)
+{
+    if (input == nullptr)
+        return -1;
+
+    int total = 0;
+
+    while (total < numBytes && loadRecord())
+    {
+        // Without block, only what has already arrived is returned once something was read
+        if (! waitForRecord (total > 0 && ! block ? 0 : -1))
+            break;
+
+        if (kind == CAPTURE_DATAGRAMS)
+        {
+            const int size = (int) std::min (record.size(), (size_t) numBytes);
+            std::memcpy (dest, record.data(), (size_t) size);
+            position = record.size();
+
+            return size;
+        }
+
+        const int size = (int) std::min (record.size() - position, (size_t) (numBytes - total));
+        std::memcpy (dest + total, record.data() + position, (size_t) size);
+
+        position += size;
+        total += size;
+    }
+
+    return total;
+}
@@ -0,0 +1,157 @@
+#ifndef __PACKETCAPTUREH__
+#define __PACKETCAPTUREH__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/** What the records of a capture file hold */
+enum CaptureKind
+{
+    CAPTURE_STREAM, // consecutive chunks of a TCP byte stream, as they were read
+    CAPTURE_DATAGRAMS // one datagram per record
+};
+
+/** Capture files start with this header, little endian:
+
+        bytes 0-3     magic, "ECAP"
+        bytes 4-5     version
+        byte  6       CaptureKind
+        byte  7       reserved, zero
+        bytes 8-15    time the capture started, in nanoseconds since the Unix epoch
+
+    Each record then holds the time the bytes arrived, in nanoseconds since the
+    capture started (8 bytes), their size (4 bytes) and the bytes themselves. */
+const uint32_t CAPTURE_MAGIC = 0x50414345;
+const int CAPTURE_VERSION = 1;
+const int CAPTURE_HEADER_SIZE = 16;
+const int CAPTURE_RECORD_HEADER_SIZE = 12;
+
+/**
+    Appends raw received bytes, with their arrival times, to a capture file.
+
+    append() only copies into memory, so it can be called from a receive loop:
+    a background thread writes the filled buffer to disk while the other one
+    fills up. If the disk falls so far behind that both are full, records are
+    dropped and counted rather than stalling the caller.
+*/
+class CaptureWriter
+{
+public:
+    /** Constructor */
+    CaptureWriter();
+
+    /** Destructor, closes the file */
+    ~CaptureWriter();
+
+    /** Creates the file, replacing any file at path, and starts the writer thread */
+    bool open (const std::string& path, CaptureKind kind);
+
+    /** Writes what is buffered and closes the file */
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+
+    /** Records size bytes that arrived at arrivalNs, on the steady clock */
+    void append (int64_t arrivalNs, const std::byte* data, int size);
+
+    /** Records and bytes appended, and records dropped because the disk fell behind */
+    int64_t getNumRecords() const { return numRecords; }
+    int64_t getNumBytes() const { return numBytes; }
+    int64_t getNumDropped() const { return numDropped; }
+
+private:
+    /** Size of each of the two buffers; a record larger than this is dropped */
+    static const size_t BUFFER_SIZE = 8 << 20;
+
+    void writeLoop();
+
+    std::FILE* file;
+    int64_t startNs;
+
+    std::vector<std::byte> active;
+    std::vector<std::byte> flushing;
+
+    std::mutex mutex;
+    std::condition_variable flushNeeded;
+    std::thread writer;
+    bool stopping;
+
+    std::atomic<int64_t> numRecords;
+    std::atomic<int64_t> numBytes;
+    std::atomic<int64_t> numDropped;
+};
+
+/**
+    Plays a capture file back as if its bytes were arriving from a socket,
+    either at the pace they were recorded or as fast as they can be read.
+
+    Stream captures can be read in any amount, regardless of how they were
+    chunked when recorded; datagram captures return one record per read().
+*/
+class ReplaySource
+{
+public:
+    /** Constructor */
+    ReplaySource();
+
+    /** Opens a capture file; realTime paces the records as they were recorded */
+    bool open (const std::string& path, bool realTime);
+
+    void close();
+
+    bool isOpen() const { return input != nullptr; }
+
+    /** Returns the kind of capture being replayed */
+    CaptureKind getKind() const { return kind; }
+
+    /** Paces the remaining records from now on, as if the last one read had just arrived, e.g. after a pause */
+    void resume();
+
+    /** Returns true once every record has been read */
+    bool isFinished() const;
+
+    /** Waits up to timeoutMs for the next record to be due. Returns 1 if bytes can be read,
+        which includes the end of the file (read() then returns 0), and 0 on timeout. */
+    int waitUntilReady (int timeoutMs);
+
+    /** Reads up to numBytes, waiting for the next record if none is due. With block set, stream captures
+        wait for records until numBytes were read. Returns the number of bytes read, 0 at the end of the file. */
+    int read (std::byte* dest, int numBytes, bool block);
+
+    /** Returns the records read so far */
+    int64_t getNumRecords() const { return numRecords; }
+
+private:
+    /** Loads the next record, if the current one is used up; returns false at the end of the file */
+    bool loadRecord();
+
+    /** Sleeps until the current record is due, for at most timeoutMs (-1 = no limit); returns true if it is due */
+    bool waitForRecord (int timeoutMs);
+
+    std::FILE* input;
+    CaptureKind kind;
+    bool realTime;
+
+    std::vector<std::byte> record;
+    int64_t recordTimeNs;
+    size_t position;
+    bool finished;
+
+    /** Steady clock time the first record was replayed at, and its capture time */
+    int64_t startNs;
+    int64_t firstRecordNs;
+
+    int64_t numRecords;
+};
+} // namespace EphysSocketNode
+
+#endif
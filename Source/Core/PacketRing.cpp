@@ -0,0 +1,144 @@
+#include "PacketRing.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <cstdint>
+
+using namespace EphysSocketNode;
+
+PacketRing::PacketRing()
+{
+    numSlots = 0;
+    slotSize = 0;
+    slotStride = 0;
+    mask = 0;
+
+    base = nullptr;
+    baseSize = 0;
+    pinned = false;
+
+    writeIndex = 0;
+    readIndex = 0;
+}
+
+PacketRing::~PacketRing()
+{
+    unpin();
+}
+
+void PacketRing::resize (int numSlots_, int slotSize_, int headerSize)
+{
+    unpin();
+
+    // Round the slot count up to a power of two so the index wraps with a mask
+    int slots = 1;
+
+    while (slots < numSlots_)
+        slots <<= 1;
+
+    // Start each slot just before a cache-line boundary so its payload is aligned
+    const size_t padding = (PAYLOAD_ALIGNMENT - headerSize % PAYLOAD_ALIGNMENT) % PAYLOAD_ALIGNMENT;
+
+    numSlots = slots;
+    slotSize = slotSize_;
+    slotStride = (padding + (size_t) slotSize + PAYLOAD_ALIGNMENT - 1) & ~(size_t) (PAYLOAD_ALIGNMENT - 1);
+    mask = (uint64_t) numSlots - 1;
+
+    storage.assign (slotStride * numSlots + PAYLOAD_ALIGNMENT, std::byte { 0 }); // Zero-filling also faults every page in
+
+    const uintptr_t address = reinterpret_cast<uintptr_t> (storage.data());
+    const size_t alignment = (PAYLOAD_ALIGNMENT - address % PAYLOAD_ALIGNMENT) % PAYLOAD_ALIGNMENT;
+
+    base = storage.data() + alignment + padding;
+    info.assign (numSlots, PacketInfo());
+    baseSize = slotStride * numSlots;
+
+#ifdef _WIN32
+    pinned = VirtualLock (base, baseSize) != 0;
+#else
+    pinned = mlock (base, baseSize) == 0;
+#endif
+
+    writeIndex = 0;
+    readIndex = 0;
+}
+
+void PacketRing::unpin()
+{
+    if (! pinned)
+        return;
+
+#ifdef _WIN32
+    VirtualUnlock (base, baseSize);
+#else
+    munlock (base, baseSize);
+#endif
+
+    pinned = false;
+}
+
+std::byte* PacketRing::beginWrite()
+{
+    const uint64_t w = writeIndex.load (std::memory_order_relaxed);
+
+    if (numSlots == 0 || w - readIndex.load (std::memory_order_acquire) >= (uint64_t) numSlots)
+        return nullptr;
+
+    return base + (w & mask) * slotStride;
+}
+
+PacketInfo& PacketRing::getWriteInfo()
+{
+    return info[writeIndex.load (std::memory_order_relaxed) & mask];
+}
+
+void PacketRing::finishWrite()
+{
+    writeIndex.store (writeIndex.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const std::byte* PacketRing::beginRead() const
+{
+    const uint64_t r = readIndex.load (std::memory_order_relaxed);
+
+    if (r == writeIndex.load (std::memory_order_acquire))
+        return nullptr;
+
+    return base + (r & mask) * slotStride;
+}
+
+const std::byte* PacketRing::peek (int index) const
+{
+    const uint64_t r = readIndex.load (std::memory_order_relaxed) + (uint64_t) index;
+
+    if (index < 0 || r >= writeIndex.load (std::memory_order_acquire))
+        return nullptr;
+
+    return base + (r & mask) * slotStride;
+}
+
+const PacketInfo& PacketRing::getReadInfo (int index) const
+{
+    return info[(readIndex.load (std::memory_order_relaxed) + (uint64_t) index) & mask];
+}
+
+void PacketRing::finishRead()
+{
+    readIndex.store (readIndex.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void PacketRing::clear()
+{
+    readIndex.store (writeIndex.load (std::memory_order_acquire), std::memory_order_release);
+}
+
+int PacketRing::getNumReady() const
+{
+    const uint64_t r = readIndex.load (std::memory_order_acquire); // Read first so the difference can't go negative
+
+    return (int) (writeIndex.load (std::memory_order_acquire) - r);
+}
@@ -0,0 +1,108 @@
+#ifndef __PACKETRINGH__
+#define __PACKETRINGH__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/** What the receiver knows about a packet besides its bytes */
+struct PacketInfo
+{
+    int64_t arrivalNs = 0; // monotonic clock, when the packet was complete
+    double firstSampleTime = 0.0; // recovered time of the first sample, in seconds
+    double samplePeriod = 0.0; // recovered duration of one sample, in seconds
+    int64_t sampleIndex = -1; // sender's index of the first sample, -1 without an extended header
+    int64_t senderTimeNs = 0; // sender's send time from an extended header, ns since the Unix epoch
+    int64_t missingSamples = 0; // samples lost between the previous queued packet and this one
+};
+
+/**
+    Lock-free single-producer/single-consumer ring of fixed-size packet slots.
+
+    The socket thread writes each packet straight into the next free slot and the
+    DataThread reads it in place, so no memory is allocated or copied per packet.
+
+    Each slot starts headerSize bytes before a cache-line boundary, so the payload
+    that follows the header is 64-byte aligned for the conversion kernels. The
+    slots are locked into physical memory where the OS allows it, so the receive
+    path never page-faults.
+*/
+class PacketRing
+{
+public:
+    /** Constructor */
+    PacketRing();
+
+    /** Destructor */
+    ~PacketRing();
+
+    /** Allocates numSlots slots of slotSize bytes each, whose byte headerSize is 64-byte aligned,
+        discarding any queued packets. Must only be called while neither the producer nor the consumer is active. */
+    void resize (int numSlots, int slotSize, int headerSize = 0);
+
+    /** Producer: returns the next free slot, or nullptr if the ring is full */
+    std::byte* beginWrite();
+
+    /** Producer: returns the info of the slot returned by the last call to beginWrite() */
+    PacketInfo& getWriteInfo();
+
+    /** Producer: publishes the slot returned by the last call to beginWrite() */
+    void finishWrite();
+
+    /** Consumer: returns the oldest unread slot, or nullptr if the ring is empty */
+    const std::byte* beginRead() const;
+
+    /** Consumer: returns the unread slot index places after the oldest one, or nullptr if fewer are ready */
+    const std::byte* peek (int index) const;
+
+    /** Consumer: returns the info of the unread slot index places after the oldest one */
+    const PacketInfo& getReadInfo (int index = 0) const;
+
+    /** Consumer: releases the slot returned by the last call to beginRead() */
+    void finishRead();
+
+    /** Consumer: discards every packet that has been published so far */
+    void clear();
+
+    /** Returns the number of packets waiting to be read */
+    int getNumReady() const;
+
+    /** Returns the number of slots in the ring */
+    int getNumSlots() const { return numSlots; }
+
+    /** Returns the usable size of each slot in bytes */
+    int getSlotSize() const { return slotSize; }
+
+    /** Returns true if the slots are locked into physical memory */
+    bool isPinned() const { return pinned; }
+
+    /** Alignment of the byte that follows the header in every slot */
+    static constexpr int PAYLOAD_ALIGNMENT = 64;
+
+private:
+    /** Unlocks the slots from physical memory, if they were locked */
+    void unpin();
+
+    std::vector<std::byte> storage;
+    std::vector<PacketInfo> info;
+
+    /** First slot, offset into storage so that every payload is aligned */
+    std::byte* base;
+    size_t baseSize;
+    bool pinned;
+
+    int numSlots;
+    int slotSize;
+    size_t slotStride;
+    uint64_t mask;
+
+    /** Monotonic counters; kept on separate cache lines so the two threads don't false-share */
+    alignas (64) std::atomic<uint64_t> writeIndex;
+    alignas (64) std::atomic<uint64_t> readIndex;
+};
+} // namespace EphysSocketNode
+
+#endif
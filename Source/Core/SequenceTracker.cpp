@@ -0,0 +1,70 @@
+#include "SequenceTracker.h"
+
+using namespace EphysSocketNode;
+
+SequenceTracker::SequenceTracker()
+{
+    reset (0);
+}
+
+void SequenceTracker::reset (int64_t maxJump_)
+{
+    maxJump = maxJump_;
+    expectedIndex = -1;
+    previousIndex = -1;
+    lastGap = 0;
+    resyncPending = false;
+
+    numGaps = 0;
+    numLostSamples = 0;
+    numDuplicates = 0;
+    numLate = 0;
+    numResyncs = 0;
+}
+
+SequenceTracker::Result SequenceTracker::check (int64_t sampleIndex, int numSamples)
+{
+    lastGap = 0;
+
+    Result result = IN_ORDER;
+
+    const bool restarted = resyncPending && sampleIndex < expectedIndex;
+    resyncPending = false;
+
+    if (expectedIndex < 0)
+    {
+        result = FIRST;
+    }
+    else if (restarted)
+    {
+        numResyncs++;
+        result = RESYNC;
+    }
+    else if (sampleIndex == previousIndex)
+    {
+        numDuplicates++;
+        return DUPLICATE;
+    }
+    else if (sampleIndex - expectedIndex > maxJump || expectedIndex - sampleIndex > maxJump)
+    {
+        numResyncs++;
+        result = RESYNC;
+    }
+    else if (sampleIndex < expectedIndex)
+    {
+        numLate++;
+        return LATE;
+    }
+    else if (sampleIndex > expectedIndex)
+    {
+        lastGap = sampleIndex - expectedIndex;
+        numGaps++;
+        numLostSamples += lastGap;
+        result = GAP;
+    }
+
+    previousIndex = sampleIndex;
+    expectedIndex = sampleIndex + numSamples;
+
+    return result;
+}
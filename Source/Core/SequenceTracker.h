@@ -0,0 +1,76 @@
+#ifndef __SEQUENCETRACKERH__
+#define __SEQUENCETRACKERH__
+
+#include <atomic>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/**
+    Follows the sample index that extended headers carry from one packet to the
+    next, and counts the packets that were lost, duplicated or arrived late.
+
+    A packet is expected to start where the previous one ended. A jump of more
+    than maxJump samples either way is taken as the sender restarting rather
+    than as loss, and tracking resumes from the new index.
+
+    After a reconnect the sender may have restarted from a lower index; resync()
+    makes the next packet behind the expected index start tracking over instead
+    of being dropped as late.
+*/
+class SequenceTracker
+{
+public:
+    /** What a packet's sample index says about the stream */
+    enum Result
+    {
+        FIRST, // the first packet since reset()
+        IN_ORDER, // starts where the previous packet ended
+        GAP, // samples before this packet never arrived
+        DUPLICATE, // same index as the previous packet
+        LATE, // behind the expected index, e.g. reordered; already counted as lost
+        RESYNC // jumped further than maxJump samples
+    };
+
+    /** Constructor */
+    SequenceTracker();
+
+    /** Forgets the previous packet and zeroes the counters */
+    void reset (int64_t maxJump);
+
+    /** Takes the next packet as a RESYNC if it is behind the expected index, keeping the counters */
+    void resync() { resyncPending = true; }
+
+    /** Checks the sample index of the next packet of numSamples samples.
+        Packets found DUPLICATE or LATE should be dropped; the others move the expected index on. */
+    Result check (int64_t sampleIndex, int numSamples);
+
+    /** Returns the number of samples missing before the packet checked last, if it was a GAP */
+    int64_t getLastGap() const { return lastGap; }
+
+    /** Returns the index the next packet should start at */
+    int64_t getExpectedIndex() const { return expectedIndex; }
+
+    int64_t getNumGaps() const { return numGaps; }
+    int64_t getNumLostSamples() const { return numLostSamples; }
+    int64_t getNumDuplicates() const { return numDuplicates; }
+    int64_t getNumLate() const { return numLate; }
+    int64_t getNumResyncs() const { return numResyncs; }
+
+private:
+    int64_t maxJump;
+    int64_t expectedIndex;
+    int64_t previousIndex;
+    int64_t lastGap;
+    bool resyncPending;
+
+    /** Written by the receiving thread, read by any thread */
+    std::atomic<int64_t> numGaps;
+    std::atomic<int64_t> numLostSamples;
+    std::atomic<int64_t> numDuplicates;
+    std::atomic<int64_t> numLate;
+    std::atomic<int64_t> numResyncs;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,396 @@
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+using namespace EphysSocketNode;
+
+/** Laid out at the start of the shared memory, identically in both processes */
+struct SharedMemoryRing::Header
+{
+    std::atomic<uint32_t> magic; // MAGIC once the rest is set up
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t dataOffset;
+
+    /** Written by the sender */
+    alignas (64) std::atomic<uint64_t> writePos;
+    std::atomic<uint32_t> writeSequence;
+    std::atomic<uint32_t> writerClosed;
+    std::atomic<int64_t> numDropped;
+
+    /** Written by the receiver */
+    alignas (64) std::atomic<uint64_t> readPos;
+    std::atomic<uint32_t> readerAttached;
+    std::atomic<uint32_t> readerWaiting;
+};
+
+static_assert (std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+               "The ring's counters must be lock-free to be shared between processes");
+
+SharedMemoryRing::SharedMemoryRing()
+{
+    header = nullptr;
+    data = nullptr;
+    capacity = 0;
+
+    fd = -1;
+    owner = false;
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemoryRing::create (const std::string&, int) { return false; }
+bool SharedMemoryRing::open (const std::string&) { return false; }
+void SharedMemoryRing::close() {}
+bool SharedMemoryRing::map (int, int) { return false; }
+void SharedMemoryRing::unmap() {}
+void SharedMemoryRing::wake() {}
+
+#else
+
+namespace
+{
+int getPageSize()
+{
+    return (int) sysconf (_SC_PAGESIZE);
+}
+} // namespace
+
+bool SharedMemoryRing::create (const std::string& name_, int minCapacity)
+{
+    close();
+
+    const int pageSize = getPageSize();
+    const int dataSize = (std::max (minCapacity, 1) + pageSize - 1) / pageSize * pageSize;
+    const int dataOffset = std::max (HEADER_SIZE, pageSize); // The data region must start on a page to be mapped twice
+
+    static_assert (sizeof (Header) <= HEADER_SIZE, "The ring's header must fit in front of the data region");
+
+    shm_unlink (name_.c_str());
+
+    fd = shm_open (name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+    if (fd < 0)
+        return false;
+
+    if (ftruncate (fd, (off_t) dataOffset + dataSize) != 0 || ! map (fd, dataSize))
+    {
+        ::close (fd);
+        fd = -1;
+        shm_unlink (name_.c_str());
+
+        return false;
+    }
+
+    header->version = VERSION;
+    header->capacity = (uint64_t) dataSize;
+    header->dataOffset = (uint64_t) dataOffset;
+    header->magic.store (MAGIC, std::memory_order_release);
+
+    name = name_;
+    owner = true;
+
+    return true;
+}
+
+bool SharedMemoryRing::open (const std::string& name_)
+{
+    close();
+
+    fd = shm_open (name_.c_str(), O_RDWR, 0);
+
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    bool valid = fstat (fd, &info) == 0 && info.st_size >= HEADER_SIZE;
+
+    if (valid)
+    {
+        // Read the layout the sender chose before mapping the data region
+        void* first = mmap (nullptr, HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (first == MAP_FAILED)
+        {
+            valid = false;
+        }
+        else
+        {
+            const Header* published = (const Header*) first;
+
+            valid = published->magic.load (std::memory_order_acquire) == MAGIC
+                    && published->version == VERSION
+                    && published->dataOffset >= (uint64_t) HEADER_SIZE
+                    && published->dataOffset % (uint64_t) getPageSize() == 0
+                    && (uint64_t) info.st_size >= published->dataOffset + published->capacity
+                    && published->capacity <= (uint64_t) INT32_MAX / 2
+                    && published->writerClosed.load() == 0
+                    && map (fd, (int) published->capacity);
+
+            munmap (first, HEADER_SIZE);
+        }
+    }
+
+    if (! valid)
+    {
+        ::close (fd);
+        fd = -1;
+
+        return false;
+    }
+
+    header->readPos.store (header->writePos.load (std::memory_order_acquire), std::memory_order_relaxed);
+    header->readerWaiting.store (0);
+    header->readerAttached.store (1);
+
+    name = name_;
+    owner = false;
+
+    return true;
+}
+
+void SharedMemoryRing::close()
+{
+    if (header != nullptr)
+    {
+        if (owner)
+        {
+            header->writerClosed.store (1);
+            header->writeSequence.fetch_add (1);
+            wake();
+
+            shm_unlink (name.c_str());
+        }
+        else
+        {
+            header->readerAttached.store (0);
+        }
+
+        unmap();
+    }
+
+    if (fd >= 0)
+    {
+        ::close (fd);
+        fd = -1;
+    }
+
+    name.clear();
+    owner = false;
+}
+
+bool SharedMemoryRing::map (int fd_, int dataSize)
+{
+    const int dataOffset = std::max (HEADER_SIZE, getPageSize());
+
+    void* headerMemory = mmap (nullptr, (size_t) dataOffset, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (headerMemory == MAP_FAILED)
+        return false;
+
+    // Reserve twice the data region, then map the data into both halves
+    void* reserved = mmap (nullptr, (size_t) dataSize * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (reserved == MAP_FAILED)
+    {
+        munmap (headerMemory, (size_t) dataOffset);
+        return false;
+    }
+
+    std::byte* base = (std::byte*) reserved;
+
+    for (int half = 0; half < 2; half++)
+    {
+        if (mmap (base + (size_t) half * dataSize, (size_t) dataSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_, (off_t) dataOffset) == MAP_FAILED)
+        {
+            munmap (reserved, (size_t) dataSize * 2);
+            munmap (headerMemory, (size_t) dataOffset);
+            return false;
+        }
+    }
+
+    header = (Header*) headerMemory;
+    data = base;
+    capacity = dataSize;
+
+    return true;
+}
+
+void SharedMemoryRing::unmap()
+{
+    munmap (data, (size_t) capacity * 2);
+    munmap (header, (size_t) std::max (HEADER_SIZE, getPageSize()));
+
+    header = nullptr;
+    data = nullptr;
+    capacity = 0;
+}
+
+void SharedMemoryRing::wake()
+{
+#ifdef __linux__
+    // Not a private futex, as the receiver sleeps on it in another process
+    syscall (SYS_futex, (uint32_t*) &header->writeSequence, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+#endif
+
+std::byte* SharedMemoryRing::beginWrite (int numBytes)
+{
+    if (header == nullptr || numBytes > capacity || header->readerAttached.load() == 0)
+        return nullptr;
+
+    const uint64_t writePos = header->writePos.load (std::memory_order_relaxed);
+    const uint64_t used = writePos - header->readPos.load (std::memory_order_acquire);
+
+    if ((uint64_t) capacity - used < (uint64_t) numBytes)
+        return nullptr;
+
+    return data + writePos % (uint64_t) capacity;
+}
+
+void SharedMemoryRing::finishWrite (int numBytes)
+{
+    header->writePos.store (header->writePos.load (std::memory_order_relaxed) + (uint64_t) numBytes, std::memory_order_release);
+    header->writeSequence.fetch_add (1);
+
+    if (header->readerWaiting.load() != 0)
+        wake();
+}
+
+bool SharedMemoryRing::write (const std::byte* packet, int numBytes)
+{
+    std::byte* dest = beginWrite (numBytes);
+
+    if (dest == nullptr)
+    {
+        if (header != nullptr)
+            header->numDropped.fetch_add (1, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    std::memcpy (dest, packet, (size_t) numBytes);
+    finishWrite (numBytes);
+
+    return true;
+}
+
+int64_t SharedMemoryRing::getNumDropped() const
+{
+    return header != nullptr ? header->numDropped.load (std::memory_order_relaxed) : 0;
+}
+
+int SharedMemoryRing::getNumReadable() const
+{
+    if (header == nullptr)
+        return 0;
+
+    return (int) (header->writePos.load (std::memory_order_acquire) - header->readPos.load (std::memory_order_relaxed));
+}
+
+int SharedMemoryRing::waitUntilReady (int timeoutMs)
+{
+    if (header == nullptr)
+        return -1;
+
+    const auto isReady = [this]
+    { return getNumReadable() > 0 || header->writerClosed.load() != 0; };
+
+    if (isReady())
+        return 1;
+
+    if (timeoutMs <= 0)
+        return 0;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds (timeoutMs);
+
+    while (true)
+    {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+
+        if (remaining <= std::chrono::steady_clock::duration::zero())
+            return 0;
+
+#ifdef __linux__
+        // Read the sequence before announcing the wait, so a write after the check below changes it and the futex doesn't sleep
+        const uint32_t sequence = header->writeSequence.load();
+        header->readerWaiting.store (1);
+
+        if (isReady())
+        {
+            header->readerWaiting.store (0);
+            return 1;
+        }
+
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds> (remaining).count();
+        const timespec timeout { (time_t) (nanoseconds / 1000000000), (long) (nanoseconds % 1000000000) };
+
+        syscall (SYS_futex, (uint32_t*) &header->writeSequence, FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+
+        header->readerWaiting.store (0);
+#else
+        std::this_thread::sleep_for (std::min<std::chrono::steady_clock::duration> (remaining, std::chrono::microseconds (POLL_INTERVAL_US)));
+#endif
+
+        if (isReady())
+            return 1;
+    }
+}
+
+int SharedMemoryRing::read (std::byte* dest, int numBytes, bool block)
+{
+    if (header == nullptr)
+        return -1;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds (BLOCKING_READ_TIMEOUT_MS);
+    int bytesRead = 0;
+
+    while (bytesRead < numBytes)
+    {
+        const int size = std::min (getNumReadable(), numBytes - bytesRead);
+
+        if (size > 0)
+        {
+            const uint64_t readPos = header->readPos.load (std::memory_order_relaxed);
+            std::memcpy (dest + bytesRead, data + readPos % (uint64_t) capacity, (size_t) size);
+            header->readPos.store (readPos + (uint64_t) size, std::memory_order_release);
+
+            bytesRead += size;
+            continue;
+        }
+
+        if (! block || header->writerClosed.load() != 0)
+            break;
+
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds> (deadline - std::chrono::steady_clock::now()).count();
+
+        if (remaining <= 0 || waitUntilReady ((int) remaining) < 0)
+            break;
+    }
+
+    return bytesRead;
+}
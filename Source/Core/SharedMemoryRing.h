@@ -0,0 +1,111 @@
+#ifndef __SHAREDMEMORYRINGH__
+#define __SHAREDMEMORYRINGH__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace EphysSocketNode
+{
+/**
+    A byte stream between two processes on the same machine, in a named POSIX
+    shared-memory ring. It carries exactly what a TCP connection would (headers
+    and matrices back to back), so it is framed the same way.
+
+    The sender creates the ring and writes whole packets straight into it with
+    beginWrite()/finishWrite(); the receiver opens it and copies each packet
+    out once, into its queue. The data region is mapped twice, back to back, so
+    a packet that wraps around the end is still contiguous for both of them.
+
+    The receiver sleeps on a futex in the ring (Linux) or polls it every
+    POLL_INTERVAL_US (macOS) while it is empty, and the sender only wakes it
+    when it is asleep. With no receiver, or too little room for a packet, the
+    sender drops the packet instead of blocking and counts it.
+
+    One sender and one receiver; not available on Windows, where create() and
+    open() fail.
+*/
+class SharedMemoryRing
+{
+public:
+    /** Identifies a ring, and the layout of its header */
+    static constexpr uint32_t MAGIC = 0x4d485345; // "ESHM"
+    static constexpr uint32_t VERSION = 1;
+
+    /** Sleep between checks for data where there is no futex */
+    static constexpr int POLL_INTERVAL_US = 100;
+
+    /** Constructor */
+    SharedMemoryRing();
+
+    /** Destructor; closes the ring, removing it if this end created it */
+    ~SharedMemoryRing();
+
+    /** Sender: creates a ring called name (e.g. "/ephys-socket-9001") with room for at least
+        capacity bytes, replacing any old one of that name */
+    bool create (const std::string& name, int capacity);
+
+    /** Receiver: opens the ring called name and reads from the sender's next packet on */
+    bool open (const std::string& name);
+
+    /** Detaches from the ring. The sender also marks the stream as ended and removes the name,
+        so a receiver sees the end of the stream and a new sender can create a fresh ring. */
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+
+    /** Size of the data region, a whole number of pages */
+    int getCapacity() const { return capacity; }
+
+    /** Sender: returns where to write the next numBytes, or nullptr if there is no receiver
+        or not enough room, in which case the packet should be dropped */
+    std::byte* beginWrite (int numBytes);
+
+    /** Sender: hands the numBytes written since beginWrite() to the receiver */
+    void finishWrite (int numBytes);
+
+    /** Sender: copies a whole packet into the ring, or drops and counts it. Returns false if dropped. */
+    bool write (const std::byte* data, int numBytes);
+
+    /** Packets the sender dropped, as counted in the ring */
+    int64_t getNumDropped() const;
+
+    /** Receiver: waits up to timeoutMs for bytes (or the end of the stream) to read. Returns 1 if
+        there are, 0 on a timeout and -1 if the ring isn't open. */
+    int waitUntilReady (int timeoutMs);
+
+    /** Receiver: copies up to numBytes out of the ring, or exactly numBytes if block is set, waiting
+        up to BLOCKING_READ_TIMEOUT_MS for them. Returns the number read, 0 at the end of the stream
+        or -1 if the ring isn't open. */
+    int read (std::byte* dest, int numBytes, bool block);
+
+    /** Receiver: bytes written but not read yet */
+    int getNumReadable() const;
+
+    /** Longest a blocking read waits for the rest of its bytes */
+    static constexpr int BLOCKING_READ_TIMEOUT_MS = 2000;
+
+private:
+    /** Start of the shared memory; the data region follows it at HEADER_SIZE */
+    struct Header;
+    static constexpr int HEADER_SIZE = 4096;
+
+    /** Maps the header and the data region of the open file descriptor */
+    bool map (int fd, int dataSize);
+    void unmap();
+
+    /** Wakes the receiver if it sleeps on the ring */
+    void wake();
+
+    Header* header;
+    std::byte* data;
+    int capacity;
+
+    int fd;
+    std::string name;
+    bool owner;
+};
+} // namespace EphysSocketNode
+
+#endif
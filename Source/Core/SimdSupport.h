@@ -0,0 +1,23 @@
+#ifndef __SIMDSUPPORTH__
+#define __SIMDSUPPORTH__
+
+/** Instruction set helpers shared by the core's vector kernels; include from .cpp files only */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define EPHYS_SOCKET_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && ! defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define EPHYS_SOCKET_X86 0
+#endif
+
+// GCC and Clang only emit wider instructions inside functions that ask for them; MSVC always can
+#if defined(__GNUC__) || defined(__clang__)
+#define EPHYS_SOCKET_TARGET(isa) __attribute__ ((target (isa)))
+#else
+#define EPHYS_SOCKET_TARGET(isa)
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace EphysSocketNode;
+
+StreamBuffer::StreamBuffer()
+{
+    source = nullptr;
+    start = 0;
+    end = 0;
+}
+
+void StreamBuffer::reset (ChunkSource* source_, int bufferSize)
+{
+    source = source_;
+    buffer.resize ((size_t) bufferSize);
+
+    clear();
+}
+
+void StreamBuffer::clear()
+{
+    start = 0;
+    end = 0;
+}
+
+ReadStatus StreamBuffer::read (std::byte* dest, int numBytes, bool midFragment)
+{
+    int copied = 0;
+
+    while (copied < numBytes)
+    {
+        if (start < end)
+        {
+            const int size = std::min (numBytes - copied, end - start);
+            std::memcpy (dest + copied, buffer.data() + start, (size_t) size);
+
+            start += size;
+            copied += size;
+
+            continue;
+        }
+
+        if (source == nullptr)
+            return READ_ERROR;
+
+        const int remaining = numBytes - copied;
+        const bool direct = remaining >= (int) buffer.size() / 2;
+
+        start = 0;
+        end = 0;
+
+        int numRead = 0;
+        const ReadStatus status = source->readSome (direct ? dest + copied : buffer.data(), direct ? remaining : (int) buffer.size(), numRead, midFragment || copied > 0);
+
+        if (status != PACKET_READY)
+            return status;
+
+        if (direct)
+            copied += numRead;
+        else
+            end = numRead;
+    }
+
+    return PACKET_READY;
+}
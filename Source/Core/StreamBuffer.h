@@ -0,0 +1,58 @@
+#ifndef __STREAMBUFFERH__
+#define __STREAMBUFFERH__
+
+#include "FrameReader.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace EphysSocketNode
+{
+/** A connected byte stream, such as a TCP socket, read in chunks of whatever has arrived */
+class ChunkSource
+{
+public:
+    virtual ~ChunkSource() = default;
+
+    /** Waits for bytes and reads between 1 and maxBytes of them into dest, returning PACKET_READY and
+        setting numRead, or gives up with another status. Returns NO_DATA if nothing arrived in time,
+        unless midFragment is set. */
+    virtual ReadStatus readSome (std::byte* dest, int maxBytes, int& numRead, bool midFragment) = 0;
+};
+
+/**
+    Reads a stream in large chunks and hands it out as the exact reads that
+    FrameReader asks for, so packets that arrive together are framed from one
+    read instead of two per packet.
+
+    Bytes are copied out of the buffer, except for reads of at least half its
+    size that find it empty: those go straight to their destination, so large
+    payloads still land in their packet without a copy.
+*/
+class StreamBuffer : public ByteSource
+{
+public:
+    /** Constructor */
+    StreamBuffer();
+
+    /** Sets the source to read from and the size of the buffer, discarding any buffered bytes */
+    void reset (ChunkSource* source, int bufferSize);
+
+    /** Discards the buffered bytes, e.g. when the stream is reopened */
+    void clear();
+
+    ReadStatus read (std::byte* dest, int numBytes, bool midFragment) override;
+
+    /** Returns the number of bytes received but not read yet */
+    int getNumBuffered() const { return end - start; }
+
+private:
+    ChunkSource* source;
+
+    std::vector<std::byte> buffer;
+    int start;
+    int end;
+};
+} // namespace EphysSocketNode
+
+#endif
@@ -0,0 +1,121 @@
+#include "StreamStats.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace EphysSocketNode;
+
+StreamStats::StreamStats()
+{
+    reset (0);
+}
+
+void StreamStats::reset (int64_t nowNs)
+{
+    bytes = 0;
+    packets = 0;
+    reads = 0;
+    queueFull = 0;
+    reconnects = 0;
+    stalls = 0;
+    headerMismatches = 0;
+    jitter.reset();
+    lastArrivalNs = 0;
+
+    maxQueueDepth = 0;
+    converted = 0;
+    conversionNs = 0;
+    maxConversionNs = 0;
+
+    start = Snapshot();
+    start.timeNs = nowNs;
+
+    finished = false;
+}
+
+void StreamStats::finish (int64_t nowNs)
+{
+    end = getSnapshot (nowNs);
+    finished = true;
+}
+
+void StreamStats::recordRead (int numBytes)
+{
+    add (reads, 1);
+
+    if (numBytes > 0)
+        add (bytes, numBytes);
+}
+
+void StreamStats::recordPacket (int64_t arrivalNs, double packetPeriod)
+{
+    add (packets, 1);
+
+    if (lastArrivalNs > 0 && packetPeriod > 0.0)
+        jitter.record (std::abs (arrivalNs - lastArrivalNs - (int64_t) std::llround (packetPeriod * 1e9)));
+
+    lastArrivalNs = arrivalNs;
+}
+
+void StreamStats::recordQueueFull()
+{
+    add (queueFull, 1);
+}
+
+void StreamStats::recordReconnect()
+{
+    add (reconnects, 1);
+
+    lastArrivalNs = 0;
+}
+
+void StreamStats::recordStall()
+{
+    add (stalls, 1);
+}
+
+void StreamStats::recordHeaderMismatch()
+{
+    add (headerMismatches, 1);
+}
+
+void StreamStats::recordQueueDepth (int numQueued)
+{
+    if (numQueued > maxQueueDepth.load (std::memory_order_relaxed))
+        maxQueueDepth.store (numQueued, std::memory_order_relaxed);
+}
+
+void StreamStats::recordConversion (int numPackets, int64_t elapsedNs)
+{
+    if (numPackets <= 0)
+        return;
+
+    add (converted, numPackets);
+    add (conversionNs, elapsedNs);
+
+    const int64_t perPacketNs = elapsedNs / numPackets;
+
+    if (perPacketNs > maxConversionNs.load (std::memory_order_relaxed))
+        maxConversionNs.store (perPacketNs, std::memory_order_relaxed);
+}
+
+double StreamStats::getMeanConversionUs() const
+{
+    const int64_t n = converted;
+
+    return n > 0 ? conversionNs / 1e3 / n : 0.0;
+}
+
+StreamStats::Snapshot StreamStats::getSnapshot (int64_t nowNs) const
+{
+    if (finished)
+        return end;
+
+    Snapshot snapshot;
+    snapshot.timeNs = nowNs;
+    snapshot.bytes = bytes;
+    snapshot.packets = packets;
+    snapshot.reads = reads;
+
+    return snapshot;
+}
@@ -0,0 +1,123 @@
+#ifndef __STREAMSTATSH__
+#define __STREAMSTATSH__
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/**
+    Health counters of one stream, cheap enough to update for every read and
+    packet: what the receiving thread got from the network, and how the
+    converting thread kept up with it.
+
+    Each counter has one writer (the receiving or the converting thread), so
+    updates are plain relaxed stores; any thread may read them while they run.
+*/
+class StreamStats
+{
+public:
+    /** Running totals at one point in time; rates are the difference between two of them */
+    struct Snapshot
+    {
+        int64_t timeNs = 0;
+        int64_t bytes = 0;
+        int64_t packets = 0;
+        int64_t reads = 0;
+
+        double getBytesPerSecond (const Snapshot& earlier) const { return perSecond (bytes - earlier.bytes, earlier); }
+        double getPacketsPerSecond (const Snapshot& earlier) const { return perSecond (packets - earlier.packets, earlier); }
+        double getReadsPerSecond (const Snapshot& earlier) const { return perSecond (reads - earlier.reads, earlier); }
+
+    private:
+        double perSecond (int64_t count, const Snapshot& earlier) const { return timeNs > earlier.timeNs ? count * 1e9 / (timeNs - earlier.timeNs) : 0.0; }
+    };
+
+    /** Constructor */
+    StreamStats();
+
+    /** Zeroes every counter; rates since the reset are measured from nowNs (steady clock) */
+    void reset (int64_t nowNs);
+
+    /** Freezes the running totals at nowNs, e.g. when acquisition stops, so rates over it stay put */
+    void finish (int64_t nowNs);
+
+    /** Records one read from the socket or capture, whether it returned bytes or not */
+    void recordRead (int numBytes);
+
+    /** Records a complete packet and how far its arrival strayed from packetPeriod (seconds) after the last one */
+    void recordPacket (int64_t arrivalNs, double packetPeriod);
+
+    /** Records a packet that was received but dropped because the queue was full */
+    void recordQueueFull();
+
+    /** Records a reconnection; the interval across it is not counted as jitter */
+    void recordReconnect();
+
+    /** Records the sender going quiet for longer than the stall timeout, while still connected */
+    void recordStall();
+
+    /** Records a packet whose header did not match the one read when connecting */
+    void recordHeaderMismatch();
+
+    /** Records the number of packets queued when the converting thread looked */
+    void recordQueueDepth (int numQueued);
+
+    /** Records the conversion of numPackets packets, which took elapsedNs */
+    void recordConversion (int numPackets, int64_t elapsedNs);
+
+    int64_t getNumBytes() const { return bytes; }
+    int64_t getNumPackets() const { return packets; }
+    int64_t getNumReads() const { return reads; }
+    int64_t getNumQueueFull() const { return queueFull; }
+    int64_t getNumReconnects() const { return reconnects; }
+    int64_t getNumStalls() const { return stalls; }
+    int64_t getNumHeaderMismatches() const { return headerMismatches; }
+
+    /** Most packets found queued at once, the high-water mark of the queue */
+    int getMaxQueueDepth() const { return maxQueueDepth; }
+
+    /** Packets converted, and their conversion time: the mean per packet, and the worst batch per packet */
+    int64_t getNumConverted() const { return converted; }
+    double getMeanConversionUs() const;
+    double getMaxConversionUs() const { return maxConversionNs / 1e3; }
+
+    /** Deviation of each packet's inter-arrival time from the packet period */
+    const LatencyHistogram& getJitter() const { return jitter; }
+
+    /** Running totals now, nowNs being the current time on the steady clock, or when finish() was called */
+    Snapshot getSnapshot (int64_t nowNs) const;
+
+    /** Running totals at the last reset, which rates over the whole acquisition are measured from */
+    const Snapshot& getStart() const { return start; }
+
+private:
+    /** Adds to a counter only this thread writes */
+    static void add (std::atomic<int64_t>& counter, int64_t value) { counter.store (counter.load (std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+
+    Snapshot start;
+    Snapshot end;
+    std::atomic<bool> finished;
+
+    /** Written by the receiving thread */
+    std::atomic<int64_t> bytes;
+    std::atomic<int64_t> packets;
+    std::atomic<int64_t> reads;
+    std::atomic<int64_t> queueFull;
+    std::atomic<int64_t> reconnects;
+    std::atomic<int64_t> stalls;
+    std::atomic<int64_t> headerMismatches;
+    LatencyHistogram jitter;
+    int64_t lastArrivalNs;
+
+    /** Written by the converting thread */
+    std::atomic<int> maxQueueDepth;
+    std::atomic<int64_t> converted;
+    std::atomic<int64_t> conversionNs;
+    std::atomic<int64_t> maxConversionNs;
+};
+} // namespace EphysSocketNode
+
+#endif
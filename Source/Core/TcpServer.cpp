@@ -0,0 +1,221 @@
+#include "TcpServer.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+
+inline void closeNative (intptr_t handle) { closesocket ((NativeSocket) handle); }
+inline int pollNative (pollfd* fd, int timeoutMs) { return WSAPoll (fd, 1, timeoutMs); }
+inline bool wasInterrupted() { return WSAGetLastError() == WSAEINTR; }
+#else
+using NativeSocket = int;
+
+inline void closeNative (intptr_t handle) { ::close ((NativeSocket) handle); }
+inline int pollNative (pollfd* fd, int timeoutMs) { return poll (fd, 1, timeoutMs); }
+inline bool wasInterrupted() { return errno == EINTR; }
+#endif
+
+/** Waits up to timeoutMs for a socket to be readable, or a listener to have a connection waiting.
+    Returns 1 if it is, 0 on a timeout and -1 on an error. */
+int waitReadable (intptr_t handle, int timeoutMs)
+{
+    pollfd fd {};
+    fd.fd = (NativeSocket) handle;
+    fd.events = POLLIN;
+
+    const int rc = pollNative (&fd, timeoutMs);
+
+    if (rc < 0)
+        return wasInterrupted() ? 0 : -1;
+
+    return rc > 0 ? 1 : 0;
+}
+
+/** Creates a socket for one resolved address, bound and listening; returns -1 if any step fails */
+intptr_t openListener (const addrinfo& address, bool dualStack, int receiveBufferSize)
+{
+    const NativeSocket handle = ::socket (address.ai_family, address.ai_socktype, address.ai_protocol);
+
+    if ((intptr_t) handle == -1)
+        return -1;
+
+    const int on = 1;
+    const int off = 0;
+
+#ifndef _WIN32
+    // Lets the port be listened on again right away while an old connection is in TIME_WAIT; on
+    // Windows the option would let another process steal the port instead, and rebinding works without it
+    setsockopt (handle, SOL_SOCKET, SO_REUSEADDR, (const char*) &on, sizeof (on));
+#endif
+
+    if (dualStack)
+        setsockopt (handle, IPPROTO_IPV6, IPV6_V6ONLY, (const char*) &off, sizeof (off));
+
+    if (receiveBufferSize > 0)
+        setsockopt (handle, SOL_SOCKET, SO_RCVBUF, (const char*) &receiveBufferSize, sizeof (receiveBufferSize));
+
+    if (bind (handle, address.ai_addr, (int) address.ai_addrlen) != 0 || ::listen (handle, 1) != 0)
+    {
+        closeNative ((intptr_t) handle);
+        return -1;
+    }
+
+    return (intptr_t) handle;
+}
+} // namespace
+
+TcpServer::TcpServer()
+{
+    listener = -1;
+    connection = -1;
+    port = 0;
+}
+
+TcpServer::~TcpServer()
+{
+    close();
+}
+
+bool TcpServer::listen (const std::string& host, int port_, int receiveBufferSize)
+{
+    close();
+
+    // Without a host, an IPv6 socket that also takes IPv4 connections covers every interface;
+    // where IPv6 is unavailable, an IPv4 one does
+    for (const int family : { host.empty() ? AF_INET6 : AF_UNSPEC, AF_INET })
+    {
+        addrinfo hints {};
+        hints.ai_family = family;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+        addrinfo* addresses = nullptr;
+
+        if (getaddrinfo (host.empty() ? nullptr : host.c_str(), std::to_string (port_).c_str(), &hints, &addresses) != 0)
+            continue;
+
+        for (const addrinfo* address = addresses; address != nullptr && listener == -1; address = address->ai_next)
+            listener = openListener (*address, host.empty() && address->ai_family == AF_INET6, receiveBufferSize);
+
+        freeaddrinfo (addresses);
+
+        if (listener != -1 || ! host.empty())
+            break;
+    }
+
+    if (listener == -1)
+        return false;
+
+    sockaddr_storage bound {};
+    socklen_t length = sizeof (bound);
+    getsockname ((NativeSocket) listener, (sockaddr*) &bound, &length);
+
+    port = ntohs (bound.ss_family == AF_INET6 ? ((const sockaddr_in6*) &bound)->sin6_port : ((const sockaddr_in*) &bound)->sin_port);
+
+    return true;
+}
+
+bool TcpServer::accept (int timeoutMs)
+{
+    if (listener == -1 || waitReadable (listener, timeoutMs) != 1)
+        return false;
+
+    sockaddr_storage peer {};
+    socklen_t length = sizeof (peer);
+
+    const NativeSocket handle = ::accept ((NativeSocket) listener, (sockaddr*) &peer, &length);
+
+    if ((intptr_t) handle == -1)
+        return false;
+
+    disconnect();
+
+    connection = (intptr_t) handle;
+
+    char address[NI_MAXHOST] = {};
+
+    if (getnameinfo ((const sockaddr*) &peer, length, address, sizeof (address), nullptr, 0, NI_NUMERICHOST) == 0)
+        peerAddress = address;
+
+    return true;
+}
+
+void TcpServer::disconnect()
+{
+    if (connection != -1)
+    {
+        closeNative (connection);
+        connection = -1;
+    }
+
+    peerAddress.clear();
+}
+
+void TcpServer::close()
+{
+    disconnect();
+
+    if (listener != -1)
+    {
+        closeNative (listener);
+        listener = -1;
+    }
+
+    port = 0;
+}
+
+int TcpServer::waitUntilReady (int timeoutMs)
+{
+    if (connection == -1)
+        return -1;
+
+    return waitReadable (connection, timeoutMs);
+}
+
+int TcpServer::read (std::byte* dest, int numBytes, bool block)
+{
+    if (connection == -1)
+        return -1;
+
+    if (! block && waitReadable (connection, 0) == 0)
+        return 0;
+
+    int bytesRead = 0;
+
+    while (bytesRead < numBytes)
+    {
+        const int rc = (int) recv ((NativeSocket) connection, (char*) dest + bytesRead, numBytes - bytesRead, block ? MSG_WAITALL : 0);
+
+        if (rc < 0)
+        {
+            if (wasInterrupted())
+                continue;
+
+            return bytesRead > 0 ? bytesRead : -1;
+        }
+
+        if (rc == 0 || ! block)
+            return bytesRead + rc;
+
+        bytesRead += rc;
+    }
+
+    return bytesRead;
+}
@@ -0,0 +1,76 @@
+#ifndef __TCPSERVERH__
+#define __TCPSERVERH__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace EphysSocketNode
+{
+/**
+    Listening end of a TCP connection, for senders that can only connect as a
+    client (e.g. an embedded acquisition box): the receiver listens on a port
+    and accepts the sender's connection, then reads the same byte stream a
+    client connection would carry.
+
+    Listens on IPv4 and IPv6 alike: on every interface of both through one
+    dual-stack socket, or on the one interface given. The listening socket
+    stays open when a connection is dropped, so a sender can reconnect to it.
+
+    Mirrors the parts of JUCE's StreamingSocket that the receive path uses,
+    whose own listener only binds IPv4.
+*/
+class TcpServer
+{
+public:
+    /** Constructor */
+    TcpServer();
+
+    /** Destructor; closes the connection and the listening socket */
+    ~TcpServer();
+
+    /** Listens on port (0 for any free one) at the interface address host, or on every interface if host
+        is empty. A receiveBufferSize above 0 is set on the listening socket, which accepted connections
+        inherit from the start, so the handshake can offer a window that large. Returns false if the port
+        can't be bound. */
+    bool listen (const std::string& host, int port, int receiveBufferSize = 0);
+
+    /** Waits up to timeoutMs for a sender to connect and accepts it, closing any previous connection.
+        Returns true if one was accepted. */
+    bool accept (int timeoutMs);
+
+    /** Closes the accepted connection, but keeps listening */
+    void disconnect();
+
+    /** Closes the connection and the listening socket */
+    void close();
+
+    bool isListening() const { return listener != -1; }
+    bool isConnected() const { return connection != -1; }
+
+    /** Returns the port listened on, once listening */
+    int getPort() const { return port; }
+
+    /** Returns the numeric address of the connected sender, or an empty string */
+    const std::string& getPeerAddress() const { return peerAddress; }
+
+    /** Waits up to timeoutMs for bytes (or the end of the stream) to read on the connection. Returns 1 if
+        there are, 0 on a timeout and -1 on an error. */
+    int waitUntilReady (int timeoutMs);
+
+    /** Reads up to numBytes of what has arrived, or exactly numBytes if block is set. Returns the number
+        read, 0 at the end of the stream (or if nothing has arrived and block isn't set) or -1 on an error. */
+    int read (std::byte* dest, int numBytes, bool block);
+
+    /** Returns the native handle of the connection, for socket options, or -1 if not connected */
+    intptr_t getRawSocketHandle() const { return connection; }
+
+private:
+    intptr_t listener;
+    intptr_t connection;
+    int port;
+    std::string peerAddress;
+};
+} // namespace EphysSocketNode
+
+#endif
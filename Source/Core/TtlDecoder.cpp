@@ -0,0 +1,252 @@
+#include "TtlDecoder.h"
+#include "SimdSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace EphysSocketNode;
+
+namespace
+{
+/** Reads one element as an integer without assuming alignment */
+template <typename T>
+inline uint64_t loadWord (const std::byte* src, size_t i)
+{
+    T value;
+    std::memcpy (&value, src + i * sizeof (T), sizeof (T));
+    return (uint64_t) (int64_t) value;
+}
+
+/** Truncates a floating-point element to an integer, clamped to the range of int64_t; NaN and infinity have no integer value */
+inline uint64_t truncateWord (double value)
+{
+    if (! std::isfinite (value))
+        return 0;
+
+    if (value >= 9223372036854775808.0)
+        return (uint64_t) std::numeric_limits<int64_t>::max();
+
+    if (value < -9223372036854775808.0)
+        return (uint64_t) std::numeric_limits<int64_t>::min();
+
+    return (uint64_t) (int64_t) value;
+}
+
+template <>
+inline uint64_t loadWord<float> (const std::byte* src, size_t i)
+{
+    float value;
+    std::memcpy (&value, src + i * sizeof (float), sizeof (float));
+    return truncateWord (value);
+}
+
+template <>
+inline uint64_t loadWord<double> (const std::byte* src, size_t i)
+{
+    double value;
+    std::memcpy (&value, src + i * sizeof (double), sizeof (double));
+    return truncateWord (value);
+}
+
+/** ORs the masked, shifted elements of one row, numSamples elements stride apart, into words */
+template <typename T>
+void packRowScalar (const std::byte* row, size_t stride, int numSamples, uint64_t* words, int shift, uint64_t mask)
+{
+    for (int s = 0; s < numSamples; s++)
+    {
+        words[s] |= (loadWord<T> (row, (size_t) s * stride) & mask) << shift;
+    }
+}
+
+int countEdgesScalar (const uint64_t* words, int numSamples, uint64_t previous)
+{
+    int edges = 0;
+
+    for (int s = 0; s < numSamples; s++)
+    {
+        edges += words[s] != previous;
+        previous = words[s];
+    }
+
+    return edges;
+}
+
+#if EPHYS_SOCKET_X86
+
+/** Widens 4 consecutive elements to 64-bit lanes */
+EPHYS_SOCKET_TARGET ("avx2")
+inline __m256i widen4 (const uint8_t* p)
+{
+    int32_t raw;
+    std::memcpy (&raw, p, 4);
+    return _mm256_cvtepu8_epi64 (_mm_cvtsi32_si128 (raw));
+}
+
+EPHYS_SOCKET_TARGET ("avx2")
+inline __m256i widen4 (const uint16_t* p) { return _mm256_cvtepu16_epi64 (_mm_loadl_epi64 ((const __m128i*) p)); }
+
+EPHYS_SOCKET_TARGET ("avx2")
+inline __m256i widen4 (const uint32_t* p) { return _mm256_cvtepu32_epi64 (_mm_loadu_si128 ((const __m128i*) p)); }
+
+/** Integer rows only; signed elements are zero-extended, which the mask makes equivalent */
+template <typename T, typename U>
+EPHYS_SOCKET_TARGET ("avx2")
+void packRowAvx2 (const std::byte* row, int numSamples, uint64_t* words, int shift, uint64_t mask)
+{
+    const U* buf = (const U*) row;
+    const __m256i m = _mm256_set1_epi64x ((long long) mask);
+    const __m128i count = _mm_cvtsi32_si128 (shift);
+
+    int s = 0;
+
+    for (; s + 4 <= numSamples; s += 4)
+    {
+        const __m256i lines = _mm256_sll_epi64 (_mm256_and_si256 (widen4 (buf + s), m), count);
+        __m256i* dest = (__m256i*) (words + s);
+        _mm256_storeu_si256 (dest, _mm256_or_si256 (_mm256_loadu_si256 (dest), lines));
+    }
+
+    packRowScalar<T> (row + (size_t) s * sizeof (T), 1, numSamples - s, words + s, shift, mask);
+}
+
+EPHYS_SOCKET_TARGET ("avx2")
+int countEdgesAvx2 (const uint64_t* words, int numSamples, uint64_t previous)
+{
+    if (numSamples == 0)
+        return 0;
+
+    int edges = words[0] != previous;
+    int s = 1;
+
+    // Each word is compared with the one before it, four at a time
+    for (; s + 4 <= numSamples; s += 4)
+    {
+        const __m256i current = _mm256_loadu_si256 ((const __m256i*) (words + s));
+        const __m256i before = _mm256_loadu_si256 ((const __m256i*) (words + s - 1));
+        const int same = _mm256_movemask_pd (_mm256_castsi256_pd (_mm256_cmpeq_epi64 (current, before)));
+
+        edges += 4 - ((same & 1) + ((same >> 1) & 1) + ((same >> 2) & 1) + ((same >> 3) & 1));
+    }
+
+    return edges + countEdgesScalar (words + s, numSamples - s, words[s - 1]);
+}
+
+#endif
+
+} // namespace
+
+TtlDecoder::TtlDecoder()
+{
+    depth = U16;
+    elementSize = 2;
+    numChannels = 0;
+    numSamples = 0;
+    layout = CHANNEL_MAJOR;
+
+    numRows = 0;
+    bitsPerRow = 16;
+    mask = 0xffff;
+
+    simdLevel = DataConverter::getMaxSimdLevel();
+}
+
+void TtlDecoder::prepare (Depth depth_, int elementSize_, int numChannels_, int numSamples_, Layout layout_, int numRows_, int bitsPerRow_)
+{
+    depth = depth_;
+    elementSize = elementSize_;
+    numChannels = numChannels_;
+    numSamples = numSamples_;
+    layout = layout_;
+
+    const bool isFloat = depth == F32 || depth == F64;
+    const int elementBits = isFloat ? 64 : elementSize * 8;
+
+    bitsPerRow = bitsPerRow_ > 0 ? std::min (bitsPerRow_, elementBits) : std::min (elementSize * 8, 64);
+    numRows = std::max (0, std::min ({ numRows_, numChannels, 64 / bitsPerRow }));
+    mask = bitsPerRow >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << bitsPerRow) - 1;
+}
+
+int TtlDecoder::decode (const std::byte* matrix, uint64_t* words, uint64_t& previous) const
+{
+    std::fill (words, words + numSamples, (uint64_t) 0);
+
+    const bool channelMajor = layout == CHANNEL_MAJOR;
+    const size_t stride = channelMajor ? 1 : (size_t) numChannels;
+
+#if EPHYS_SOCKET_X86
+    const bool avx2 = simdLevel >= SimdLevel::AVX2 && DataConverter::getMaxSimdLevel() >= SimdLevel::AVX2;
+#else
+    const bool avx2 = false;
+#endif
+
+    for (int r = 0; r < numRows; r++)
+    {
+        const int ch = numChannels - numRows + r;
+        const std::byte* row = matrix + (channelMajor ? (size_t) ch * numSamples : (size_t) ch) * elementSize;
+        const int shift = r * bitsPerRow;
+
+#if EPHYS_SOCKET_X86
+        if (avx2 && channelMajor)
+        {
+            switch (depth)
+            {
+                case U8:
+                    packRowAvx2<uint8_t, uint8_t> (row, numSamples, words, shift, mask);
+                    continue;
+                case S8:
+                    packRowAvx2<int8_t, uint8_t> (row, numSamples, words, shift, mask);
+                    continue;
+                case U16:
+                    packRowAvx2<uint16_t, uint16_t> (row, numSamples, words, shift, mask);
+                    continue;
+                case S16:
+                    packRowAvx2<int16_t, uint16_t> (row, numSamples, words, shift, mask);
+                    continue;
+                case S32:
+                    packRowAvx2<int32_t, uint32_t> (row, numSamples, words, shift, mask);
+                    continue;
+                default:
+                    break;
+            }
+        }
+#endif
+
+        switch (depth)
+        {
+            case U8:
+                packRowScalar<uint8_t> (row, stride, numSamples, words, shift, mask);
+                break;
+            case S8:
+                packRowScalar<int8_t> (row, stride, numSamples, words, shift, mask);
+                break;
+            case U16:
+                packRowScalar<uint16_t> (row, stride, numSamples, words, shift, mask);
+                break;
+            case S16:
+                packRowScalar<int16_t> (row, stride, numSamples, words, shift, mask);
+                break;
+            case S32:
+                packRowScalar<int32_t> (row, stride, numSamples, words, shift, mask);
+                break;
+            case F32:
+                packRowScalar<float> (row, stride, numSamples, words, shift, mask);
+                break;
+            case F64:
+                packRowScalar<double> (row, stride, numSamples, words, shift, mask);
+                break;
+        }
+    }
+
+#if EPHYS_SOCKET_X86
+    const int edges = avx2 ? countEdgesAvx2 (words, numSamples, previous) : countEdgesScalar (words, numSamples, previous);
+#else
+    const int edges = countEdgesScalar (words, numSamples, previous);
+#endif
+
+    if (numSamples > 0)
+        previous = words[numSamples - 1];
+
+    return edges;
+}
@@ -0,0 +1,61 @@
+#ifndef __TTLDECODERH__
+#define __TTLDECODERH__
+
+#include "DataConverter.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace EphysSocketNode
+{
+/**
+    Decodes digital lines carried in the incoming matrices into one 64-bit
+    TTL word per sample, as the DataBuffer expects them.
+
+    The last numRows channels of every matrix are digital rows. Each row holds
+    bitsPerRow lines in the low bits of its samples, and row r fills bits
+    r * bitsPerRow and up of the word. Float rows are truncated to integers.
+
+    Channel-major integer rows are packed, and the samples whose word changed
+    are counted, four samples per instruction where the CPU has AVX2.
+*/
+class TtlDecoder
+{
+public:
+    /** Constructor */
+    TtlDecoder();
+
+    /** Describes the incoming matrices and their digital rows; bitsPerRow 0 uses the element width.
+        Rows that would not fit in 64 bits are ignored. */
+    void prepare (Depth depth, int elementSize, int numChannels, int numSamples, Layout layout, int numRows, int bitsPerRow);
+
+    /** Caps the instruction set used, e.g. to match the sample converter */
+    void setSimdLevel (SimdLevel level) { simdLevel = level; }
+
+    /** Returns the number of digital rows decoded */
+    int getNumRows() const { return numRows; }
+
+    /** Returns the number of digital lines, at most 64 */
+    int getNumLines() const { return numRows * bitsPerRow; }
+
+    /** Packs the lines of every sample of matrix into words. previous is the word of the sample
+        before the matrix and becomes the word of its last sample. Returns the number of samples
+        whose word differs from the one before. */
+    int decode (const std::byte* matrix, uint64_t* words, uint64_t& previous) const;
+
+private:
+    Depth depth;
+    int elementSize;
+    int numChannels;
+    int numSamples;
+    Layout layout;
+
+    int numRows;
+    int bitsPerRow;
+    uint64_t mask;
+
+    SimdLevel simdLevel;
+};
+} // namespace EphysSocketNode
+
+#endif
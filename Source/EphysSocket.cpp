@@ -5,6 +5,8 @@
 #include "EphysSocket.h"
 #include "EphysSocketEditor.h"
 
+#include <chrono>
+
 using namespace EphysSocketNode;
 
 DataThread* EphysSocket::createDataThread (SourceNode* sn)
@@ -12,18 +14,18 @@ DataThread* EphysSocket::createDataThread (SourceNode* sn)
     return new EphysSocket (sn);
 }
 
-EphysSocket::EphysSocket (SourceNode* sn) : DataThread (sn), socket ("socket_thread", this)
+EphysSocket::EphysSocket (SourceNode* sn) : DataThread (sn)
 {
-    port = DEFAULT_PORT;
-    sample_rate = DEFAULT_SAMPLE_RATE;
-
-    total_samples = 0;
-    eventState = 0;
-
-    data_scale = DEFAULT_DATA_SCALE;
-    data_offset = DEFAULT_DATA_OFFSET;
-
-    sourceBuffers.add (new DataBuffer (socket.num_channels, sample_rate * bufferSizeInSeconds)); // start with 2 channels and automatically resize
+    drain_budget = DEFAULT_DRAIN_BUDGET;
+    gap_fill = DEFAULT_GAP_FILL;
+    low_latency = DEFAULT_LOW_LATENCY;
+    receive_buffer = DEFAULT_RECEIVE_BUFFER;
+    cpu_affinity = DEFAULT_CPU_AFFINITY;
+    lastPushNs = 0;
+    selectedStream = 0;
+    streamsConnected = false;
+
+    addStream();
 }
 
 std::unique_ptr<GenericEditor> EphysSocket::createEditor (SourceNode* sn)
@@ -42,54 +44,450 @@ void EphysSocket::registerParameters()
     addFloatParameter (Parameter::PROCESSOR_SCOPE, "sample_rate", "Sample Rate", "Sample rate of incoming data", "Hz", DEFAULT_SAMPLE_RATE, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE, 1.0f);
     addFloatParameter (Parameter::PROCESSOR_SCOPE, "data_scale", "Scale", "Scale of incoming data", "", DEFAULT_DATA_SCALE, MIN_DATA_SCALE, MAX_DATA_SCALE, 0.1f);
     addFloatParameter (Parameter::PROCESSOR_SCOPE, "data_offset", "Offset", "Offset of incoming data", "", DEFAULT_DATA_OFFSET, MIN_DATA_OFFSET, MAX_DATA_OFFSET, 1.0f);
+    addCategoricalParameter (Parameter::PROCESSOR_SCOPE, "layout", "Layout", "Order of the samples in each incoming matrix", { "Channels x Samples", "Samples x Channels" }, DEFAULT_LAYOUT);
+    addCategoricalParameter (Parameter::PROCESSOR_SCOPE, "transport", "Transport", "Protocol the data is received over", { "TCP", "UDP", "Replay", "Unix socket", "Shared memory", "TCP server" }, DEFAULT_TRANSPORT);
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "multicast_group", "Multicast", "Multicast group to join in UDP mode (empty for unicast)", "");
+    addIntParameter (Parameter::PROCESSOR_SCOPE, "drain_budget", "Drain budget", "Maximum packets pushed per update (0 = all queued packets)", DEFAULT_DRAIN_BUDGET, MIN_DRAIN_BUDGET, MAX_DRAIN_BUDGET);
+    addCategoricalParameter (Parameter::PROCESSOR_SCOPE, "gap_fill", "Gap fill", "What is pushed in place of samples lost on the way", { "Off", "Zeros", "Hold", "NaN" }, DEFAULT_GAP_FILL);
+    addIntParameter (Parameter::PROCESSOR_SCOPE, "ttl_rows", "TTL rows", "Rows at the end of each matrix decoded as digital lines (0 = none)", DEFAULT_TTL_ROWS, 0, MAX_TTL_ROWS);
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "channel_map", "Channel map", "File with the name, type, scale and offset of each channel (empty for none)", "");
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "capture_file", "Capture", "File the raw received bytes are captured to (empty for none)", "");
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "replay_file", "Replay", "Capture file received from when the transport is Replay", "");
+    addCategoricalParameter (Parameter::PROCESSOR_SCOPE, "replay_pace", "Replay pace", "Whether a capture is replayed as it was recorded or as fast as possible", { "Recorded", "Fast" }, DEFAULT_REPLAY_PACE);
+    addIntParameter (Parameter::PROCESSOR_SCOPE, "ttl_bits", "TTL bits", "Digital lines per TTL row (0 = element width)", DEFAULT_TTL_BITS, 0, MAX_TTL_BITS);
+    addBooleanParameter (Parameter::PROCESSOR_SCOPE, "low_latency", "Low latency", "Receive at real-time priority without delayed TCP acknowledgements, and poll for packets if a CPU is set", DEFAULT_LOW_LATENCY);
+    addIntParameter (Parameter::PROCESSOR_SCOPE, "receive_buffer", "Receive buffer", "Kernel receive buffer of every socket in kB (0 = OS default)", DEFAULT_RECEIVE_BUFFER, 0, MAX_RECEIVE_BUFFER);
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "local_path", "Local path", "Unix socket path or shared-memory name of a sender on this machine (empty to derive one from the port)", "");
+    addStringParameter (Parameter::PROCESSOR_SCOPE, "host", "Host", "Host to connect to over TCP, or address of the interface a TCP server listens on (empty for localhost, or every interface)", "");
+    addFloatParameter (Parameter::PROCESSOR_SCOPE, "output_rate", "Output rate", "Rate the stream is decimated to before other processors see it (0 = sample rate)", "Hz", DEFAULT_OUTPUT_RATE, 0.0f, MAX_SAMPLE_RATE, 1.0f);
+    addIntParameter (Parameter::PROCESSOR_SCOPE, "cpu_affinity", "CPU", "CPU the first stream is received on, the next stream on the next CPU (-1 = any)", DEFAULT_CPU_AFFINITY, -1, MAX_CPU_AFFINITY);
 }
 
 void EphysSocket::disconnectSocket()
 {
-    socket.signalThreadShouldExit();
-    socket.waitForThreadToExit (1000);
-    socket.disconnectSocket();
+    // Every thread is told first, so they wind down together; notify() cuts short a wait between attempts
+    for (auto stream : streams)
+    {
+        stream->socket.signalThreadShouldExit();
+        stream->socket.notify();
+    }
+
+    for (auto stream : streams)
+    {
+        stream->socket.waitForThreadToExit (1000);
+        stream->socket.disconnectSocket();
+    }
 
-    getParameter ("port")->setEnabled (true);
-    getParameter ("sample_rate")->setEnabled (true);
-    getParameter ("data_scale")->setEnabled (true);
-    getParameter ("data_offset")->setEnabled (true);
+    streamsConnected = false;
+
+    setStreamParametersEnabled (true);
 
     if (sn->getEditor() != nullptr) // check if headless
         static_cast<EphysSocketEditor*> (sn->getEditor())->disconnected();
 }
 
-bool EphysSocket::connectSocket (bool printOutput)
+bool EphysSocket::connectSocket()
 {
-    if (socket.connectSocket (port, printOutput))
+    streamsConnected = false;
+
+    for (auto stream : streams)
     {
-        getParameter ("port")->setEnabled (false);
-        getParameter ("sample_rate")->setEnabled (false);
-        getParameter ("data_scale")->setEnabled (false);
-        getParameter ("data_offset")->setEnabled (false);
+        if (! stream->socket.connectSocket (stream->settings.port))
+        {
+            disconnectSocket();
+            return false;
+        }
+    }
 
-        if (sn->getEditor() != nullptr) // check if headless
-            static_cast<EphysSocketEditor*> (sn->getEditor())->connected();
+    // The socket threads read the settings while they connect
+    setStreamParametersEnabled (false);
+
+    if (sn->getEditor() != nullptr) // check if headless
+        static_cast<EphysSocketEditor*> (sn->getEditor())->connecting();
+
+    return true;
+}
+
+void EphysSocket::connectionStateChanged()
+{
+    triggerAsyncUpdate();
+}
+
+void EphysSocket::handleAsyncUpdate()
+{
+    for (auto stream : streams)
+    {
+        if (stream->socket.getConnectionState() == FAILED)
+        {
+            LOGC ("Ephys Socket: a stream failed; disconnecting every stream");
+            disconnectSocket();
+            return;
+        }
+    }
+
+    auto editor = static_cast<EphysSocketEditor*> (sn->getEditor());
+
+    if (! streamsConnected && foundInputSource())
+    {
+        streamsConnected = true; // A reconnect must match the first header, so the channels only change once
+
+        LOGC ("Ephys Socket: every stream is connected");
+
+        if (editor != nullptr)
+            CoreServices::updateSignalChain (editor);
+    }
+
+    if (editor != nullptr)
+        editor->updateConnectionStatus();
+}
+
+String EphysSocket::getConnectionStatus() const
+{
+    const int64 nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (int i = 0; i < streams.size(); i++)
+    {
+        const SocketThread& socket = streams[i]->socket;
+        const StreamSettings& settings = streams[i]->settings;
+        const ConnectionMonitor& monitor = socket.getMonitor();
+
+        const String stream = streams.size() > 1 ? "Stream " + String (i + 1) + ": " : String();
+        const String attempts = monitor.getNumAttempts() > 0 ? " (attempt " + String (monitor.getNumAttempts() + 1) + ", retrying every " + String (monitor.getRetryDelayMs()) + " ms)" : String();
+
+        switch (socket.getConnectionState())
+        {
+            case DISCONNECTED:
+                return stream + "Not connected.";
+
+            case CONNECTING:
+                if (settings.transport == TCP_SERVER)
+                    return stream + "Waiting for a sender on port " + String (settings.port) + attempts + "...";
+
+                return stream + (socket.hasConnected() ? "Reconnecting" : "Connecting") + attempts + "...";
+
+            case WAITING_FOR_HEADER:
+                return stream + "Waiting for the first packet...";
+
+            case STALLED:
+                return stream + "Stalled, nothing received for " + String (monitor.getSilenceMs (nowNs)) + " ms.";
+
+            case FAILED:
+                return stream + "Failed.";
+
+            case CONNECTED:
+                break;
+        }
+    }
+
+    return String();
+}
+
+String EphysSocket::getConnectionState()
+{
+    if (foundInputSource())
+        return CONNECTION_STATE_CONNECTED;
 
+    for (auto stream : streams)
+    {
+        const ConnectionState state = stream->socket.getConnectionState();
+
+        if (state != DISCONNECTED && state != FAILED)
+            return CONNECTION_STATE_CONNECTING;
+    }
+
+    return CONNECTION_STATE_DISCONNECTED;
+}
+
+bool EphysSocket::isSocketBusy()
+{
+    if (getConnectionState() != CONNECTION_STATE_DISCONNECTED)
         return true;
+
+    for (auto stream : streams)
+    {
+        if (stream->socket.isThreadRunning())
+            return true;
     }
 
     return false;
 }
 
+bool EphysSocket::isMulticastGroup (const String& address)
+{
+    StringArray octets = StringArray::fromTokens (address, ".", "");
+
+    if (octets.size() != 4)
+        return false;
+
+    for (auto& octet : octets)
+    {
+        if (! octet.containsOnly ("0123456789") || octet.isEmpty() || octet.getIntValue() > 255)
+            return false;
+    }
+
+    return octets[0].getIntValue() >= 224 && octets[0].getIntValue() <= 239;
+}
+
+void EphysSocket::setStreamParametersEnabled (bool enabled)
+{
+    getParameter ("port")->setEnabled (enabled);
+    getParameter ("sample_rate")->setEnabled (enabled);
+    getParameter ("data_scale")->setEnabled (enabled);
+    getParameter ("data_offset")->setEnabled (enabled);
+    getParameter ("layout")->setEnabled (enabled);
+    getParameter ("transport")->setEnabled (enabled);
+    getParameter ("multicast_group")->setEnabled (enabled);
+    getParameter ("ttl_rows")->setEnabled (enabled);
+    getParameter ("ttl_bits")->setEnabled (enabled);
+    getParameter ("channel_map")->setEnabled (enabled);
+    getParameter ("capture_file")->setEnabled (enabled);
+    getParameter ("replay_file")->setEnabled (enabled);
+    getParameter ("replay_pace")->setEnabled (enabled);
+    getParameter ("local_path")->setEnabled (enabled);
+    getParameter ("output_rate")->setEnabled (enabled);
+    getParameter ("host")->setEnabled (enabled);
+
+    getParameter ("low_latency")->setEnabled (enabled);
+    getParameter ("receive_buffer")->setEnabled (enabled);
+    getParameter ("cpu_affinity")->setEnabled (enabled);
+}
+
+bool EphysSocket::loadChannelMap (StreamSettings& settings, const String& file)
+{
+    if (file.isEmpty())
+    {
+        settings.channels.clear();
+        settings.channel_map = String();
+        return true;
+    }
+
+    const File mapFile (File::isAbsolutePath (file) ? File (file) : File::getCurrentWorkingDirectory().getChildFile (file));
+
+    if (! mapFile.existsAsFile())
+    {
+        LOGE ("Ephys Socket: channel map ", file, " not found");
+        return false;
+    }
+
+    std::string error;
+
+    if (! settings.channels.parse (mapFile.loadFileAsString().toStdString(), error))
+    {
+        LOGE ("Ephys Socket: invalid channel map ", file, ", ", error);
+        return false;
+    }
+
+    settings.channel_map = file;
+    LOGC ("Ephys Socket loaded ", (int) settings.channels.getEntries().size(), " channels from ", file);
+
+    return true;
+}
+
+bool EphysSocket::addStream()
+{
+    if (streams.size() >= MAX_STREAMS)
+    {
+        return false;
+    }
+
+    auto stream = streams.add (new SocketStream (streams.size(), this, packetsReady));
+    sourceBuffers.add (new DataBuffer (stream->socket.num_channels, stream->settings.getOutputSampleRate() * SocketStream::bufferSizeInSeconds)); // resized once the stream connects
+
+    if (streams.size() > 1)
+    {
+        selectStream (streams.size() - 1);
+    }
+
+    return true;
+}
+
+bool EphysSocket::removeStream()
+{
+    if (streams.size() <= 1)
+    {
+        return false;
+    }
+
+    streams.remove (selectedStream);
+    sourceBuffers.removeLast();
+
+    // The streams after it move up, and pick their CPU and thread name by position
+    for (int i = selectedStream; i < streams.size(); i++)
+    {
+        streams[i]->socket.setIndex (i);
+    }
+
+    selectStream (jmin (selectedStream, streams.size() - 1));
+
+    return true;
+}
+
+void EphysSocket::selectStream (int index)
+{
+    selectedStream = jlimit (0, streams.size() - 1, index);
+
+    const StreamSettings& settings = streams[selectedStream]->settings;
+
+    // Setting the parameters writes the same values back into the selected stream
+    getParameter ("port")->setNextValue (settings.port);
+    getParameter ("sample_rate")->setNextValue (settings.sample_rate);
+    getParameter ("data_scale")->setNextValue (settings.data_scale);
+    getParameter ("data_offset")->setNextValue (settings.data_offset);
+    getParameter ("layout")->setNextValue ((int) settings.layout);
+    getParameter ("transport")->setNextValue ((int) settings.transport);
+    getParameter ("multicast_group")->setNextValue (settings.multicast_group);
+    getParameter ("ttl_rows")->setNextValue (settings.ttl_rows);
+    getParameter ("ttl_bits")->setNextValue (settings.ttl_bits);
+    getParameter ("channel_map")->setNextValue (settings.channel_map);
+    getParameter ("capture_file")->setNextValue (settings.capture_file);
+    getParameter ("replay_file")->setNextValue (settings.replay_file);
+    getParameter ("replay_pace")->setNextValue ((int) settings.replay_pace);
+    getParameter ("local_path")->setNextValue (settings.local_path);
+    getParameter ("output_rate")->setNextValue (settings.output_rate);
+    getParameter ("host")->setNextValue (settings.host);
+}
+
+int EphysSocket::getNumStreams() const
+{
+    return streams.size();
+}
+
+int EphysSocket::getSelectedStream() const
+{
+    return selectedStream;
+}
+
+void EphysSocket::saveCustomParametersToXml (XmlElement* xml)
+{
+    XmlElement* streamsXml = xml->createNewChildElement ("STREAMS");
+    streamsXml->setAttribute ("selected", selectedStream);
+
+    for (auto stream : streams)
+    {
+        XmlElement* streamXml = streamsXml->createNewChildElement ("STREAM");
+        streamXml->setAttribute ("port", stream->settings.port);
+        streamXml->setAttribute ("sample_rate", stream->settings.sample_rate);
+        streamXml->setAttribute ("data_scale", stream->settings.data_scale);
+        streamXml->setAttribute ("data_offset", stream->settings.data_offset);
+        streamXml->setAttribute ("layout", (int) stream->settings.layout);
+        streamXml->setAttribute ("transport", (int) stream->settings.transport);
+        streamXml->setAttribute ("multicast_group", stream->settings.multicast_group);
+        streamXml->setAttribute ("ttl_rows", stream->settings.ttl_rows);
+        streamXml->setAttribute ("ttl_bits", stream->settings.ttl_bits);
+        streamXml->setAttribute ("channel_map", stream->settings.channel_map);
+        streamXml->setAttribute ("capture_file", stream->settings.capture_file);
+        streamXml->setAttribute ("replay_file", stream->settings.replay_file);
+        streamXml->setAttribute ("replay_pace", (int) stream->settings.replay_pace);
+        streamXml->setAttribute ("local_path", stream->settings.local_path);
+        streamXml->setAttribute ("output_rate", stream->settings.output_rate);
+        streamXml->setAttribute ("host", stream->settings.host);
+
+        for (const auto& entry : stream->settings.channels.getEntries())
+        {
+            XmlElement* channelXml = streamXml->createNewChildElement ("CHANNEL");
+            channelXml->setAttribute ("index", entry.first + 1);
+            channelXml->setAttribute ("name", String (entry.second.name));
+            channelXml->setAttribute ("type", ChannelMap::getTypeName (entry.second.type));
+            channelXml->setAttribute ("scale", entry.second.scale);
+            channelXml->setAttribute ("offset", entry.second.offset);
+        }
+    }
+}
+
+void EphysSocket::loadCustomParametersFromXml (XmlElement* xml)
+{
+    XmlElement* streamsXml = xml->getChildByName ("STREAMS");
+
+    if (streamsXml == nullptr)
+    {
+        return;
+    }
+
+    const int numStreams = jlimit (1, (int) MAX_STREAMS, streamsXml->getNumChildElements());
+
+    while (streams.size() < numStreams)
+        addStream();
+
+    while (streams.size() > numStreams)
+    {
+        streams.removeLast();
+        sourceBuffers.removeLast();
+    }
+
+    for (int i = 0; i < numStreams; i++)
+    {
+        XmlElement* streamXml = streamsXml->getChildElement (i);
+        StreamSettings& settings = streams[i]->settings;
+
+        settings.port = streamXml->getIntAttribute ("port", DEFAULT_PORT + i);
+        settings.sample_rate = (float) streamXml->getDoubleAttribute ("sample_rate", DEFAULT_SAMPLE_RATE);
+        settings.data_scale = (float) streamXml->getDoubleAttribute ("data_scale", DEFAULT_DATA_SCALE);
+        settings.data_offset = (float) streamXml->getDoubleAttribute ("data_offset", DEFAULT_DATA_OFFSET);
+        settings.layout = (Layout) streamXml->getIntAttribute ("layout", DEFAULT_LAYOUT);
+        settings.transport = (Transport) streamXml->getIntAttribute ("transport", DEFAULT_TRANSPORT);
+        settings.multicast_group = streamXml->getStringAttribute ("multicast_group", String());
+        settings.ttl_rows = streamXml->getIntAttribute ("ttl_rows", DEFAULT_TTL_ROWS);
+        settings.ttl_bits = streamXml->getIntAttribute ("ttl_bits", DEFAULT_TTL_BITS);
+        settings.channel_map = streamXml->getStringAttribute ("channel_map", String());
+        settings.capture_file = streamXml->getStringAttribute ("capture_file", String());
+        settings.replay_file = streamXml->getStringAttribute ("replay_file", String());
+        settings.replay_pace = (ReplayPace) streamXml->getIntAttribute ("replay_pace", DEFAULT_REPLAY_PACE);
+        settings.local_path = streamXml->getStringAttribute ("local_path", String());
+        settings.output_rate = (float) streamXml->getDoubleAttribute ("output_rate", DEFAULT_OUTPUT_RATE);
+        settings.host = streamXml->getStringAttribute ("host", String());
+        settings.channels.clear();
+
+        for (auto* channelXml : streamXml->getChildWithTagNameIterator ("CHANNEL"))
+        {
+            ChannelInfo info;
+            info.name = channelXml->getStringAttribute ("name").toStdString();
+            info.scale = (float) channelXml->getDoubleAttribute ("scale", DEFAULT_DATA_SCALE);
+            info.offset = (float) channelXml->getDoubleAttribute ("offset", DEFAULT_DATA_OFFSET);
+            ChannelMap::parseType (channelXml->getStringAttribute ("type").toStdString(), info.type);
+
+            const int index = channelXml->getIntAttribute ("index", 0);
+
+            if (index >= 1)
+                settings.channels.set (index - 1, info);
+        }
+    }
+
+    // Processor parameters hold the values of the stream that was selected when saving
+    selectStream (streamsXml->getIntAttribute ("selected", 0));
+}
+
 bool EphysSocket::errorFlag()
 {
-    return socket.isError();
+    for (auto stream : streams)
+    {
+        if (stream->socket.isError())
+            return true;
+    }
+
+    return false;
+}
+
+int EphysSocket::getQueueDepth() const
+{
+    int depth = 0;
+
+    for (auto stream : streams)
+        depth += stream->socket.packets.getNumReady();
+
+    return depth;
+}
+
+const StreamStats& EphysSocket::getStreamStats (int index) const
+{
+    return streams[index]->socket.stats;
 }
 
 void EphysSocket::resizeBuffers()
 {
-    sourceBuffers[0]->resize (socket.num_channels, sample_rate * bufferSizeInSeconds);
-    convbuf.resize (socket.num_channels * socket.num_samp);
-    sampleNumbers.resize (socket.num_samp);
-    timestamps.clear();
-    timestamps.insertMultiple (0, 0.0, socket.num_samp);
-    ttlEventWords.resize (socket.num_samp);
+    for (int i = 0; i < streams.size(); i++)
+    {
+        streams[i]->resizeBuffers (sourceBuffers[i]);
+    }
 }
 
 void EphysSocket::updateSettings (OwnedArray<ContinuousChannel>* continuousChannels,
@@ -106,75 +504,185 @@ void EphysSocket::updateSettings (OwnedArray<ContinuousChannel>* continuousChann
     configurationObjects->clear();
     sourceStreams->clear();
 
-    DataStream::Settings settings {
-        "EphysSocketStream",
-        "Data acquired via network stream",
-        "ephyssocket.data",
+    for (int i = 0; i < streams.size(); i++)
+    {
+        SocketStream* stream = streams[i];
+        const String suffix = i == 0 ? String() : String (i + 1);
 
-        sample_rate
+        DataStream::Settings settings {
+            "EphysSocketStream" + suffix,
+            "Data acquired via network stream on port " + String (stream->settings.port),
+            "ephyssocket.data",
 
-    };
+            stream->settings.getOutputSampleRate()
 
-    sourceStreams->add (new DataStream (settings));
-    sourceBuffers[0]->resize (socket.num_channels, sample_rate * bufferSizeInSeconds);
+        };
 
-    for (int ch = 0; ch < socket.num_channels; ch++)
-    {
-        ContinuousChannel::Settings settings {
-            ContinuousChannel::Type::ELECTRODE,
-            "CH" + String (ch + 1),
-            "Channel acquired via network stream",
-            "ephyssocket.continuous",
+        DataStream* dataStream = sourceStreams->add (new DataStream (settings));
+        stream->resizeBuffers (sourceBuffers[i]);
 
-            data_scale,
+        for (int ch = 0; ch < stream->getNumAnalogChannels(); ch++)
+        {
+            const ChannelInfo* info = stream->settings.channels.find (ch);
+            const ContinuousChannel::Type types[] = { ContinuousChannel::Type::ELECTRODE, ContinuousChannel::Type::AUX, ContinuousChannel::Type::ADC };
 
-            sourceStreams->getFirst()
-        };
+            ContinuousChannel::Settings settings {
+                info != nullptr ? types[info->type] : ContinuousChannel::Type::ELECTRODE,
+                info != nullptr ? String (info->name) : "CH" + String (ch + 1),
+                "Channel acquired via network stream",
+                "ephyssocket.continuous",
 
-        continuousChannels->add (new ContinuousChannel (settings));
-    }
+                info != nullptr ? info->scale : stream->settings.data_scale,
 
-    EventChannel::Settings eventSettings {
-        EventChannel::Type::TTL,
-        "Events",
-        "Events acquired via network stream",
-        "ephyssocket.events",
-        sourceStreams->getFirst(),
-        1
-    };
+                dataStream
+            };
 
-    eventChannels->add (new EventChannel (eventSettings));
+            continuousChannels->add (new ContinuousChannel (settings));
+        }
+
+        EventChannel::Settings eventSettings {
+            EventChannel::Type::TTL,
+            "Events",
+            "Events acquired via network stream",
+            "ephyssocket.events",
+            dataStream,
+            jmax (1, stream->getNumTtlLines())
+        };
+
+        eventChannels->add (new EventChannel (eventSettings));
+    }
 }
 
 bool EphysSocket::foundInputSource()
 {
-    return socket.isConnected();
+    for (auto stream : streams)
+    {
+        if (! stream->socket.isConnected())
+            return false;
+    }
+
+    return true;
 }
 
 bool EphysSocket::isReady()
 {
-    return socket.isConnected();
+    return foundInputSource();
 }
 
 void EphysSocket::parameterValueChanged (Parameter* parameter)
 {
+    StreamSettings& settings = streams[selectedStream]->settings;
+
     if (parameter->getName() == "port")
     {
-        port = (int) parameter->getValue();
+        settings.port = (int) parameter->getValue();
     }
     else if (parameter->getName() == "sample_rate")
     {
-        sample_rate = (float) parameter->getValue();
+        settings.sample_rate = (float) parameter->getValue();
         CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new sample rate
     }
+    else if (parameter->getName() == "output_rate")
+    {
+        settings.output_rate = (float) parameter->getValue();
+        CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new output rate
+    }
     else if (parameter->getName() == "data_scale")
     {
-        data_scale = (float) parameter->getValue();
+        settings.data_scale = (float) parameter->getValue();
         CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new data scale
     }
     else if (parameter->getName() == "data_offset")
     {
-        data_offset = (float) parameter->getValue();
+        settings.data_offset = (float) parameter->getValue();
+    }
+    else if (parameter->getName() == "layout")
+    {
+        settings.layout = (Layout) (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "transport")
+    {
+        settings.transport = (Transport) (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "multicast_group")
+    {
+        const String group = parameter->getValueAsString().trim();
+
+        if (group.isNotEmpty() && ! isMulticastGroup (group))
+        {
+            LOGE ("Ephys Socket: ", group, " is not a multicast group, receiving unicast datagrams");
+            settings.multicast_group = String();
+            return;
+        }
+
+        settings.multicast_group = group;
+    }
+    else if (parameter->getName() == "drain_budget")
+    {
+        drain_budget = (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "gap_fill")
+    {
+        gap_fill = (GapFill) (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "ttl_rows")
+    {
+        settings.ttl_rows = (int) parameter->getValue();
+        CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new channel count
+    }
+    else if (parameter->getName() == "channel_map")
+    {
+        const String file = parameter->getValueAsString().trim();
+
+        if (file == settings.channel_map) // Selecting a stream sets the same value, which must keep any edited entries
+        {
+            return;
+        }
+
+        if (! loadChannelMap (settings, file))
+        {
+            CoreServices::sendStatusMessage ("Ephys Socket: Could not load the channel map.");
+            return;
+        }
+
+        CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new channel names and types
+    }
+    else if (parameter->getName() == "capture_file")
+    {
+        settings.capture_file = parameter->getValueAsString().trim();
+    }
+    else if (parameter->getName() == "replay_file")
+    {
+        settings.replay_file = parameter->getValueAsString().trim();
+    }
+    else if (parameter->getName() == "local_path")
+    {
+        settings.local_path = parameter->getValueAsString().trim();
+    }
+    else if (parameter->getName() == "host")
+    {
+        settings.host = parameter->getValueAsString().trim();
+    }
+    else if (parameter->getName() == "replay_pace")
+    {
+        settings.replay_pace = (ReplayPace) (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "ttl_bits")
+    {
+        settings.ttl_bits = (int) parameter->getValue();
+        CoreServices::updateSignalChain (sn); // Update the signal chain to reflect the new TTL lines
+    }
+    else if (parameter->getName() == "low_latency")
+    {
+        low_latency = (bool) parameter->getValue();
+    }
+    else if (parameter->getName() == "receive_buffer")
+    {
+        receive_buffer = (int) parameter->getValue();
+    }
+    else if (parameter->getName() == "cpu_affinity")
+    {
+        cpu_affinity = (int) parameter->getValue();
     }
 }
 
@@ -182,12 +690,15 @@ bool EphysSocket::startAcquisition()
 {
     resizeBuffers();
 
-    total_samples = 0;
-    eventState = 0;
+    lastPushNs = 0;
 
-    socket.startAcquisition();
+    for (auto stream : streams)
+    {
+        stream->reset();
+        stream->socket.startAcquisition();
+        stream->socket.startThread();
+    }
 
-    socket.startThread();
     startThread();
 
     return true;
@@ -200,78 +711,61 @@ bool EphysSocket::stopAcquisition()
         signalThreadShouldExit();
     }
 
-    socket.stopAcquisition();
+    for (int i = 0; i < streams.size(); i++)
+    {
+        streams[i]->socket.stopAcquisition();
+        sourceBuffers[i]->clear();
 
-    sourceBuffers[0]->clear();
-    return true;
-}
+        if (streams[i]->getNumGaps() > 0)
+        {
+            LOGC ("Ephys Socket stream ", i + 1, " lost ", streams[i]->getNumLostSamples(), " samples in ", streams[i]->getNumGaps(), " gaps (longest ", streams[i]->getLongestGap(), "), ", streams[i]->getNumFilledSamples(), " of them filled");
+        }
 
-template <typename T>
-void EphysSocket::convertData (std::vector<std::byte> buffer)
-{
-    T* buf = (T*) (buffer.data() + HEADER_SIZE);
+        const LatencyHistogram& latency = streams[i]->getLatency();
 
-    for (int i = 0; i < socket.num_samp * socket.num_channels; i++)
-    {
-        convbuf[i] = data_scale * ((float) (buf[i]) - data_offset);
+        if (latency.getCount() > 0)
+        {
+            LOGD ("Ephys Socket stream ", i + 1, " receive to buffer latency: mean ", latency.getMeanUs(), " us, p99 ", latency.getPercentileUs (0.99), " us, max ", latency.getMaxUs(), " us");
+        }
+
+        if (streams[i]->getNumTtlLines() > 0)
+        {
+            LOGD ("Ephys Socket stream ", i + 1, " decoded ", streams[i]->getNumTtlEdges(), " TTL changes on ", streams[i]->getNumTtlLines(), " lines");
+        }
     }
+
+    return true;
 }
 
 bool EphysSocket::updateBuffer()
 {
-    if (socket.isError())
+    if (errorFlag())
     {
         return false;
     }
 
-    if (socket.data.isEmpty())
+    int numPushed = 0;
+
+    for (int i = 0; i < streams.size(); i++)
     {
-        return true;
+        numPushed += streams[i]->pushPackets (sourceBuffers[i], drain_budget, gap_fill);
     }
 
-    std::vector<std::byte> data = socket.data.removeAndReturn (0);
+    const int64 now = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
 
-    if (socket.depth == U8)
-    {
-        convertData<uint8_t> (data);
-    }
-    else if (socket.depth == S8)
-    {
-        convertData<int8_t> (data);
-    }
-    else if (socket.depth == U16)
-    {
-        convertData<uint16_t> (data);
-    }
-    else if (socket.depth == S16)
+    if (numPushed > 0)
     {
-        convertData<int16_t> (data);
+        lastPushNs = now;
     }
-    else if (socket.depth == S32)
+    else if (low_latency && cpu_affinity >= 0 && now - lastPushNs < lowLatencySpinUs * 1000)
     {
-        convertData<int32_t> (data);
+        Thread::yield(); // Waking up from a wait can take longer than small packets take to arrive
     }
-    else if (socket.depth == F32)
+    else
     {
-        convertData<float_t> (data);
-    }
-    else if (socket.depth == F64)
-    {
-        convertData<double_t> (data);
+        packetsReady.wait (packetWaitMs);
     }
 
-    for (int i = 0; i < socket.num_samp; i++)
-    {
-        sampleNumbers.set (i, total_samples++);
-        ttlEventWords.set (i, eventState);
-    }
-
-    sourceBuffers[0]->addToBuffer (convbuf.data(),
-                                   sampleNumbers.getRawDataPointer(),
-                                   timestamps.getRawDataPointer(),
-                                   ttlEventWords.getRawDataPointer(),
-                                   socket.num_samp);
-
     return true;
 }
 
@@ -279,30 +773,123 @@ String EphysSocket::handleConfigMessage (const String& msg)
 {
     // Available commands:
     // ES INFO                      - Returns info on current variables that can be modified over HTTP
+    // ES STREAMS                   - Returns the number of streams and the port of each one
+    // ES ADD_STREAM                - Adds a stream on the next port and selects it
+    // ES REMOVE_STREAM             - Removes the selected stream
+    // ES SELECT <stream>           - Selects the stream (1-based) that SCALE/OFFSET/PORT/FREQUENCY/LAYOUT apply to
     // ES SCALE <data_scale>        - Updates the data scale to data_scale
     // ES OFFSET <data_offset>      - Updates the offset to data_offset
     // ES PORT <port>               - Updates the port number that EphysSocket connects to
     // ES FREQUENCY <sample_rate>   - Updates the sampling rate
-    // ES CONNECTION_STATE          - Returns the connection state (CONNECTED/DISCONNECTED)
-    // ES CONNECT                   - Connect the socket
+    // ES OUTPUT_RATE <rate>        - Decimates the stream to about rate Hz before the buffer, by a whole factor (OFF keeps the sample rate)
+    // ES LAYOUT <layout>           - Updates the matrix layout (CHANNEL_MAJOR/INTERLEAVED)
+    // ES TRANSPORT <transport>     - Updates the protocol (TCP/UDP, TCP_SERVER to accept the sender's connection, or UNIX/SHM for a sender on this machine), or replays a capture file (REPLAY)
+    // ES HOST <host>               - Updates the host connected to over TCP, or the interface a TCP server listens on; IPv4 or IPv6 (DEFAULT for localhost, or every interface)
+    // ES LOCAL_PATH <path>         - Updates the Unix socket path or shared-memory name of the UNIX/SHM transports (DEFAULT derives one from the port)
+    // ES MULTICAST <group>         - Updates the multicast group joined in UDP mode (NONE for unicast)
+    // ES BUDGET <packets>          - Updates the maximum packets pushed per update (0 = all queued packets)
+    // ES GAP_FILL <fill>           - Updates what is pushed in place of lost samples (OFF/ZERO/HOLD/NAN)
+    // ES TTL_ROWS <rows>           - Updates the number of rows at the end of each matrix decoded as TTL lines (0 = none)
+    // ES TTL_BITS <bits>           - Updates the TTL lines per digital row (0 = element width)
+    // ES CAPTURE <file>            - Captures the raw bytes received by the selected stream to a file (NONE to stop)
+    // ES CAPTURE                   - Returns what the selected stream has captured
+    // ES REPLAY <file>             - Updates the capture file replayed when the transport is REPLAY
+    // ES REPLAY_PACE <pace>        - Replays captures as they were recorded or as fast as possible (RECORDED/FAST)
+    // ES CHANNEL_MAP <file>        - Loads the channel map of the selected stream from a file (NONE to clear it)
+    // ES CHANNEL_MAP               - Returns the channel map of the selected stream
+    // ES CHANNEL <n> <name> <type> <scale> <offset>
+    //                              - Sets the name, type (ELECTRODE/AUX/ADC), scale and offset of channel n (1-based)
+    // ES LOW_LATENCY <mode>        - Receives at real-time priority without delayed TCP acknowledgements, polling if a CPU is set (ON/OFF)
+    // ES RECEIVE_BUFFER <kB>       - Updates the kernel receive buffer of every socket (0 = OS default)
+    // ES CPU <cpu>                 - Keeps the first stream's socket thread on a CPU, the next stream on the next one (NONE for any)
+    // ES QUEUE                     - Returns the number of received packets waiting to be pushed
+    // ES LATENCY                   - Returns the time from receiving packets to pushing them to the buffer on the selected stream
+    // ES STATS                     - Returns the receive rates, queue, conversion time, jitter, stalls, reconnects, header mismatches and compression of the selected stream
+    // ES GAPS                      - Returns the samples lost on the selected stream and the gaps they left
+    // ES SEQUENCE                  - Returns the lost, duplicate and late packets and the one-way latency of the selected stream (extended headers only)
+    // ES CLOCK                     - Returns the sample rate recovered from packet arrivals on the selected stream
+    // ES CONNECTION_STATE          - Returns the connection state (CONNECTED/CONNECTING/DISCONNECTED)
+    // ES CONNECT                   - Starts connecting the socket in the background; poll the connection state until CONNECTED
     // ES DISCCONNECT               - Disconnect the socket
 
+    StringArray parts = StringArray::fromTokens (msg, " ", "");
+
+    if (parts.size() == 2 && parts[0].equalsIgnoreCase ("ES") && parts[1].equalsIgnoreCase ("QUEUE"))
+    {
+        return String (getQueueDepth());
+    }
+
+    if (parts.size() == 2 && parts[0].equalsIgnoreCase ("ES") && parts[1].equalsIgnoreCase ("LATENCY"))
+    {
+        const LatencyHistogram& latency = streams[selectedStream]->getLatency();
+
+        return "Receive to buffer latency = " + String (latency.getMeanUs(), 1) + " us mean, " + String (latency.getPercentileUs (0.5), 0) + " us median, " + String (latency.getPercentileUs (0.99), 0) + " us p99, " + String (latency.getMaxUs(), 0) + " us max, over " + String (latency.getCount()) + " packets.";
+    }
+
+    if (parts.size() == 2 && parts[0].equalsIgnoreCase ("ES") && parts[1].equalsIgnoreCase ("STATS"))
+    {
+        const SocketThread& socket = streams[selectedStream]->socket;
+        const StreamStats& stats = socket.stats;
+        const LatencyHistogram& jitter = stats.getJitter();
+        const PacketAssembler& assembler = socket.getAssembler();
+        const int64 compressedBytes = assembler.getNumCompressedBytes();
+
+        const int64 nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+        const StreamStats::Snapshot now = stats.getSnapshot (nowNs);
+        const StreamStats::Snapshot& start = stats.getStart();
+
+        return "Received = " + String (now.getBytesPerSecond (start) / 1e6, 2) + " MB/s, " + String (now.getPacketsPerSecond (start), 1) + " packets/s, " + String (now.packets > 0 ? (double) now.reads / now.packets : 0.0, 2) + " reads per packet. Queue = " + String (socket.packets.getNumReady()) + " (max " + String (stats.getMaxQueueDepth()) + " of " + String (socket.getNumQueueSlots()) + "), " + String (stats.getNumQueueFull()) + " dropped when full. Conversion = " + String (stats.getMeanConversionUs(), 2) + " us per packet (max " + String (stats.getMaxConversionUs(), 2) + " us). Jitter = " + String (jitter.getPercentileUs (0.5), 0) + " us median, " + String (jitter.getPercentileUs (0.99), 0) + " us p99, " + String (jitter.getMaxUs(), 0) + " us max. Wake-up latency = " + String (socket.getMeanWakeLatencyUs(), 1) + " us (max " + String (socket.getMaxWakeLatencyUs()) + " us). Stalls = " + String (stats.getNumStalls()) + ". Reconnects = " + String (stats.getNumReconnects()) + ". Header mismatches = " + String (stats.getNumHeaderMismatches()) + ". Compressed = " + String (assembler.getNumDecompressed()) + " matrices" + (compressedBytes > 0 ? ", at " + String (100.0 * compressedBytes / ((double) assembler.getNumDecompressed() * socket.num_channels * socket.num_samp * socket.element_size), 1) + "% of raw." : String ("."));
+    }
+
+    if (parts.size() == 2 && parts[0].equalsIgnoreCase ("ES") && parts[1].equalsIgnoreCase ("GAPS"))
+    {
+        const SocketStream* stream = streams[selectedStream];
+
+        return "Lost samples = " + String (stream->getNumLostSamples()) + " in " + String (stream->getNumGaps()) + " gaps. Longest gap = " + String (stream->getLongestGap()) + " samples. Filled = " + String (stream->getNumFilledSamples()) + " samples.";
+    }
+
+    if (parts.size() == 2 && parts[0].equalsIgnoreCase ("ES") && parts[1].equalsIgnoreCase ("SEQUENCE"))
+    {
+        const SocketThread& socket = streams[selectedStream]->socket;
+
+        if (socket.header_size <= HEADER_SIZE)
+        {
+            return "Stream has no extended header.";
+        }
+
+        const SequenceTracker& sequence = socket.getSequence();
+
+        return "Lost samples = " + String (sequence.getNumLostSamples()) + " in " + String (sequence.getNumGaps()) + " gaps. Duplicates = " + String (sequence.getNumDuplicates()) + ". Late = " + String (sequence.getNumLate()) + ". Resyncs = " + String (sequence.getNumResyncs()) + ". Checksum errors = " + String (socket.getAssembler().getNumChecksumErrors()) + ". One-way latency = " + String (socket.getMeanOneWayLatencyUs(), 1) + " us (max " + String (socket.getMaxOneWayLatencyUs()) + " us).";
+    }
+
     if (CoreServices::getAcquisitionStatus())
     {
         return "Ephys Socket plugin cannot update settings while acquisition is active.";
     }
 
-    StringArray parts = StringArray::fromTokens (msg, " ", "");
-
     if (parts.size() > 0)
     {
         if (parts[0].equalsIgnoreCase ("ES"))
         {
             if (parts.size() == 3)
             {
-                if (socket.isConnected())
+                if (isSocketBusy())
                 {
-                    return "Ephys Socket plugin cannot update settings while connected to an active socket.";
+                    return "Ephys Socket plugin cannot update settings while a socket is connecting or connected.";
+                }
+
+                if (parts[1].equalsIgnoreCase ("SELECT"))
+                {
+                    int stream = parts[2].getIntValue();
+
+                    if (stream >= 1 && stream <= streams.size())
+                    {
+                        selectStream (stream - 1);
+                        LOGC ("Selected stream: ", stream);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid stream requested. Stream can be set between '1' and '" + String (streams.size()) + "'";
                 }
 
                 if (parts[1].equalsIgnoreCase ("SCALE"))
@@ -344,6 +931,168 @@ String EphysSocket::handleConfigMessage (const String& msg)
 
                     return "Invalid port requested. Port can be set between '" + String (MIN_PORT) + "' and '" + String (MAX_PORT) + "'";
                 }
+                else if (parts[1].equalsIgnoreCase ("LAYOUT"))
+                {
+                    if (parts[2].equalsIgnoreCase ("CHANNEL_MAJOR") || parts[2].equalsIgnoreCase ("INTERLEAVED"))
+                    {
+                        getParameter ("layout")->setNextValue (parts[2].equalsIgnoreCase ("INTERLEAVED") ? INTERLEAVED : CHANNEL_MAJOR);
+                        LOGC ("Layout updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid layout requested. Layout can be set to 'CHANNEL_MAJOR' or 'INTERLEAVED'";
+                }
+                else if (parts[1].equalsIgnoreCase ("TRANSPORT"))
+                {
+                    const StringArray transports { "TCP", "UDP", "REPLAY", "UNIX", "SHM", "TCP_SERVER" };
+                    const int transport = transports.indexOf (parts[2], true);
+
+                    if (transport >= 0)
+                    {
+                        getParameter ("transport")->setNextValue (transport);
+                        LOGC ("Transport updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid transport requested. Transport can be set to 'TCP', 'UDP', 'REPLAY', 'UNIX', 'SHM' or 'TCP_SERVER'";
+                }
+                else if (parts[1].equalsIgnoreCase ("HOST"))
+                {
+                    getParameter ("host")->setNextValue (parts[2].equalsIgnoreCase ("DEFAULT") ? String() : parts[2]);
+
+                    const StreamSettings& settings = streams[selectedStream]->settings;
+                    LOGC ("Host updated to: ", settings.getHost().isEmpty() ? "every interface" : settings.getHost());
+                    return "SUCCESS";
+                }
+                else if (parts[1].equalsIgnoreCase ("LOCAL_PATH"))
+                {
+                    getParameter ("local_path")->setNextValue (parts[2].equalsIgnoreCase ("DEFAULT") ? String() : parts[2]);
+                    LOGC ("Local path updated to: ", streams[selectedStream]->settings.getLocalPath());
+                    return "SUCCESS";
+                }
+                else if (parts[1].equalsIgnoreCase ("MULTICAST"))
+                {
+                    if (parts[2].equalsIgnoreCase ("NONE") || isMulticastGroup (parts[2]))
+                    {
+                        getParameter ("multicast_group")->setNextValue (parts[2].equalsIgnoreCase ("NONE") ? String() : parts[2]);
+                        LOGC ("Multicast group updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid multicast group requested. Group must be an address between '224.0.0.0' and '239.255.255.255', or 'NONE'";
+                }
+                else if (parts[1].equalsIgnoreCase ("BUDGET"))
+                {
+                    int budget = parts[2].getIntValue();
+
+                    if (budget >= MIN_DRAIN_BUDGET && budget <= MAX_DRAIN_BUDGET)
+                    {
+                        getParameter ("drain_budget")->setNextValue (budget);
+                        LOGC ("Drain budget updated to: ", budget);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid budget requested. Budget can be set between '" + String (MIN_DRAIN_BUDGET) + "' and '" + String (MAX_DRAIN_BUDGET) + "'";
+                }
+                else if (parts[1].equalsIgnoreCase ("LOW_LATENCY"))
+                {
+                    if (parts[2].equalsIgnoreCase ("ON") || parts[2].equalsIgnoreCase ("OFF"))
+                    {
+                        getParameter ("low_latency")->setNextValue (parts[2].equalsIgnoreCase ("ON"));
+                        LOGC ("Low latency updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid low latency mode requested. Mode can be set to 'ON' or 'OFF'";
+                }
+                else if (parts[1].equalsIgnoreCase ("RECEIVE_BUFFER"))
+                {
+                    const int size = parts[2].getIntValue();
+
+                    if (parts[2].containsOnly ("0123456789") && size >= 0 && size <= MAX_RECEIVE_BUFFER)
+                    {
+                        getParameter ("receive_buffer")->setNextValue (size);
+                        LOGC ("Receive buffer updated to: ", size, " kB");
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid receive buffer requested. Size can be set between '0' and '" + String (MAX_RECEIVE_BUFFER) + "' kB";
+                }
+                else if (parts[1].equalsIgnoreCase ("CPU"))
+                {
+                    const int cpu = parts[2].equalsIgnoreCase ("NONE") ? -1 : parts[2].getIntValue();
+
+                    if ((cpu == -1 || parts[2].containsOnly ("0123456789")) && cpu <= MAX_CPU_AFFINITY)
+                    {
+                        getParameter ("cpu_affinity")->setNextValue (cpu);
+                        LOGC ("CPU affinity updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid CPU requested. CPU can be set between '0' and '" + String (MAX_CPU_AFFINITY) + "', or 'NONE'";
+                }
+                else if (parts[1].equalsIgnoreCase ("GAP_FILL"))
+                {
+                    const StringArray fills { "OFF", "ZERO", "HOLD", "NAN" };
+                    const int fill = fills.indexOf (parts[2], true);
+
+                    if (fill >= 0)
+                    {
+                        getParameter ("gap_fill")->setNextValue (fill);
+                        LOGC ("Gap fill updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid gap fill requested. Gap fill can be set to 'OFF', 'ZERO', 'HOLD' or 'NAN'";
+                }
+                else if (parts[1].equalsIgnoreCase ("TTL_ROWS") || parts[1].equalsIgnoreCase ("TTL_BITS"))
+                {
+                    const bool rows = parts[1].equalsIgnoreCase ("TTL_ROWS");
+                    const int value = parts[2].getIntValue();
+                    const int maxValue = rows ? MAX_TTL_ROWS : MAX_TTL_BITS;
+
+                    if (parts[2].containsOnly ("0123456789") && value >= 0 && value <= maxValue)
+                    {
+                        getParameter (rows ? "ttl_rows" : "ttl_bits")->setNextValue (value);
+                        LOGC (rows ? "TTL rows updated to: " : "TTL bits updated to: ", value);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid " + String (rows ? "TTL rows" : "TTL bits") + " requested. Value can be set between '0' and '" + String (maxValue) + "'";
+                }
+                else if (parts[1].equalsIgnoreCase ("CAPTURE") || parts[1].equalsIgnoreCase ("REPLAY"))
+                {
+                    const bool capture = parts[1].equalsIgnoreCase ("CAPTURE");
+                    const String file = capture && parts[2].equalsIgnoreCase ("NONE") ? String() : parts[2];
+
+                    getParameter (capture ? "capture_file" : "replay_file")->setNextValue (file);
+                    LOGC (capture ? "Capture file updated to: " : "Replay file updated to: ", file);
+                    return "SUCCESS";
+                }
+                else if (parts[1].equalsIgnoreCase ("REPLAY_PACE"))
+                {
+                    if (parts[2].equalsIgnoreCase ("RECORDED") || parts[2].equalsIgnoreCase ("FAST"))
+                    {
+                        getParameter ("replay_pace")->setNextValue (parts[2].equalsIgnoreCase ("FAST") ? FAST_PACE : RECORDED_PACE);
+                        LOGC ("Replay pace updated to: ", parts[2]);
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid replay pace requested. Pace can be set to 'RECORDED' or 'FAST'";
+                }
+                else if (parts[1].equalsIgnoreCase ("CHANNEL_MAP"))
+                {
+                    const String file = parts[2].equalsIgnoreCase ("NONE") ? String() : parts[2];
+
+                    if (! loadChannelMap (streams[selectedStream]->settings, file))
+                    {
+                        return "Could not load channel map " + file + ". See the console for details.";
+                    }
+
+                    getParameter ("channel_map")->setNextValue (file);
+                    CoreServices::updateSignalChain (sn);
+                    return "SUCCESS";
+                }
                 else if (parts[1].equalsIgnoreCase ("FREQUENCY"))
                 {
                     float frequency = parts[2].getFloatValue();
@@ -351,33 +1100,145 @@ String EphysSocket::handleConfigMessage (const String& msg)
                     if (frequency > MIN_SAMPLE_RATE && frequency < MAX_SAMPLE_RATE)
                     {
                         getParameter ("sample_rate")->setNextValue (frequency);
-                        LOGC ("Frequency updated to: ", sample_rate);
+                        LOGC ("Frequency updated to: ", frequency);
                         return "SUCCESS";
                     }
 
                     return "Invalid frequency requested. Frequency can be set between '" + String (MIN_SAMPLE_RATE) + "' and '" + String (MAX_SAMPLE_RATE) + "'";
                 }
+                else if (parts[1].equalsIgnoreCase ("OUTPUT_RATE"))
+                {
+                    const float rate = parts[2].equalsIgnoreCase ("OFF") ? 0.0f : parts[2].getFloatValue();
+
+                    if (rate >= 0.0f && rate < MAX_SAMPLE_RATE)
+                    {
+                        getParameter ("output_rate")->setNextValue (rate);
+
+                        const StreamSettings& settings = streams[selectedStream]->settings;
+                        LOGC ("Output rate updated to: ", settings.getOutputSampleRate(), " Hz (", settings.sample_rate, " Hz decimated by ", settings.getDecimation(), ")");
+                        return "SUCCESS";
+                    }
+
+                    return "Invalid output rate requested. Rate can be set between '0' and '" + String (MAX_SAMPLE_RATE) + "', or OFF";
+                }
                 else
                 {
                     return "ES command " + parts[1] + "not recognized.";
                 }
             }
+            else if (parts.size() == 7 && parts[1].equalsIgnoreCase ("CHANNEL"))
+            {
+                if (isSocketBusy())
+                {
+                    return "Ephys Socket plugin cannot update settings while a socket is connecting or connected.";
+                }
+
+                const int channel = parts[2].getIntValue();
+                ChannelInfo info;
+
+                if (channel < 1 || ! parts[2].containsOnly ("0123456789"))
+                {
+                    return "Invalid channel requested. Channels are numbered from '1'";
+                }
+
+                if (! ChannelMap::parseType (parts[4].toStdString(), info.type))
+                {
+                    return "Invalid channel type requested. Type can be set to 'ELECTRODE', 'AUX' or 'ADC'";
+                }
+
+                info.name = parts[3].toStdString();
+                info.scale = parts[5].getFloatValue();
+                info.offset = parts[6].getFloatValue();
+
+                streams[selectedStream]->settings.channels.set (channel - 1, info);
+                CoreServices::updateSignalChain (sn);
+                LOGC ("Channel ", channel, " updated to: ", parts[3], " ", parts[4], " ", info.scale, " ", info.offset);
+                return "SUCCESS";
+            }
             else if (parts.size() == 2)
             {
                 if (parts[1].equalsIgnoreCase ("INFO"))
                 {
-                    return "Port = " + String (port) + ". Sample rate = " + String (sample_rate) + "Scale = " + String (data_scale) + ". Offset = " + String (data_offset) + ".";
+                    const StreamSettings& settings = streams[selectedStream]->settings;
+
+                    return "Stream = " + String (selectedStream + 1) + " of " + String (streams.size()) + ". Port = " + String (settings.port) + ". Sample rate = " + String (settings.sample_rate) + ". Output rate = " + String (settings.getOutputSampleRate()) + (settings.getDecimation() > 1 ? " (decimated by " + String (settings.getDecimation()) + ")" : String()) + ". Scale = " + String (settings.data_scale) + ". Offset = " + String (settings.data_offset) + ". Layout = " + String (settings.layout == INTERLEAVED ? "INTERLEAVED" : "CHANNEL_MAJOR") + ". Transport = " + StringArray { "TCP", "UDP", "REPLAY", "UNIX", "SHM", "TCP_SERVER" }[settings.transport] + (settings.transport == TCP || settings.transport == TCP_SERVER ? " (" + (settings.getHost().isEmpty() ? "every interface" : settings.getHost()) + ")" : settings.transport == REPLAY ? " (" + settings.replay_file + (settings.replay_pace == FAST_PACE ? ", fast)" : ", recorded pace)") : settings.transport == UNIX_SOCKET || settings.transport == SHARED_MEMORY ? " (" + settings.getLocalPath() + ")" : settings.multicast_group.isEmpty() ? String() : " (" + settings.multicast_group + ")") + ". Drain budget = " + String (drain_budget) + ". Gap fill = " + StringArray { "OFF", "ZERO", "HOLD", "NAN" }[gap_fill] + ". TTL rows = " + String (settings.ttl_rows) + ". TTL bits = " + String (settings.ttl_bits) + ". Mapped channels = " + String ((int) settings.channels.getEntries().size()) + ". Low latency = " + String (low_latency ? "ON" : "OFF") + ". Receive buffer = " + String (receive_buffer) + " kB. CPU = " + (cpu_affinity >= 0 ? String (cpu_affinity) : "NONE") + ".";
+                }
+                else if (parts[1].equalsIgnoreCase ("STREAMS"))
+                {
+                    String ports;
+
+                    for (auto stream : streams)
+                        ports += (ports.isEmpty() ? "" : ", ") + String (stream->settings.port);
+
+                    return String (streams.size()) + " stream(s) on port(s) " + ports + ".";
+                }
+                else if (parts[1].equalsIgnoreCase ("ADD_STREAM") || parts[1].equalsIgnoreCase ("REMOVE_STREAM"))
+                {
+                    if (isSocketBusy())
+                    {
+                        return "Ephys Socket plugin cannot update settings while a socket is connecting or connected.";
+                    }
+
+                    const bool add = parts[1].equalsIgnoreCase ("ADD_STREAM");
+
+                    if (! (add ? addStream() : removeStream()))
+                    {
+                        return add ? "Cannot add more than " + String (MAX_STREAMS) + " streams." : "Cannot remove the last stream.";
+                    }
+
+                    if (sn->getEditor() != nullptr) // check if headless
+                    {
+                        static_cast<EphysSocketEditor*> (sn->getEditor())->updateStreamSelector();
+                        CoreServices::updateSignalChain (sn->getEditor());
+                    }
+
+                    LOGC (add ? "Stream added" : "Stream removed");
+                    return "SUCCESS";
+                }
+                else if (parts[1].equalsIgnoreCase ("CAPTURE"))
+                {
+                    const SocketStream* stream = streams[selectedStream];
+                    const CaptureWriter& capture = stream->socket.getCapture();
+
+                    if (! capture.isOpen())
+                    {
+                        return stream->settings.capture_file.isEmpty() ? "No capture file." : "Capturing to " + stream->settings.capture_file + " once connected.";
+                    }
+
+                    return "Captured " + String (capture.getNumRecords()) + " reads (" + String (capture.getNumBytes()) + " bytes) to " + stream->settings.capture_file + ". Dropped = " + String (capture.getNumDropped()) + ".";
+                }
+                else if (parts[1].equalsIgnoreCase ("CHANNEL_MAP"))
+                {
+                    const StreamSettings& settings = streams[selectedStream]->settings;
+
+                    return settings.channels.isEmpty() ? "No channel map." : String (settings.channels.toText());
+                }
+                else if (parts[1].equalsIgnoreCase ("CLOCK"))
+                {
+                    const SocketThread& socket = streams[selectedStream]->socket;
+
+                    if (! socket.isClockLocked())
+                    {
+                        return "Clock not locked yet.";
+                    }
+
+                    return "Recovered sample rate = " + String (socket.getEstimatedSampleRate(), 3) + " Hz. Drift = " + String (socket.getClockDriftPpm(), 1) + " ppm.";
                 }
                 else if (parts[1].equalsIgnoreCase ("CONNECTION_STATUS"))
                 {
-                    return socket.isConnected() ? CONNECTION_STATE_CONNECTED : CONNECTION_STATE_DISCONNECTED;
+                    return getConnectionState();
                 }
                 else if (parts[1].equalsIgnoreCase ("CONNECT"))
                 {
                     LOGC ("Request socket connect");
-                    const auto connected = connectSocket();
-                    LOGC (connected ? "Connection success" : "Connection failed");
-                    return connected ? CONNECTION_STATE_CONNECTED : CONNECTION_STATE_DISCONNECTED;
+
+                    if (streams[0]->socket.getConnectionState() == DISCONNECTED && ! connectSocket())
+                    {
+                        LOGC ("Connection failed");
+                        return CONNECTION_STATE_DISCONNECTED;
+                    }
+
+                    return getConnectionState();
                 }
                 else if (parts[1].equalsIgnoreCase ("DISCONNECT"))
                 {
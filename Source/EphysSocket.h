@@ -3,16 +3,20 @@
 
 #include <DataThreadHeaders.h>
 
+#include "DataConverter.h"
 #include "EphysSocketHeader.h"
+#include "SocketStream.h"
 #include "SocketThread.h"
 
 namespace EphysSocketNode
 {
-class EphysSocket : public DataThread
+class EphysSocket : public DataThread,
+                    private AsyncUpdater
 {
 public:
     /** Connection states */
     static const constexpr char* CONNECTION_STATE_CONNECTED { "CONNECTED" };
+    static const constexpr char* CONNECTION_STATE_CONNECTING { "CONNECTING" };
     static const constexpr char* CONNECTION_STATE_DISCONNECTED { "DISCONNECTED" };
 
     /** Default parameters */
@@ -20,6 +24,17 @@ public:
     static constexpr float DEFAULT_SAMPLE_RATE { 30000.0f };
     static constexpr float DEFAULT_DATA_SCALE { 1.0f }; // 0.195f for Intan devices
     static constexpr float DEFAULT_DATA_OFFSET { 0.0f }; // 32768.0f for Intan devices
+    static constexpr int DEFAULT_DRAIN_BUDGET { 0 }; // 0 drains every queued packet
+    static constexpr Layout DEFAULT_LAYOUT { CHANNEL_MAJOR };
+    static constexpr Transport DEFAULT_TRANSPORT { TCP };
+    static constexpr GapFill DEFAULT_GAP_FILL { NO_FILL };
+    static constexpr int DEFAULT_TTL_ROWS { 0 };
+    static constexpr int DEFAULT_TTL_BITS { 0 }; // 0 uses the element width
+    static constexpr ReplayPace DEFAULT_REPLAY_PACE { RECORDED_PACE };
+    static constexpr bool DEFAULT_LOW_LATENCY { false };
+    static constexpr int DEFAULT_RECEIVE_BUFFER { 0 }; // 0 keeps the OS default
+    static constexpr int DEFAULT_CPU_AFFINITY { -1 }; // -1 lets the OS schedule the socket threads
+    static constexpr float DEFAULT_OUTPUT_RATE { 0.0f }; // 0 pushes samples at the stream's sample rate
 
     /** Parameter limits */
     static constexpr float MIN_DATA_SCALE { 0.0f };
@@ -29,7 +44,14 @@ public:
     static constexpr float MIN_PORT { 1023 };
     static constexpr float MAX_PORT { 65535 };
     static constexpr float MIN_SAMPLE_RATE { 0 };
-    static constexpr float MAX_SAMPLE_RATE { 50000.0f };
+    static constexpr float MAX_SAMPLE_RATE { 1000000.0f };
+    static constexpr int MIN_DRAIN_BUDGET { 0 };
+    static constexpr int MAX_DRAIN_BUDGET { 1024 };
+    static constexpr int MAX_STREAMS { 16 };
+    static constexpr int MAX_TTL_ROWS { 64 };
+    static constexpr int MAX_TTL_BITS { 64 };
+    static constexpr int MAX_RECEIVE_BUFFER { 65536 }; // kB
+    static constexpr int MAX_CPU_AFFINITY { 255 };
 
     /** Constructor */
     EphysSocket (SourceNode* sn);
@@ -49,7 +71,7 @@ public:
     /** Returns true if socket is connected */
     bool foundInputSource() override;
 
-    /** Sets info about available channels */
+    /** Sets info about available channels, with one DataStream per network stream */
     void updateSettings (OwnedArray<ContinuousChannel>* continuousChannels,
                          OwnedArray<EventChannel>* eventChannels,
                          OwnedArray<SpikeChannel>* spikeChannels,
@@ -63,23 +85,75 @@ public:
     /** Resizes buffers when input parameters are changed*/
     void resizeBuffers() override;
 
-    /** Disconnects the socket */
+    /** Saves the settings of every stream */
+    void saveCustomParametersToXml (XmlElement* xml) override;
+
+    /** Loads the settings of every stream */
+    void loadCustomParametersFromXml (XmlElement* xml) override;
+
+    /** Disconnects all sockets */
     void disconnectSocket();
 
-    /** Attempts to connect to the socket */
-    bool connectSocket (bool printOutput = true);
+    /** Starts connecting every stream's socket in the background; fails if any of them cannot start.
+        The editor is told once they are all connected, or that connecting failed. */
+    bool connectSocket();
+
+    /** Called by a socket thread when its connection state changes; handled on the message thread */
+    void connectionStateChanged();
+
+    /** Describes the first stream that is not connected, e.g. how often it has retried, or returns an empty string */
+    String getConnectionStatus() const;
+
+    /** Adds a network stream with default settings and selects it */
+    bool addStream();
+
+    /** Removes the selected network stream; the last remaining stream cannot be removed */
+    bool removeStream();
+
+    /** Selects the stream that the stream parameters apply to */
+    void selectStream (int index);
+
+    /** Returns the number of network streams */
+    int getNumStreams() const;
+
+    /** Returns the index of the stream that the stream parameters apply to */
+    int getSelectedStream() const;
 
     /** Returns if any errors were thrown during acquisition, such as invalid headers or unable to read from socket */
     bool errorFlag();
 
-    /** Network stream parameters (must match features of incoming data) */
-    int port;
-    float sample_rate;
-    float data_scale;
-    float data_offset;
+    /** Returns the number of received packets waiting to be pushed to the DataBuffers */
+    int getQueueDepth() const;
+
+    /** Returns the receive and conversion counters of a stream during the current acquisition */
+    const StreamStats& getStreamStats (int index) const;
+
+    /** Maximum packets pushed per stream and update (0 = all queued packets) */
+    int drain_budget;
+
+    /** What every stream pushes in place of lost samples */
+    GapFill gap_fill;
+
+    /** Whether the socket threads run at real-time priority and send TCP acknowledgements right away.
+        With a CPU set, they and the DataThread also poll for packets before sleeping. Applied when connecting. */
+    bool low_latency;
+
+    /** Kernel receive buffer of every socket in kB (0 = OS default). Applied when connecting. */
+    int receive_buffer;
+
+    /** CPU the first stream's socket thread is kept on, the next stream on the next CPU, and so on
+        (-1 = any CPU). Applied when connecting. */
+    int cpu_affinity;
 
 private:
-    const int bufferSizeInSeconds = 10;
+    /** How long updateBuffer sleeps waiting for packets before returning to the DataThread loop */
+    const int packetWaitMs = 10;
+
+    /** How long after the last packet updateBuffer keeps polling instead of sleeping, in low-latency mode with a CPU set */
+    const int lowLatencySpinUs = 500;
+
+    /** When updateBuffer last pushed a packet, on the steady clock in ns */
+    int64 lastPushNs;
 
     /** Receives data from network and pushes it to the DataBuffer */
     bool updateBuffer() override;
@@ -95,23 +169,36 @@ private:
     /** Handles incoming HTTP messages */
     String handleConfigMessage (const String& msg) override;
 
-    /** Template function to convert data */
-    template <typename T>
-    void convertData (std::vector<std::byte> buffer);
+    /** Returns CONNECTION_STATE_CONNECTED once every stream is connected, CONNECTION_STATE_CONNECTING while they connect */
+    String getConnectionState();
+
+    /** Returns true while any stream is connecting or connected, or its thread hasn't exited yet */
+    bool isSocketBusy();
+
+    /** Returns true if address is an IPv4 multicast group (224.0.0.0 to 239.255.255.255) */
+    static bool isMulticastGroup (const String& address);
+
+    /** Replaces a stream's channel map with the one in file (none if empty). Returns false,
+        leaving the map unchanged, if the file can't be read or parsed. */
+    bool loadChannelMap (StreamSettings& settings, const String& file);
+
+    /** Enables or disables the parameters that must match the incoming data */
+    void setStreamParametersEnabled (bool enabled);
 
-    /** Sample index counter */
-    int64 total_samples;
+    /** Finishes connecting once every stream is connected, disconnects them all if one failed, and updates the editor */
+    void handleAsyncUpdate() override;
 
-    /** Local event state variable */
-    uint64 eventState;
+    /** Whether the signal chain has been updated with the headers of the current connection */
+    bool streamsConnected;
 
-    SocketThread socket;
+    /** Signalled by any socket thread when it queues a packet (declared first so it outlives the streams) */
+    WaitableEvent packetsReady;
 
-    std::vector<float> convbuf;
+    /** Network streams, each feeding the source buffer with the same index */
+    OwnedArray<SocketStream> streams;
 
-    Array<int64> sampleNumbers;
-    Array<double> timestamps;
-    Array<uint64> ttlEventWords;
+    /** Stream that the port, sample rate, scale, offset, layout, transport, local path, TTL, channel map, capture and replay parameters apply to */
+    int selectedStream;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EphysSocket);
 };
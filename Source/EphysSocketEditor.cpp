@@ -1,6 +1,7 @@
 #include "EphysSocketEditor.h"
 #include "EphysSocket.h"
 
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -10,7 +11,7 @@ EphysSocketEditor::EphysSocketEditor (GenericProcessor* parentNode, EphysSocket*
 {
     node = socket;
 
-    desiredWidth = 180;
+    desiredWidth = 865;
 
     // Add connect button
     connectButton = std::make_unique<UtilityButton> (stringConnect);
@@ -28,26 +29,85 @@ EphysSocketEditor::EphysSocketEditor (GenericProcessor* parentNode, EphysSocket*
     addAndMakeVisible (disconnectButton.get());
     disconnectButton->setVisible (false);
 
+    // Add stream selector
+    streamSelector = std::make_unique<ComboBox> ("Stream");
+    streamSelector->setBounds (95, 35, 75, 20);
+    streamSelector->addListener (this);
+    addAndMakeVisible (streamSelector.get());
+
+    addStreamButton = std::make_unique<UtilityButton> ("+");
+    addStreamButton->setFont (FontOptions ("Small Text", 12, Font::bold));
+    addStreamButton->setRadius (3.0f);
+    addStreamButton->setBounds (175, 35, 20, 20);
+    addStreamButton->addListener (this);
+    addAndMakeVisible (addStreamButton.get());
+
+    removeStreamButton = std::make_unique<UtilityButton> ("-");
+    removeStreamButton->setFont (FontOptions ("Small Text", 12, Font::bold));
+    removeStreamButton->setRadius (3.0f);
+    removeStreamButton->setBounds (200, 35, 20, 20);
+    removeStreamButton->addListener (this);
+    addAndMakeVisible (removeStreamButton.get());
+
+    statsLabel = std::make_unique<Label> ("Stats", "");
+    statsLabel->setFont (FontOptions ("Small Text", 11, Font::plain));
+    statsLabel->setBounds (230, 35, 540, 20);
+    addAndMakeVisible (statsLabel.get());
+
     addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "port", 10, 60);
     addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "sample_rate", 10, 95);
     addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "data_scale", 95, 60);
     addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "data_offset", 95, 95);
+    addComboBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "layout", 180, 60);
+    addComboBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "transport", 180, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "multicast_group", 265, 60);
+    addComboBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "gap_fill", 265, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "ttl_rows", 350, 60);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "ttl_bits", 350, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "channel_map", 435, 60);
+    addComboBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "replay_pace", 435, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "capture_file", 520, 60);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "replay_file", 520, 95);
+    addToggleParameterEditor (Parameter::PROCESSOR_SCOPE, "low_latency", 605, 60);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "cpu_affinity", 605, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "local_path", 690, 60);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "output_rate", 690, 95);
+    addTextBoxParameterEditor (Parameter::PROCESSOR_SCOPE, "host", 775, 60);
 
     for (auto& ed : parameterEditors)
     {
         ed->setLayout (ParameterEditor::Layout::nameOnTop);
         ed->setBounds (ed->getX(), ed->getY(), 80, 30);
     }
+
+    updateStreamSelector();
+}
+
+void EphysSocketEditor::updateStreamSelector()
+{
+    streamSelector->clear (dontSendNotification);
+
+    for (int i = 0; i < node->getNumStreams(); i++)
+    {
+        streamSelector->addItem ("Stream " + String (i + 1), i + 1);
+    }
+
+    streamSelector->setSelectedId (node->getSelectedStream() + 1, dontSendNotification);
 }
 
 void EphysSocketEditor::startAcquisition()
 {
     disconnectButton->setEnabled (false);
     disconnectButton->setAlpha (0.2f);
+
+    lastSnapshotStream = -1;
+    startTimer (statsIntervalMs);
 }
 
 void EphysSocketEditor::stopAcquisition()
 {
+    stopTimer();
+
     if (node->errorFlag())
     {
         node->disconnectSocket();
@@ -57,28 +117,109 @@ void EphysSocketEditor::stopAcquisition()
     disconnectButton->setAlpha (1.0f);
 }
 
+void EphysSocketEditor::timerCallback()
+{
+    const int stream = node->getSelectedStream();
+    const StreamStats& stats = node->getStreamStats (stream);
+
+    const int64 nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+    const StreamStats::Snapshot now = stats.getSnapshot (nowNs);
+
+    const StreamStats::Snapshot& since = stream == lastSnapshotStream ? lastSnapshot : stats.getStart();
+
+    String text = String (now.getBytesPerSecond (since) / 1e6, 2) + " MB/s, " + String (now.getPacketsPerSecond (since), 0) + " packets/s, " + String (now.getReadsPerSecond (since), 0) + " reads/s, queue max " + String (stats.getMaxQueueDepth()) + ", convert " + String (stats.getMeanConversionUs(), 2) + " us/packet, jitter p99 " + String (stats.getJitter().getPercentileUs (0.99), 0) + " us";
+
+    if (stats.getNumQueueFull() > 0)
+        text += ", " + String (stats.getNumQueueFull()) + " dropped";
+
+    if (stats.getNumStalls() > 0)
+        text += ", " + String (stats.getNumStalls()) + " stalls";
+
+    if (stats.getNumReconnects() > 0)
+        text += ", " + String (stats.getNumReconnects()) + " reconnects";
+
+    const String status = node->getConnectionStatus();
+
+    if (status.isNotEmpty())
+        text = status + " " + text;
+
+    if (stats.getNumHeaderMismatches() > 0)
+        text += ", " + String (stats.getNumHeaderMismatches()) + " bad headers";
+
+    statsLabel->setText (text, dontSendNotification);
+
+    lastSnapshot = now;
+    lastSnapshotStream = stream;
+}
+
 void EphysSocketEditor::buttonClicked (Button* button)
 {
     if (button == connectButton.get() && ! acquisitionIsActive)
     {
         node->connectSocket();
-
-        CoreServices::updateSignalChain (this);
     }
     else if (button == disconnectButton.get() && ! acquisitionIsActive)
     {
         node->disconnectSocket();
     }
+    else if (button == addStreamButton.get() && ! acquisitionIsActive)
+    {
+        if (node->addStream())
+        {
+            updateStreamSelector();
+            CoreServices::updateSignalChain (this);
+        }
+    }
+    else if (button == removeStreamButton.get() && ! acquisitionIsActive)
+    {
+        if (node->removeStream())
+        {
+            updateStreamSelector();
+            CoreServices::updateSignalChain (this);
+        }
+    }
+}
+
+void EphysSocketEditor::comboBoxChanged (ComboBox* comboBox)
+{
+    if (comboBox == streamSelector.get())
+    {
+        node->selectStream (streamSelector->getSelectedId() - 1);
+    }
 }
 
-void EphysSocketEditor::connected()
+void EphysSocketEditor::connecting()
 {
     connectButton->setVisible (false);
     disconnectButton->setVisible (true);
+
+    addStreamButton->setEnabled (false);
+    removeStreamButton->setEnabled (false);
+
+    updateConnectionStatus();
+}
+
+void EphysSocketEditor::updateConnectionStatus()
+{
+    if (acquisitionIsActive)
+    {
+        return;
+    }
+
+    const String status = node->getConnectionStatus();
+
+    statsLabel->setText (status.isEmpty() ? "Connected." : status, dontSendNotification);
 }
 
 void EphysSocketEditor::disconnected()
 {
     connectButton->setVisible (true);
     disconnectButton->setVisible (false);
+
+    addStreamButton->setEnabled (true);
+    removeStreamButton->setEnabled (true);
+    updateStreamSelector();
+
+    if (! acquisitionIsActive)
+        statsLabel->setText (String(), dontSendNotification);
 }
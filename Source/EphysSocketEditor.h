@@ -8,13 +8,16 @@
 #include <VisualizerEditorHeaders.h>
 
 #include "EphysSocketHeader.h"
+#include "StreamStats.h"
 
 namespace EphysSocketNode
 {
 class EphysSocket;
 
 class EphysSocketEditor : public GenericEditor,
-                          public Button::Listener
+                          public Button::Listener,
+                          public ComboBox::Listener,
+                          private Timer
 {
 public:
     /** Constructor */
@@ -23,23 +26,50 @@ public:
     /** Button listener callback, called by button when pressed. */
     void buttonClicked (Button* button);
 
+    /** ComboBox listener callback, called when a stream is selected. */
+    void comboBoxChanged (ComboBox* comboBox);
+
     /** Called by processor graph in beginning of the acquisition, disables editor completely. */
     void startAcquisition();
 
     /** Called by processor graph at the end of the acquisition, reenables editor completely. */
     void stopAcquisition();
 
-    /** Called by the processor when the socket is connected. */
-    void connected();
+    /** Called by the processor when the sockets start connecting. */
+    void connecting();
 
     /** Called by the processor when the socket is disconnected. */
     void disconnected();
 
+    /** Called by the processor, on the message thread, whenever a stream's connection changes. */
+    void updateConnectionStatus();
+
+    /** Rebuilds the stream selector from the processor's streams. */
+    void updateStreamSelector();
+
 private:
+    /** Refreshes the live stats of the selected stream during acquisition. */
+    void timerCallback() override;
+
     // Button that connects/disconnects from/to server
     std::unique_ptr<UtilityButton> connectButton;
     std::unique_ptr<UtilityButton> disconnectButton;
 
+    // Selects the stream the parameter editors apply to, and adds/removes streams
+    std::unique_ptr<ComboBox> streamSelector;
+    std::unique_ptr<UtilityButton> addStreamButton;
+    std::unique_ptr<UtilityButton> removeStreamButton;
+
+    // Progress of the connection, then the live receive rates, queue high-water mark, conversion time and jitter of the selected stream
+    std::unique_ptr<Label> statsLabel;
+
+    // Totals at the last refresh, which the live rates are measured from
+    StreamStats::Snapshot lastSnapshot;
+    int lastSnapshotStream = -1;
+
+    // How often the live stats are refreshed
+    const int statsIntervalMs = 1000;
+
     String stringConnect = "CONNECT";
     String stringDisconnect = "DISCONNECT";
 
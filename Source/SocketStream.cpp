@@ -0,0 +1,260 @@
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "EphysSocket.h"
+#include "SocketStream.h"
+
+#include <chrono>
+#include <limits>
+
+using namespace EphysSocketNode;
+
+SocketStream::SocketStream (int index, EphysSocket* processor, WaitableEvent& packetsReady)
+    : settings { EphysSocket::DEFAULT_PORT + index,
+                 EphysSocket::DEFAULT_SAMPLE_RATE,
+                 EphysSocket::DEFAULT_DATA_SCALE,
+                 EphysSocket::DEFAULT_DATA_OFFSET,
+                 EphysSocket::DEFAULT_LAYOUT,
+                 EphysSocket::DEFAULT_TRANSPORT,
+                 String(),
+                 EphysSocket::DEFAULT_TTL_ROWS,
+                 EphysSocket::DEFAULT_TTL_BITS,
+                 String(),
+                 ChannelMap(),
+                 String(),
+                 String(),
+                 EphysSocket::DEFAULT_REPLAY_PACE,
+                 String(),
+                 EphysSocket::DEFAULT_OUTPUT_RATE,
+                 String() },
+      socket ("socket_thread_" + String (index + 1), index, processor, settings, packetsReady)
+{
+    total_samples = 0;
+    skipped_samples = 0;
+    eventState = 0;
+
+    numLostSamples = 0;
+    numGaps = 0;
+    longestGap = 0;
+    numFilledSamples = 0;
+}
+
+void SocketStream::resizeBuffers (DataBuffer* buffer)
+{
+    const int maxBatchPackets = jmax (1, (int) (settings.sample_rate * maxBatchSizeInSeconds) / socket.num_samp);
+    const int maxPacketsPerUpdate = jmin (maxBatchPackets, jmax (1, socket.getNumQueueSlots()));
+
+    const int maxSamples = maxPacketsPerUpdate * socket.num_samp;
+
+    batch.prepare (socket.depth, socket.element_size, socket.num_channels, socket.num_samp, settings.layout, settings.data_scale, settings.data_offset, maxPacketsPerUpdate, socket.header_size);
+
+    // Channels in the channel map have their own scale and offset
+    if (! settings.channels.isEmpty())
+    {
+        std::vector<float> scales, offsets;
+        settings.channels.getScales (socket.num_channels, settings.data_scale, settings.data_offset, scales, offsets);
+        batch.setChannelScales (scales, offsets);
+    }
+
+    const bool announced = socket.ttl_rows > 0;
+    batch.setDigitalRows (jmin (announced ? socket.ttl_rows : settings.ttl_rows, socket.num_channels - 1), announced ? socket.ttl_bits : settings.ttl_bits);
+
+    const int numAnalogChannels = batch.getNumAnalogChannels();
+
+    buffer->resize (numAnalogChannels, settings.getOutputSampleRate() * bufferSizeInSeconds);
+    sampleNumbers.resize (maxSamples);
+    arrivals.resize (maxPacketsPerUpdate);
+
+    fillData.resize ((size_t) numAnalogChannels * maxSamples);
+    fillTimestamps.resize (maxSamples);
+    fillTtlWords.resize (maxSamples);
+    lastValues.assign (numAnalogChannels, 0.0f);
+
+    decimator.prepare (settings.getDecimation(), numAnalogChannels, maxSamples);
+
+    const int maxOutputSamples = decimator.getMaxOutputSamples (maxSamples);
+
+    decimatedData.resize ((size_t) numAnalogChannels * maxOutputSamples);
+    decimatedTimestamps.resize (maxOutputSamples);
+    decimatedTtlWords.resize (maxOutputSamples);
+
+    LOGD ("Ephys Socket converting samples with ", DataConverter::getSimdLevelName (batch.getConverter().getSimdLevel()), " kernels");
+
+    if (decimator.getFactor() > 1)
+    {
+        LOGC ("Ephys Socket decimating port ", settings.port, " by ", decimator.getFactor(), " to ", settings.getOutputSampleRate(), " Hz, delaying it by ", decimator.getDelay(), " samples, with ", DataConverter::getSimdLevelName (decimator.getSimdLevel()), " kernels");
+    }
+}
+
+void SocketStream::reset()
+{
+    total_samples = 0;
+    skipped_samples = 0;
+    eventState = 0;
+
+    numLostSamples = 0;
+    numGaps = 0;
+    longestGap = 0;
+    numFilledSamples = 0;
+
+    std::fill (lastValues.begin(), lastValues.end(), 0.0f);
+
+    decimator.reset();
+    latency.reset();
+}
+
+int SocketStream::pushPackets (DataBuffer* buffer, int maxPackets, GapFill gapFill)
+{
+    const int numReady = socket.packets.getNumReady();
+
+    if (numReady == 0)
+    {
+        return 0;
+    }
+
+    socket.stats.recordQueueDepth (numReady);
+
+    const int limit = jmin (numReady, batch.getMaxPackets(), maxPackets > 0 ? maxPackets : numReady);
+    int batchSize = 1;
+
+    while (batchSize < limit && socket.packets.getReadInfo (batchSize).missingSamples == 0)
+    {
+        batchSize++;
+    }
+
+    const PacketInfo& first = socket.packets.getReadInfo (0);
+
+    if (first.missingSamples > 0)
+    {
+        fillGap (buffer, first.missingSamples, gapFill, first);
+    }
+
+    // Read before the conversion releases the slots
+    for (int p = 0; p < batchSize; p++)
+    {
+        arrivals[p] = socket.packets.getReadInfo (p).arrivalNs;
+    }
+
+    const auto convertStart = std::chrono::steady_clock::now();
+
+    const int numPackets = batch.convert (socket.packets, batchSize);
+
+    socket.stats.recordConversion (numPackets, std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - convertStart).count());
+
+    if (numPackets == 0)
+    {
+        return 0;
+    }
+
+    const int numSamples = batch.getNumSamples();
+    const float* data = batch.getData();
+
+    for (int ch = 0; ch < (int) lastValues.size(); ch++)
+    {
+        lastValues[ch] = data[(size_t) ch * numSamples + numSamples - 1];
+    }
+
+    eventState = batch.getTtlState();
+
+    pushSamples (buffer, data, batch.getTimestamps(), batch.getTtlWords(), numSamples);
+
+    const int64 pushedNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (int p = 0; p < numPackets; p++)
+    {
+        latency.record (pushedNs - arrivals[p]);
+    }
+
+    return numPackets;
+}
+
+void SocketStream::fillGap (DataBuffer* buffer, int64 numMissing, GapFill gapFill, const PacketInfo& next)
+{
+    numLostSamples += numMissing;
+    numGaps++;
+
+    if (numMissing > longestGap)
+    {
+        longestGap = numMissing;
+    }
+
+    if (gapFill == NO_FILL)
+    {
+        return;
+    }
+
+    if (numMissing > (int64) (settings.sample_rate * maxGapFillInSeconds))
+    {
+        skipped_samples += numMissing;
+        total_samples += skipped_samples / decimator.getFactor();
+        skipped_samples %= decimator.getFactor();
+        decimator.reset();
+        return;
+    }
+
+    const int numChannels = (int) lastValues.size();
+    const int maxSamples = (int) fillTimestamps.size();
+
+    // The lost samples end where the next packet starts
+    const double firstTime = next.firstSampleTime - numMissing * next.samplePeriod;
+    int64 pushed = 0;
+
+    while (pushed < numMissing)
+    {
+        const int numSamples = (int) jmin ((int64) maxSamples, numMissing - pushed);
+
+        for (int ch = 0; ch < numChannels; ch++)
+        {
+            float value = 0.0f;
+
+            if (gapFill == HOLD_FILL)
+                value = lastValues[ch];
+            else if (gapFill == NAN_FILL)
+                value = std::numeric_limits<float>::quiet_NaN();
+
+            std::fill_n (fillData.begin() + (size_t) ch * numSamples, numSamples, value);
+        }
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            fillTimestamps[i] = firstTime + (pushed + i) * next.samplePeriod;
+            fillTtlWords[i] = eventState;
+        }
+
+        pushSamples (buffer, fillData.data(), fillTimestamps.data(), fillTtlWords.data(), numSamples);
+
+        pushed += numSamples;
+    }
+
+    numFilledSamples += numMissing;
+}
+
+void SocketStream::pushSamples (DataBuffer* buffer, const float* data, const double* timestamps, const uint64_t* ttlWords, int numSamples)
+{
+    if (decimator.getFactor() > 1)
+    {
+        numSamples = decimator.process (data, numSamples, timestamps, ttlWords, numSamples, decimatedData.data(), decimatedTimestamps.data(), decimatedTtlWords.data());
+
+        if (numSamples == 0)
+        {
+            return;
+        }
+
+        data = decimatedData.data();
+        timestamps = decimatedTimestamps.data();
+        ttlWords = decimatedTtlWords.data();
+    }
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        sampleNumbers.set (i, total_samples++);
+    }
+
+    // JUCE's uint64 is unsigned long long, which uint64_t need not be, but they have the same size
+    buffer->addToBuffer ((float*) data,
+                         sampleNumbers.getRawDataPointer(),
+                         (double*) timestamps,
+                         (uint64*) ttlWords,
+                         numSamples);
+}
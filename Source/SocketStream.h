@@ -0,0 +1,115 @@
+#ifndef __SOCKETSTREAMH__
+#define __SOCKETSTREAMH__
+
+#include <DataThreadHeaders.h>
+
+#include "BatchConverter.h"
+#include "Decimator.h"
+#include "LatencyHistogram.h"
+#include "SocketThread.h"
+#include "StreamSettings.h"
+
+namespace EphysSocketNode
+{
+class EphysSocket;
+
+/**
+    One network endpoint of the EphysSocket: its settings, its receiver thread
+    and the buffers used to convert its packets into its DataBuffer.
+*/
+class SocketStream
+{
+public:
+    /** Constructor */
+    SocketStream (int index, EphysSocket* processor, WaitableEvent& packetsReady);
+
+    /** Resizes the DataBuffer and conversion buffers to match the connected stream */
+    void resizeBuffers (DataBuffer* buffer);
+
+    /** Resets sample counters and discards queued packets before acquisition starts */
+    void reset();
+
+    /** Converts up to maxPackets queued packets (0 = all) and pushes them with one addToBuffer call.
+        Samples lost before the first of them are pushed first, filled as gapFill says, so the
+        sample numbers keep following the sender. Returns the number of packets pushed. */
+    int pushPackets (DataBuffer* buffer, int maxPackets, GapFill gapFill);
+
+    /** Samples lost during the current acquisition, and the number and longest of the gaps they left */
+    int64 getNumLostSamples() const { return numLostSamples; }
+    int64 getNumGaps() const { return numGaps; }
+    int64 getLongestGap() const { return longestGap; }
+
+    /** Samples pushed in place of lost ones */
+    int64 getNumFilledSamples() const { return numFilledSamples; }
+
+    /** Channels pushed as continuous data, and digital lines pushed as TTL words; valid after resizeBuffers() */
+    int getNumAnalogChannels() const { return batch.getNumAnalogChannels(); }
+    int getNumTtlLines() const { return batch.getNumTtlLines(); }
+
+    /** Samples whose TTL word changed since the buffers were last resized */
+    int64 getNumTtlEdges() const { return batch.getNumTtlEdges(); }
+
+    /** Time from each packet's arrival to its samples being added to the DataBuffer, during the current acquisition */
+    const LatencyHistogram& getLatency() const { return latency; }
+
+    /** Length of the DataBuffer in seconds */
+    static constexpr int bufferSizeInSeconds = 10;
+
+    StreamSettings settings;
+
+    SocketThread socket;
+
+private:
+    /** Upper bound on the samples pushed by one pushPackets call, which sizes the conversion buffers */
+    const float maxBatchSizeInSeconds = 0.1f;
+
+    /** Longest gap that is filled; sample numbers skip longer ones without data */
+    const float maxGapFillInSeconds = 1.0f;
+
+    /** Accounts for samples lost before the next packet and pushes their fill */
+    void fillGap (DataBuffer* buffer, int64 numMissing, GapFill gapFill, const PacketInfo& next);
+
+    /** Decimates a block of channel rows numSamples long, if the stream has an output rate, and adds it to the DataBuffer */
+    void pushSamples (DataBuffer* buffer, const float* data, const double* timestamps, const uint64_t* ttlWords, int numSamples);
+
+    /** Vectorized conversion of queued packets into DataBuffer-ready blocks */
+    BatchConverter batch;
+
+    /** Anti-aliasing filter and downsampler to the output rate, and the blocks it produces */
+    Decimator decimator;
+    std::vector<float> decimatedData;
+    std::vector<double> decimatedTimestamps;
+    std::vector<uint64_t> decimatedTtlWords;
+
+    /** Sample index counter */
+    int64 total_samples;
+
+    /** Input samples skipped over long gaps that don't make up a whole output sample yet */
+    int64 skipped_samples;
+
+    /** Local event state variable */
+    uint64 eventState;
+
+    Array<int64> sampleNumbers;
+
+    /** Arrival times of the packets being pushed, and how long they took to reach the DataBuffer */
+    std::vector<int64> arrivals;
+    LatencyHistogram latency;
+
+    /** Fill pushed for lost samples, and the last sample pushed on each channel */
+    std::vector<float> fillData;
+    std::vector<double> fillTimestamps;
+    std::vector<uint64_t> fillTtlWords;
+    std::vector<float> lastValues;
+
+    /** Written by the DataThread, read by any thread */
+    std::atomic<int64> numLostSamples;
+    std::atomic<int64> numGaps;
+    std::atomic<int64> longestGap;
+    std::atomic<int64> numFilledSamples;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SocketStream);
+};
+} // namespace EphysSocketNode
+
+#endif
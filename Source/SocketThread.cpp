@@ -5,13 +5,13 @@
 #include "EphysSocket.h"
 #include "SocketThread.h"
 
+#include <chrono>
+
 using namespace EphysSocketNode;
 
-SocketThread::SocketThread (String name, EphysSocket* processor_)
-    : Thread (name), processor (processor_)
+SocketThread::SocketThread (String name_, int index_, EphysSocket* processor_, const StreamSettings& settings_, WaitableEvent& packetsReady_)
+    : Thread (name_), processor (processor_), settings (settings_), index (index_), name (name_), packetsReady (packetsReady_)
 {
-    lastPacketReceived = time (nullptr);
-
     socket = nullptr;
 
     previousPort = -1;
@@ -21,26 +21,72 @@ SocketThread::SocketThread (String name, EphysSocket* processor_)
     num_bytes = DEFAULT_NUM_BYTES;
     num_channels = DEFAULT_NUM_CHANNELS;
     num_samp = DEFAULT_NUM_SAMPLES;
+    header_size = HEADER_SIZE;
+    ttl_rows = 0;
+    ttl_bits = 0;
+
+    lowLatency = false;
+    cpu = -1;
+
+    batchDatagrams = false;
 
     error_flag = false;
-    connected = false;
-    shouldReconnect = false;
+    state = DISCONNECTED;
+    wasConnected = false;
     acquiring = false;
+    resumePending = false;
+    numQueueSlots = 0;
+    queueFull = false;
+
+    numWakeups = 0;
+    totalWakeLatencyUs = 0;
+    maxWakeLatencyUs = 0;
+
+    sequenceResetPending = true;
+    numLatencies = 0;
+    totalLatencyUs = 0;
+    maxLatencyUs = 0;
+
+    pendingMissingSamples = 0;
+    lastNumDropped = 0;
+    lastArrivalNs = 0;
+    reconnected = false;
+
+    clockResetPending = true;
+    estimatedSampleRate = 0.0;
+    clockDriftPpm = 0.0;
+    clockLocked = false;
+    driftReported = false;
 }
 
 SocketThread::~SocketThread()
 {
     stopThread (1000);
 
-    if (socket != nullptr)
-    {
-        socket->close();
-        socket.reset();
-    }
+    closeSocket();
 }
 
 void SocketThread::startAcquisition()
 {
+    frameReader.getAssembler().resetCounters();
+    frameReader.getAssembler().setLayout (settings.layout);
+
+    stats.reset (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    numWakeups = 0;
+    totalWakeLatencyUs = 0;
+    maxWakeLatencyUs = 0;
+
+    sequenceResetPending = true;
+    numLatencies = 0;
+    totalLatencyUs = 0;
+    maxLatencyUs = 0;
+
+    resumePending = true;
+
+    // Under the lock, so a reconnect in progress never resizes the queue under the DataThread
+    std::lock_guard<std::mutex> lock (queueMutex);
+    packets.clear();
     acquiring = true;
 }
 
@@ -48,13 +94,40 @@ void SocketThread::stopAcquisition()
 {
     acquiring = false;
 
-    if (shouldReconnect)
+    stats.finish (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    LOGD ("Ephys Socket receive loop: mean wake-up latency ", getMeanWakeLatencyUs(), " us, max ", getMaxWakeLatencyUs(), " us");
+    LOGD ("Ephys Socket received ", stats.getNumPackets(), " packets in ", stats.getNumReads(), " reads");
+
+    const PacketAssembler& assembler = frameReader.getAssembler();
+
+    if (assembler.getNumDecompressed() > 0)
+    {
+        LOGD ("Ephys Socket decoded ", assembler.getNumDecompressed(), " compressed matrices, at ", 100.0 * assembler.getNumCompressedBytes() / ((double) assembler.getNumDecompressed() * num_channels * num_samp * element_size), "% of raw");
+    }
+
+    if (assembler.getNumDropped() > 0 || assembler.getNumInvalid() > 0)
+    {
+        LOGC ("Ephys Socket dropped ", assembler.getNumDropped(), " incomplete matrices: ", assembler.getNumMissing(), " gaps, ", assembler.getNumOutOfOrder(), " out-of-order, ", assembler.getNumInvalid(), " invalid and ", assembler.getNumChecksumErrors(), " corrupted fragments");
+    }
+
+    if (header_size > HEADER_SIZE)
+    {
+        if (sequence.getNumLostSamples() > 0 || sequence.getNumDuplicates() > 0 || sequence.getNumLate() > 0)
+        {
+            LOGC ("Ephys Socket lost ", sequence.getNumLostSamples(), " samples in ", sequence.getNumGaps(), " gaps, and dropped ", sequence.getNumDuplicates(), " duplicate and ", sequence.getNumLate(), " late packets");
+        }
+
+        LOGD ("Ephys Socket one-way latency: mean ", getMeanOneWayLatencyUs(), " us, max ", getMaxOneWayLatencyUs(), " us");
+    }
+
+    if (stats.getNumStalls() > 0)
     {
-        processor->disconnectSocket();
+        LOGC ("Ephys Socket: the sender stalled ", stats.getNumStalls(), " times and was reconnected ", stats.getNumReconnects(), " times");
     }
 }
 
-bool SocketThread::connectSocket (int port, bool printOutput)
+bool SocketThread::connectSocket (int port)
 {
     if (port == -1)
     {
@@ -69,267 +142,1112 @@ bool SocketThread::connectSocket (int port, bool printOutput)
         }
     }
 
-    std::lock_guard<std::mutex> lock (socketMutex);
-
-    if (socket != nullptr && socket->isConnected())
+    if (isThreadRunning() || state != DISCONNECTED)
     {
         LOGE ("Attempting to connect to an already active socket.");
         return false;
     }
 
+    previousPort = port;
+
     error_flag = false;
+    wasConnected = false;
+
+    lowLatency = processor->low_latency;
+    cpu = processor->cpu_affinity >= 0 ? processor->cpu_affinity + index : -1;
 
-    socket = std::make_unique<StreamingSocket>();
-    connected = socket->connect ("localhost", port, 250);
+    monitor.reset();
+    state = CONNECTING;
 
-    if (connected)
+    return startThread();
+}
+
+bool SocketThread::openSource()
+{
+    const bool firstAttempt = monitor.getNumAttempts() == 0;
+    const int port = previousPort;
+
+    bool opened = false;
+
+    if (settings.transport == REPLAY)
+    {
+        opened = replay.open (settings.replay_file.toStdString(), settings.replay_pace == RECORDED_PACE);
+
+        if (! opened)
+            LOGE ("Ephys Socket could not open capture file ", settings.replay_file);
+    }
+    else if (settings.transport == UDP)
     {
-        std::vector<std::byte> header_bytes (HEADER_SIZE);
+        datagramSocket = std::make_unique<DatagramSocket>();
 
-        LOGD ("Reading header...");
-        int rc;
+        if (settings.multicast_group.isNotEmpty())
+            datagramSocket->setEnablePortReuse (true);
 
-        for (int i = 0; i < 5; i++)
+        opened = datagramSocket->bindToPort (port);
+
+        if (opened && settings.multicast_group.isNotEmpty())
         {
-            rc = socket->read (header_bytes.data(), HEADER_SIZE, false);
+            opened = datagramSocket->joinMulticast (settings.multicast_group);
 
-            if (rc == HEADER_SIZE)
-                break;
-            else
-                sleep (100);
+            if (opened)
+                joinedGroup = settings.multicast_group;
+            else if (firstAttempt)
+                LOGE ("EphysSocket could not join multicast group ", settings.multicast_group);
         }
+    }
+    else if (settings.transport == UNIX_SOCKET)
+    {
+        localSocket = std::make_unique<LocalSocket>();
+        opened = localSocket->connect (settings.getLocalPath().toStdString());
 
-        if (rc != HEADER_SIZE)
+        if (! LocalSocket::isSupported())
+            LOGE ("Ephys Socket: Unix domain sockets are not supported on this platform");
+    }
+    else if (settings.transport == SHARED_MEMORY)
+    {
+        sharedMemory = std::make_unique<SharedMemoryRing>();
+        opened = sharedMemory->open (settings.getLocalPath().toStdString());
+    }
+    else if (settings.transport == TCP_SERVER)
+    {
+        if (server == nullptr)
         {
-            if (printOutput)
+            server = std::make_unique<TcpServer>();
+
+            // The buffer is set before listening, so the window scale offered in the handshake can make use of it
+            if (! server->listen (settings.getHost().toStdString(), port, processor->receive_buffer > 0 ? processor->receive_buffer * 1024 : SERVER_RECEIVE_BUFFER))
+            {
+                if (firstAttempt)
+                    LOGE ("Ephys Socket could not listen on port ", port, settings.getHost().isEmpty() ? String() : " of " + settings.getHost());
+
+                server.reset();
+            }
+            else
             {
-                LOGC ("EphysSocket failed to connect; could not read header from stream. Bytes read: ", rc);
-                CoreServices::sendStatusMessage ("Ephys Socket: Could not read stream.");
+                LOGC ("Ephys Socket listening on port ", port, settings.getHost().isEmpty() ? " of every interface" : " of " + settings.getHost());
             }
+        }
 
-            socket->close();
-            socket.reset();
+        opened = server != nullptr && server->accept (CONNECT_TIMEOUT_MS);
 
-            connected = false;
+        if (opened)
+            LOGC ("Ephys Socket accepted a connection from ", server->getPeerAddress());
+    }
+    else
+    {
+        socket = std::make_unique<StreamingSocket>();
+        opened = socket->connect (settings.getHost(), port, CONNECT_TIMEOUT_MS);
+    }
 
-            return false;
+    if (! opened)
+    {
+        if (firstAttempt && settings.transport != REPLAY)
+            LOGC ("EphysSocket could not connect yet; retrying until it does");
+
+        closeSocket();
+        return false;
+    }
+
+    configureSocket();
+
+    if (settings.capture_file.isNotEmpty() && settings.transport != REPLAY && ! capture.isOpen())
+    {
+        if (capture.open (settings.capture_file.toStdString(), datagramSocket != nullptr ? CAPTURE_DATAGRAMS : CAPTURE_STREAM))
+        {
+            LOGC ("Ephys Socket capturing received bytes to ", settings.capture_file);
         }
+        else
+        {
+            LOGE ("Ephys Socket could not create capture file ", settings.capture_file);
+            CoreServices::sendStatusMessage ("Ephys Socket: Could not create capture file.");
+        }
+    }
+
+    monitor.recordActivity (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    return true;
+}
+
+ReadStatus SocketThread::readFirstHeader (std::byte* header_bytes, int& numRead)
+{
+    numRead = 0;
+
+    if (isDatagramSource())
+    {
+        const int ready = waitForSource (READ_TIMEOUT_MS);
 
-        EphysSocketHeader tmp_header = EphysSocketHeader (header_bytes);
-        LOGD ("Header read and parsed correctly.");
+        if (ready <= 0)
+            return ready < 0 ? READ_ERROR : NO_DATA;
 
-        num_bytes = tmp_header.num_bytes;
-        element_size = tmp_header.element_size;
-        depth = tmp_header.depth;
-        num_samp = tmp_header.num_samp;
-        num_channels = tmp_header.num_channels;
+        datagram_buffer.resize (MAX_DATAGRAM_SIZE);
+        const int rc = readSource (datagram_buffer.data(), MAX_DATAGRAM_SIZE, false);
 
-        const int matrix_size = num_channels * num_samp * element_size;
-        header_bytes.reserve (matrix_size);
-        socket->read (header_bytes.data(), matrix_size, true); // NB: Realign stream to the beginning of a packet
+        if (rc < 0)
+            return READ_ERROR;
 
-        lastPacketReceived = time (nullptr);
+        if (rc == 0 && replay.isFinished())
+            return STREAM_CLOSED;
 
-        previousPort = port;
+        if (rc < HEADER_SIZE)
+            return NO_DATA;
 
-        if (printOutput)
+        numRead = jmin (HEADER_SIZE + MAX_EXTENSION_SIZE, rc);
+        std::copy (datagram_buffer.begin(), datagram_buffer.begin() + numRead, header_bytes);
+    }
+    else
+    {
+        ReadStatus status = readExactly (header_bytes, HEADER_SIZE, false);
+
+        if (status != PACKET_READY)
+            return status;
+
+        numRead = HEADER_SIZE;
+
+        if (EphysSocketHeader (header_bytes).isExtended())
         {
-            LOGC ("EphysSocket connected.");
-            CoreServices::sendStatusMessage ("Ephys Socket: Socket connected.");
+            status = readExactly (header_bytes + HEADER_SIZE, EXTENSION_PREAMBLE_SIZE, true);
+
+            if (status != PACKET_READY)
+                return status;
+
+            numRead += EXTENSION_PREAMBLE_SIZE;
+
+            const int extension_size = EphysSocketHeader::getExtensionSize (header_bytes);
+
+            if (extension_size < 0)
+                return INVALID_HEADER;
+
+            status = readExactly (header_bytes + numRead, extension_size - EXTENSION_PREAMBLE_SIZE, true);
+
+            if (status != PACKET_READY)
+                return status;
+
+            numRead = HEADER_SIZE + extension_size;
         }
+    }
+
+    EphysSocketHeader header = EphysSocketHeader (header_bytes);
 
-        read_buffer.resize (num_channels * num_samp * element_size + HEADER_SIZE);
+    if (header.isExtended() && (! header.parseExtension (header_bytes) || numRead < header.getSize()))
+        return INVALID_HEADER;
 
-        shouldReconnect = false;
+    return PACKET_READY;
+}
+
+ReadStatus SocketThread::startStream (const std::byte* header_bytes)
+{
+    EphysSocketHeader header = EphysSocketHeader (header_bytes);
 
-        bool result = startThread();
+    if (header.isExtended())
+        header.parseExtension (header_bytes);
 
-        return true;
+    if (! header.isValid())
+    {
+        LOGE ("Ephys Socket: invalid header, ", header.num_channels, " channels x ", header.num_samp, " samples of depth ", (int) header.depth, " in ", header.element_size, "-byte elements");
+        return INVALID_HEADER;
     }
-    else
+
+    LOGD ("Header read and parsed correctly", header.isExtended() ? ", with an extension." : ".");
+
+    // The queue's slots were sized for the previous header, and the channels registered for its digital rows
+    if (wasConnected && (! compareHeaders (header) || header.getSize() != header_size || header.ttl_rows != ttl_rows || header.ttl_bits != ttl_bits))
+    {
+        return INVALID_HEADER;
+    }
+
+    num_bytes = header.num_bytes;
+    element_size = header.element_size;
+    depth = header.depth;
+    num_samp = header.num_samp;
+    num_channels = header.num_channels;
+    header_size = header.getSize();
+    ttl_rows = header.ttl_rows;
+    ttl_bits = header.ttl_bits;
+
+    const int matrix_size = num_channels * num_samp * element_size;
+    read_buffer.resize (matrix_size + header_size);
+    frameReader.reset (matrix_size, header_size, settings.layout);
+
+    if (! isDatagramSource())
     {
-        if (printOutput)
+        const int payload_size = header.getPayloadSize (matrix_size);
+
+        if (payload_size < 0 || payload_size > matrix_size)
+            return INVALID_HEADER;
+
+        const ReadStatus status = readExactly (read_buffer.data(), payload_size, true);
+
+        if (status != PACKET_READY)
+            return status;
+
+        streamBuffer.reset (this, sharedMemory != nullptr ? 0 : STREAM_BUFFER_SIZE);
+    }
+
+    batchDatagrams = datagramSocket != nullptr && header_size + header.getPayloadSize (matrix_size) <= DATAGRAM_BATCH_THRESHOLD;
+
+    if (batchDatagrams)
+        datagrams.resize (DATAGRAM_BATCH_SIZE, jmin (MAX_DATAGRAM_SIZE, matrix_size + header_size));
+
+    {
+        std::lock_guard<std::mutex> lock (queueMutex);
+
+        if (! acquiring)
         {
-            LOGC ("EphysSocket failed to connect");
-            CoreServices::sendStatusMessage ("Ephys Socket: Could not connect.");
+            const int packets_per_second = (int) std::ceil (settings.sample_rate / num_samp);
+            packets.resize (jmax (MIN_QUEUE_SLOTS, (int) (packets_per_second * QUEUE_SIZE_IN_SECONDS)), matrix_size + header_size, header_size);
+            numQueueSlots = packets.getNumSlots();
+
+            if (! packets.isPinned())
+                LOGD ("Ephys Socket could not lock the packet queue into memory");
         }
+    }
 
-        return false;
+    const int64 nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+    monitor.recordConnected (nowNs, settings.sample_rate > 0 ? num_samp / settings.sample_rate : 0.0);
+
+    clockResetPending = true;
+    reconnected = acquiring.load();
+
+    if (reconnected)
+    {
+        stats.recordReconnect();
+        sequence.resync();
     }
+
+    return PACKET_READY;
 }
 
-void SocketThread::disconnectSocket()
+ReadStatus SocketThread::readExactly (std::byte* dest, int numBytes, bool midPacket)
 {
-    std::lock_guard<std::mutex> lock (socketMutex);
+    int numRead = 0;
 
-    if (socket != nullptr)
+    while (numRead < numBytes)
     {
-        LOGD ("Disconnecting socket.");
+        const int ready = waitForData();
 
-        socket->close();
-        socket.reset();
+        if (ready < 0)
+        {
+            return READ_ERROR;
+        }
 
-        CoreServices::sendStatusMessage ("Ephys Socket: Disconnected.");
+        if (ready == 0)
+        {
+            if (threadShouldExit() || (numRead == 0 && ! midPacket))
+            {
+                return NO_DATA;
+            }
+
+            if (! replay.isOpen() && checkForStall())
+            {
+                return STREAM_CLOSED;
+            }
+
+            continue;
+        }
+
+        const int rc = readSource (dest + numRead, numBytes - numRead, false);
+
+        if (rc < 0)
+        {
+            return READ_ERROR;
+        }
+
+        if (rc == 0)
+        {
+            return STREAM_CLOSED;
+        }
+
+        numRead += rc;
     }
 
-    connected = false;
-    shouldReconnect = false;
+    return PACKET_READY;
 }
 
-bool SocketThread::isConnected()
+bool SocketThread::checkForStall()
 {
-    return connected;
+    const int64 nowNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    if (state == CONNECTED && monitor.isStalled (nowNs))
+    {
+        LOGD ("Ephys Socket: ", name, " received nothing for ", monitor.getSilenceMs (nowNs), " ms");
+
+        stats.recordStall();
+        setState (STALLED);
+    }
+
+    return monitor.isLost (nowNs);
 }
 
-bool SocketThread::isError() const
+void SocketThread::setState (ConnectionState newState)
 {
-    return error_flag;
+    if (state.exchange (newState) != newState)
+    {
+        processor->connectionStateChanged();
+    }
 }
 
-bool SocketThread::compareHeaders (EphysSocketHeader header) const
+bool SocketThread::isOpen() const
 {
-    if (header.depth != depth || header.element_size != element_size || header.num_channels != num_channels || header.num_samp != num_samp)
+    return (socket != nullptr && socket->isConnected()) || (server != nullptr && server->isConnected()) || datagramSocket != nullptr || localSocket != nullptr || sharedMemory != nullptr || replay.isOpen();
+}
+
+intptr_t SocketThread::getSocketHandle() const
+{
+    if (socket != nullptr)
+        return socket->getRawSocketHandle();
+
+    if (datagramSocket != nullptr)
+        return datagramSocket->getRawSocketHandle();
+
+    if (server != nullptr && server->isConnected())
+        return server->getRawSocketHandle();
+
+    return localSocket != nullptr ? localSocket->getRawSocketHandle() : -1;
+}
+
+bool SocketThread::isDatagramSource() const
+{
+    return datagramSocket != nullptr || (replay.isOpen() && replay.getKind() == CAPTURE_DATAGRAMS);
+}
+
+int SocketThread::waitForSource (int timeoutMs)
+{
+    if (replay.isOpen())
+        return replay.waitUntilReady (timeoutMs);
+
+    if (datagramSocket != nullptr)
+        return datagramSocket->waitUntilReady (true, timeoutMs);
+
+    if (localSocket != nullptr)
+        return localSocket->waitUntilReady (timeoutMs);
+
+    if (sharedMemory != nullptr)
+        return sharedMemory->waitUntilReady (timeoutMs);
+
+    if (server != nullptr)
+        return server->waitUntilReady (timeoutMs);
+
+    return socket != nullptr ? socket->waitUntilReady (true, timeoutMs) : -1;
+}
+
+int SocketThread::readSource (std::byte* dest, int numBytes, bool block)
+{
+    int rc = -1;
+
+    if (replay.isOpen())
+        rc = replay.read (dest, numBytes, block);
+    else if (datagramSocket != nullptr)
+        rc = datagramSocket->read (dest, numBytes, false);
+    else if (socket != nullptr)
+        rc = socket->read (dest, numBytes, block);
+    else if (localSocket != nullptr)
+        rc = localSocket->read (dest, numBytes, block);
+    else if (sharedMemory != nullptr)
+        rc = sharedMemory->read (dest, numBytes, block);
+    else if (server != nullptr)
+        rc = server->read (dest, numBytes, block);
+
+    stats.recordRead (rc);
+
+    if (rc > 0)
     {
-        return false;
+        const int64 receivedNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+        monitor.recordActivity (receivedNs);
+
+        if (capture.isOpen())
+            capture.append (receivedNs, dest, rc);
     }
 
-    return true;
+    return rc;
 }
 
-void SocketThread::attemptToReconnect()
+int SocketThread::receiveDatagrams()
 {
-    auto previousHeader = EphysSocketHeader (num_bytes, depth, element_size, num_samp, num_channels);
+    const int rc = datagrams.receive (datagramSocket->getRawSocketHandle());
 
-    if (connectSocket (previousPort, false))
+    int numBytes = 0;
+
+    for (int i = 0; i < rc; i++)
+        numBytes += datagrams.getSize (i);
+
+    stats.recordRead (numBytes);
+
+    if (rc > 0)
     {
-        shouldReconnect = false;
+        const int64 receivedNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+        monitor.recordActivity (receivedNs);
 
-        if (! compareHeaders (previousHeader))
+        if (capture.isOpen())
         {
-            disconnectSocket();
-            LOGE ("Mismatched header, disconnecting socket.");
-            CoreServices::sendStatusMessage ("Ephys Socket: Invalid header, disconnecting.");
-            error_flag = true;
-            return;
+            for (int i = 0; i < rc; i++)
+                capture.append (receivedNs, datagrams.getData (i), datagrams.getSize (i));
         }
+    }
 
-        LOGD ("Successfully reconnected the socket.");
-        CoreServices::sendStatusMessage ("Ephys Socket: Socket reconnected.");
-        lastPacketReceived = time (nullptr);
+    return rc;
+}
+
+int SocketThread::waitForData()
+{
+    if (lowLatency && cpu >= 0 && ! replay.isOpen())
+    {
+        // Polling keeps the thread on its CPU, so a packet is read as soon as it lands rather than after a wake-up.
+        // Only done on a CPU of its own, where the real-time thread can't starve others.
+        const auto spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds (LOW_LATENCY_SPIN_US);
+
+        do
+        {
+            const int ready = waitForSource (0);
+
+            if (ready != 0)
+                return ready;
+        } while (std::chrono::steady_clock::now() < spinEnd);
+    }
+
+    const auto waitStart = std::chrono::steady_clock::now();
+
+    const int timeoutMs = replay.isOpen() ? READ_TIMEOUT_MS : monitor.getWaitMs (std::chrono::duration_cast<std::chrono::nanoseconds> (waitStart.time_since_epoch()).count(), READ_TIMEOUT_MS);
+    const int ready = waitForSource (timeoutMs);
+
+    if (ready == 0)
+    {
+        // The poll timed out: how late the thread woke up past the timeout is its wake-up latency
+        const int64 oversleep = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now() - waitStart).count() - timeoutMs * 1000;
+        recordWakeLatency (jmax ((int64) 0, oversleep));
+    }
+
+    return ready;
+}
+
+void SocketThread::configureSocket()
+{
+    const intptr_t handle = getSocketHandle();
+
+    if (handle < 0)
+    {
+        return;
+    }
+
+    if ((socket != nullptr || server != nullptr) && lowLatency && ! (setTcpNoDelay (handle) && setTcpQuickAck (handle)))
+    {
+        LOGD ("Ephys Socket could not turn off delayed TCP acknowledgements on this platform");
+    }
+
+    // A sender on its own box can lose power without closing the connection; keepalive probes notice
+    if (server != nullptr && ! (setTcpNoDelay (handle) && setTcpKeepAlive (handle, KEEPALIVE_IDLE_SECONDS, KEEPALIVE_INTERVAL_SECONDS)))
+    {
+        LOGD ("Ephys Socket could not set the TCP options of the server connection");
+    }
+
+    if (processor->receive_buffer > 0)
+    {
+        setReceiveBufferSize (handle, processor->receive_buffer * 1024);
+        LOGD ("Ephys Socket receive buffer is ", getReceiveBufferSize (handle), " bytes");
+    }
+}
+
+void SocketThread::configureThread()
+{
+    Thread::setCurrentThreadName (name);
+
+    if (lowLatency && ! raiseThreadPriority())
+    {
+        LOGC ("Ephys Socket could not raise the priority of ", name, "; the process needs real-time scheduling rights");
+    }
+
+    if (cpu >= 0 && ! pinThreadToCpu (cpu))
+    {
+        LOGC ("Ephys Socket could not keep ", name, " on CPU ", cpu);
     }
 }
 
+void SocketThread::closeSocket()
+{
+    if (socket != nullptr)
+    {
+        socket->close();
+        socket.reset();
+    }
+
+    if (datagramSocket != nullptr)
+    {
+        if (joinedGroup.isNotEmpty())
+            datagramSocket->leaveMulticast (joinedGroup);
+
+        datagramSocket->shutdown();
+        datagramSocket.reset();
+    }
+
+    if (server != nullptr)
+    {
+        server->disconnect();
+    }
+
+    if (localSocket != nullptr)
+    {
+        localSocket->close();
+        localSocket.reset();
+    }
+
+    if (sharedMemory != nullptr)
+    {
+        if (sharedMemory->getNumDropped() > 0)
+            LOGC ("Ephys Socket: the sender dropped ", sharedMemory->getNumDropped(), " packets the shared-memory ring had no room for");
+
+        sharedMemory->close();
+        sharedMemory.reset();
+    }
+
+    replay.close();
+
+    streamBuffer.clear();
+    datagrams.clear();
+
+    joinedGroup = String();
+}
+
+void SocketThread::disconnectSocket()
+{
+    // The sockets belong to the thread while it runs
+    stopThread (1000);
+
+    if (socket != nullptr || server != nullptr || isOpen())
+    {
+        LOGD ("Disconnecting socket.");
+
+        closeSocket();
+        server.reset();
+
+        CoreServices::sendStatusMessage ("Ephys Socket: Disconnected.");
+    }
+
+    if (capture.isOpen())
+    {
+        LOGC ("Ephys Socket captured ", capture.getNumRecords(), " reads (", capture.getNumBytes(), " bytes) to ", settings.capture_file, capture.getNumDropped() > 0 ? ", dropping " + String (capture.getNumDropped()) + " the disk could not keep up with" : String());
+        capture.close();
+    }
+
+    state = DISCONNECTED;
+    wasConnected = false;
+}
+
+void SocketThread::setIndex (int newIndex)
+{
+    jassert (! isThreadRunning());
+
+    index = newIndex;
+    name = "socket_thread_" + String (index + 1);
+}
+
+bool SocketThread::isConnected() const
+{
+    return state == CONNECTED || state == STALLED;
+}
+
+bool SocketThread::isError() const
+{
+    return error_flag;
+}
+
+bool SocketThread::compareHeaders (EphysSocketHeader header) const
+{
+    if (header.depth != depth || header.element_size != element_size || header.num_channels != num_channels || header.num_samp != num_samp || header.isExtended() != (header_size > HEADER_SIZE))
+    {
+        return false;
+    }
+
+    return true;
+}
+
 void SocketThread::run()
 {
+    configureThread();
+
     while (! threadShouldExit())
     {
-        if (connected)
+        const ConnectionState current = state;
+
+        if (current == CONNECTED || current == STALLED)
         {
             if (error_flag)
             {
-                const MessageManagerLock mmLock;
-                processor->disconnectSocket();
-                return;
+                setState (FAILED); // The processor then disconnects every stream, on the message thread
+                continue;
             }
 
-            std::lock_guard<std::mutex> lock (socketMutex);
+            const bool queueing = acquiring;
+
+            if (replay.isOpen() && ! queueing)
+            {
+                wait (READ_TIMEOUT_MS);
+                continue;
+            }
 
-            const int bytes_expected = num_channels * num_samp * element_size + HEADER_SIZE;
+            if (resumePending.exchange (false))
+                replay.resume();
 
-            int rc;
             EphysSocketHeader header;
 
-            if (socket != nullptr && socket->isConnected())
+            std::byte* packet = queueing ? packets.beginWrite() : nullptr;
+
+            if (packet == nullptr && replay.isOpen())
             {
-                rc = socket->read (read_buffer.data(), bytes_expected, false);
+                wait (1);
+                continue;
+            }
+
+            if (packet == nullptr)
+            {
+                if (queueing && ! queueFull)
+                {
+                    LOGE ("Ephys Socket: Packet queue is full, dropping packets");
+                    queueFull = true;
+                }
+
+                packet = read_buffer.data();
             }
             else
             {
-                rc = 0; // NB: This will attempt to reconnect the socket below
+                queueFull = false;
             }
 
-            if (rc == -1)
+            ReadStatus status = STREAM_CLOSED;
+
+            if (isDatagramSource())
+                status = readDatagrams (packet);
+            else if (isOpen())
+                status = frameReader.readPacket (streamBuffer, packet);
+
+            if (status == READ_ERROR)
             {
-                if (socket->getRawSocketHandle() == -1)
+                if (replay.isOpen())
                 {
-                    CoreServices::sendStatusMessage ("Ephys Socket: Socket handle invalid.");
-                    LOGE ("Ephys Socket: Socket handle is invalid");
+                    CoreServices::sendStatusMessage ("Ephys Socket: Capture read error");
+                    LOGE ("Ephys Socket: Reading from the capture file did not complete");
                     error_flag = true;
                     continue;
                 }
-                else
+                else if (sharedMemory == nullptr && getSocketHandle() == -1)
                 {
-                    CoreServices::sendStatusMessage ("Ephys Socket: Socket read error");
-                    LOGE ("Ephys Socket: Reading from socket did not complete");
+                    CoreServices::sendStatusMessage ("Ephys Socket: Socket handle invalid.");
+                    LOGE ("Ephys Socket: Socket handle is invalid");
                     error_flag = true;
                     continue;
                 }
+
+                // A sender that is killed resets the connection rather than closing it, so it is reconnected the same way
+                LOGC ("Ephys Socket: Reading from socket did not complete");
+                status = STREAM_CLOSED;
             }
-            else if (rc == 0)
-            {
-                if (difftime (time (nullptr), lastPacketReceived) >= 2)
-                {
-                    LOGD ("Last packet was too old.");
 
-                    socket->close();
-                    socket.reset();
+            if (status == NO_DATA)
+            {
+                continue;
+            }
+            else if (status == STREAM_CLOSED && replay.isOpen())
+            {
+                LOGC ("Ephys Socket replayed ", replay.getNumRecords(), " records from ", settings.replay_file);
+                CoreServices::sendStatusMessage ("Ephys Socket: Replay finished.");
 
-                    connected = false;
-                    shouldReconnect = true;
+                closeSocket();
 
-                    LOGC ("EphysSocket has been disconnected. Attempting to reconnect now.");
-                    CoreServices::sendStatusMessage ("Ephys Socket: Attempting to reconnect...");
-                }
+                setState (DISCONNECTED);
 
                 continue;
             }
-            else if (rc != bytes_expected)
+            else if (status == STREAM_CLOSED)
             {
-                int bytes_received = rc;
+                LOGD ("Stream closed or last packet was too old.");
 
-                while (bytes_received < bytes_expected)
-                {
-                    rc = socket->read (read_buffer.data() + bytes_received, bytes_expected - bytes_received, false);
+                closeSocket();
 
-                    if (rc != 0)
-                    {
-                        bytes_received += rc;
-                    }
+                LOGC ("EphysSocket has been disconnected. Attempting to reconnect now.");
+                CoreServices::sendStatusMessage ("Ephys Socket: Attempting to reconnect...");
 
-                    if (threadShouldExit())
-                    {
-                        return;
-                    }
-                }
+                setState (CONNECTING);
+
+                continue;
             }
 
-            header = EphysSocketHeader (read_buffer);
+            const int64 arrivalNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
 
-            if (! compareHeaders (header))
+            header = EphysSocketHeader (packet);
+
+            if (status == INVALID_HEADER || ! compareHeaders (header))
             {
+                stats.recordHeaderMismatch();
+
                 CoreServices::sendStatusMessage ("Ephys Socket: Invalid header");
                 LOGE ("Ephys Socket: Header values have changed since first connecting");
                 error_flag = true;
                 continue;
             }
 
-            lastPacketReceived = time (nullptr);
+            if (state == STALLED)
+            {
+                LOGD ("Ephys Socket: ", name, " is receiving again");
+                setState (CONNECTED);
+            }
+
+            stats.recordPacket (arrivalNs, clock.getPacketPeriod());
+
+            if (sequenceResetPending.exchange (false))
+            {
+                sequence.reset ((int64) (settings.sample_rate * SEQUENCE_RESYNC_SECONDS));
+                pendingMissingSamples = 0;
+                lastNumDropped = frameReader.getAssembler().getNumDropped();
+                reconnected = false;
+            }
+
+            int64 missingSamples = 0;
+
+            if (header.isExtended() && header.parseExtension (packet))
+            {
+                const SequenceTracker::Result order = sequence.check (header.sample_index, num_samp);
+
+                if (order == SequenceTracker::DUPLICATE || order == SequenceTracker::LATE)
+                    continue;
+
+                if (order == SequenceTracker::GAP)
+                    missingSamples = sequence.getLastGap();
+                else if (order == SequenceTracker::RESYNC && reconnected)
+                    missingSamples = estimateMissingSamples (arrivalNs); // The sender restarted, so only the downtime tells what was lost
+
+                reconnected = false;
+
+                if (header.sender_time_ns > 0)
+                {
+                    const int64 arrivalUnixNs = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::system_clock::now().time_since_epoch()).count();
+                    recordOneWayLatency ((arrivalUnixNs - header.sender_time_ns) / 1000);
+                }
+            }
+            else
+            {
+                missingSamples = estimateMissingSamples (arrivalNs);
+            }
+
+            lastArrivalNs = arrivalNs;
+
+            clock.skip ((int) ((missingSamples + num_samp / 2) / num_samp));
+
+            const double firstSampleTime = recoverClock (arrivalNs);
+
+            if (! queueing)
+            {
+                continue;
+            }
 
-            if (acquiring)
+            if (packet == read_buffer.data())
+            {
+                pendingMissingSamples += missingSamples + num_samp;
+                stats.recordQueueFull();
+            }
+            else
+            {
+                PacketInfo& info = packets.getWriteInfo();
+                info.arrivalNs = arrivalNs;
+                info.firstSampleTime = firstSampleTime;
+                info.samplePeriod = clock.getSamplePeriod();
+                info.sampleIndex = header.sample_index;
+                info.senderTimeNs = header.sender_time_ns;
+                info.missingSamples = pendingMissingSamples + missingSamples;
+
+                pendingMissingSamples = 0;
+
+                packets.finishWrite();
+                packetsReady.signal();
+            }
+        }
+        else if (current == CONNECTING)
+        {
+            if (openSource())
+            {
+                setState (WAITING_FOR_HEADER);
+            }
+            else if (settings.transport == REPLAY || (settings.transport == UNIX_SOCKET && ! LocalSocket::isSupported()))
+            {
+                CoreServices::sendStatusMessage ("Ephys Socket: Could not connect.");
+                error_flag = true;
+                setState (FAILED);
+            }
+            else if (settings.transport != TCP_SERVER || server == nullptr)
             {
-                data.add (read_buffer);
+                const int delayMs = monitor.recordFailedAttempt();
+                processor->connectionStateChanged();
+
+                wait (delayMs);
             }
         }
-        else if (shouldReconnect)
+        else if (current == WAITING_FOR_HEADER)
         {
-            attemptToReconnect();
+            std::byte header_bytes[HEADER_SIZE + MAX_EXTENSION_SIZE];
+            int numRead = 0;
 
-            if (error_flag)
+            ReadStatus status = readFirstHeader (header_bytes, numRead);
+            bool mismatched = false;
+
+            if (status == PACKET_READY)
+            {
+                status = startStream (header_bytes);
+                mismatched = status == INVALID_HEADER;
+            }
+
+            if (status == PACKET_READY)
             {
-                const MessageManagerLock mmLock;
-                processor->disconnectSocket();
-                return;
+                LOGC (wasConnected ? "EphysSocket reconnected." : "EphysSocket connected.");
+                CoreServices::sendStatusMessage (wasConnected ? "Ephys Socket: Socket reconnected." : "Ephys Socket: Socket connected.");
+
+                wasConnected = true;
+                setState (CONNECTED);
             }
+            else if (mismatched || (status != NO_DATA && settings.transport == REPLAY))
+            {
+                LOGE (mismatched ? "Mismatched header, disconnecting socket." : "Ephys Socket could not read a header from the capture file");
+                CoreServices::sendStatusMessage (mismatched ? "Ephys Socket: Invalid header, disconnecting." : "Ephys Socket: Could not read stream.");
+
+                closeSocket();
+
+                error_flag = true;
+                setState (FAILED);
+            }
+            else if (status != NO_DATA)
+            {
+                if (status == INVALID_HEADER)
+                {
+                    LOGC ("EphysSocket could not read header from stream; reconnecting.");
+                    CoreServices::sendStatusMessage ("Ephys Socket: Could not read stream.");
+                }
+
+                closeSocket();
+
+                const int delayMs = monitor.recordFailedAttempt();
+                setState (CONNECTING);
+
+                wait (delayMs);
+            }
+        }
+        else
+        {
+            wait (READ_TIMEOUT_MS);
+        }
+    }
+}
+
+ReadStatus SocketThread::readSome (std::byte* dest, int maxBytes, int& numRead, bool midFragment)
+{
+    while (true)
+    {
+        const int ready = waitForData();
+
+        if (ready < 0)
+        {
+            return READ_ERROR;
+        }
+
+        if (ready == 0)
+        {
+            if (threadShouldExit())
+            {
+                return NO_DATA;
+            }
+
+            if (! replay.isOpen() && checkForStall())
+            {
+                return STREAM_CLOSED;
+            }
+
+            if (! midFragment)
+            {
+                return NO_DATA;
+            }
+
+            continue;
+        }
+
+        const int rc = readSource (dest, maxBytes, false);
+
+        if (rc < 0)
+        {
+            return READ_ERROR;
+        }
+
+        if (rc == 0)
+        {
+            return STREAM_CLOSED;
+        }
+
+        if (lowLatency && (socket != nullptr || server != nullptr))
+        {
+            setTcpQuickAck (getSocketHandle()); // The kernel goes back to delaying acknowledgements after every read
+        }
+
+        numRead = rc;
+
+        return PACKET_READY;
+    }
+}
+
+ReadStatus SocketThread::readDatagrams (std::byte* packet)
+{
+    PacketAssembler& assembler = frameReader.getAssembler();
+
+    while (! threadShouldExit())
+    {
+        const std::byte* batched = nullptr;
+        int batchedSize = 0;
+
+        if (datagrams.next (batched, batchedSize))
+        {
+            if (assembler.addFragment (batched, batchedSize, packet))
+                return PACKET_READY;
+
+            continue;
+        }
+
+        const int ready = waitForData();
+
+        if (ready < 0)
+        {
+            return READ_ERROR;
+        }
+
+        if (ready == 0)
+        {
+            if (! replay.isOpen() && checkForStall())
+            {
+                return STREAM_CLOSED;
+            }
+
+            return NO_DATA;
+        }
+
+        if (batchDatagrams)
+        {
+            if (receiveDatagrams() < 0)
+                return READ_ERROR;
+
+            continue;
         }
+
+        std::byte* datagram = assembler.isAssembling() ? datagram_buffer.data() : packet;
+        const int capacity = assembler.isAssembling() ? MAX_DATAGRAM_SIZE : (int) read_buffer.size();
+
+        const int rc = readSource (datagram, capacity, false);
+
+        if (rc < 0)
+        {
+            return READ_ERROR;
+        }
+
+        if (rc == 0 && replay.isFinished())
+        {
+            return STREAM_CLOSED;
+        }
+
+        if (assembler.addFragment (datagram, rc, packet))
+        {
+            return PACKET_READY;
+        }
+    }
+
+    return NO_DATA;
+}
+
+int64 SocketThread::estimateMissingSamples (int64 arrivalNs)
+{
+    const int64 numDropped = frameReader.getAssembler().getNumDropped();
+    int64 missingPackets = jmax ((int64) 0, numDropped - lastNumDropped);
+    lastNumDropped = numDropped;
+
+    const double packetPeriod = clock.getPacketPeriod();
+
+    if (reconnected.exchange (false))
+    {
+        // Whatever the sender sent while the socket was down is lost
+        const double downtime = (arrivalNs - lastArrivalNs) * 1e-9;
+        missingPackets = jmax (missingPackets, (int64) std::llround (downtime / packetPeriod) - 1);
+    }
+    else if (isDatagramSource())
+    {
+        // A lost datagram makes the next one late by a packet period. If more datagrams are already
+        // waiting, this thread fell behind instead, and the burst that follows would cancel the lateness.
+        const double lateness = clock.getLateness (arrivalNs * 1e-9);
+
+        if (lateness > GAP_LATENESS_PACKETS * packetPeriod && lateness > GAP_LATENESS_SECONDS && ! datagrams.hasPending() && waitForSource (0) == 0)
+        {
+            missingPackets = jmax (missingPackets, (int64) std::llround (lateness / packetPeriod));
+        }
+    }
+
+    return missingPackets * num_samp;
+}
+
+double SocketThread::recoverClock (int64 arrivalNs)
+{
+    if (clockResetPending.exchange (false))
+    {
+        clock.reset (settings.sample_rate, num_samp);
+        driftReported = false;
+    }
+
+    const double firstSampleTime = clock.update (arrivalNs * 1e-9);
+
+    estimatedSampleRate = clock.getSampleRate();
+    clockDriftPpm = clock.getDriftPpm();
+    clockLocked = clock.isLocked();
+
+    if (clockLocked && ! driftReported && std::abs (clockDriftPpm.load()) > DRIFT_TOLERANCE_PPM)
+    {
+        LOGC ("Ephys Socket: sender sample rate is ", estimatedSampleRate.load(), " Hz, ", clockDriftPpm.load(), " ppm from the configured ", settings.sample_rate, " Hz");
+        CoreServices::sendStatusMessage ("Ephys Socket: Sample rate drift detected");
+        driftReported = true;
+    }
+
+    return firstSampleTime;
+}
+
+void SocketThread::recordWakeLatency (int64 latencyUs)
+{
+    numWakeups++;
+    totalWakeLatencyUs += latencyUs;
+
+    if (latencyUs > maxWakeLatencyUs)
+    {
+        maxWakeLatencyUs = latencyUs;
     }
 }
+
+void SocketThread::recordOneWayLatency (int64 latencyUs)
+{
+    numLatencies++;
+    totalLatencyUs += latencyUs;
+
+    if (latencyUs > maxLatencyUs)
+    {
+        maxLatencyUs = latencyUs;
+    }
+}
+
+double SocketThread::getMeanOneWayLatencyUs() const
+{
+    const int64 latencies = numLatencies;
+
+    return latencies > 0 ? (double) totalLatencyUs / latencies : 0.0;
+}
+
+int64 SocketThread::getMaxOneWayLatencyUs() const
+{
+    return maxLatencyUs;
+}
+
+double SocketThread::getMeanWakeLatencyUs() const
+{
+    const int64 wakeups = numWakeups;
+
+    return wakeups > 0 ? (double) totalWakeLatencyUs / wakeups : 0.0;
+}
+
+int64 SocketThread::getMaxWakeLatencyUs() const
+{
+    return maxWakeLatencyUs;
+}
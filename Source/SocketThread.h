@@ -24,7 +24,21 @@
 #ifndef __SOCKET_H__
 #define __SOCKET_H__
 
+#include "ClockRecovery.h"
+#include "ConnectionMonitor.h"
+#include "DatagramBatch.h"
 #include "EphysSocketHeader.h"
+#include "FrameReader.h"
+#include "LocalSocket.h"
+#include "LowLatency.h"
+#include "PacketCapture.h"
+#include "PacketRing.h"
+#include "SequenceTracker.h"
+#include "SharedMemoryRing.h"
+#include "StreamBuffer.h"
+#include "StreamSettings.h"
+#include "StreamStats.h"
+#include "TcpServer.h"
 #include <DataThreadHeaders.h>
 
 #include <atomic>
@@ -33,10 +47,11 @@ namespace EphysSocketNode
 {
 class EphysSocket;
 
-class SocketThread : public Thread
+class SocketThread : public Thread,
+                     private ChunkSource
 {
 public:
-    SocketThread (String name, EphysSocket* processor);
+    SocketThread (String name, int index, EphysSocket* processor, const StreamSettings& settings, WaitableEvent& packetsReady);
 
     ~SocketThread();
 
@@ -46,18 +61,63 @@ public:
     /** Stops probe data streaming*/
     void stopAcquisition();
 
-    /** Attempts to connect to the socket */
-    bool connectSocket (int port, bool printOutput = true);
+    /** Starts connecting in the background, and returns false only if the port is invalid or the thread is already running.
+        The thread connects to the socket (TCP), accepts the sender's connection (TCP server), binds to the port (UDP)
+        or opens the capture file (REPLAY), retrying with a growing delay until it succeeds, then waits for the first
+        header. Starts capturing if a capture file is set, and applies the processor's low-latency, receive buffer and
+        CPU settings. Every change of state is reported to the processor. */
+    bool connectSocket (int port);
 
-    /** Disconnects the socket */
+    /** Stops the thread, which owns the sockets while it runs, and disconnects the socket */
     void disconnectSocket();
 
+    /** Moves the stream to a new position after another stream is removed, while it is disconnected */
+    void setIndex (int newIndex);
+
     /** Returns if any errors were thrown during acquisition, such as invalid headers or unable to read from socket */
     bool isError() const;
 
-    bool isConnected();
+    /** Returns true once the first header has been read, while packets are being received */
+    bool isConnected() const;
+
+    /** Where the connection stands, and its attempts, backoff and stall timing */
+    ConnectionState getConnectionState() const { return state; }
+    const ConnectionMonitor& getMonitor() const { return monitor; }
+
+    /** Returns the number of slots in the packet queue, once the first header has sized it */
+    int getNumQueueSlots() const { return numQueueSlots; }
+
+    /** Returns true if the thread has connected since connectSocket() was called, so it is reconnecting now */
+    bool hasConnected() const { return wasConnected; }
+
+    /** Fragment reassembly counters for the current acquisition */
+    const PacketAssembler& getAssembler() const { return frameReader.getAssembler(); }
+
+    /** Sender sample rate recovered from packet arrivals, and its drift from the configured rate */
+    double getEstimatedSampleRate() const { return estimatedSampleRate; }
+    double getClockDriftPpm() const { return clockDriftPpm; }
+    bool isClockLocked() const { return clockLocked; }
+
+    /** Wake-up latency of the receive loop, measured on poll timeouts */
+    double getMeanWakeLatencyUs() const;
+    int64 getMaxWakeLatencyUs() const;
+
+    /** Lost, duplicate and late packets, from the sample index of extended headers */
+    const SequenceTracker& getSequence() const { return sequence; }
+
+    /** Time from the sender's timestamp to the packet's arrival, from extended headers.
+        Only meaningful if the sender's clock is synchronised with this computer's (e.g. over PTP). */
+    double getMeanOneWayLatencyUs() const;
+    int64 getMaxOneWayLatencyUs() const;
 
-    Array<std::vector<std::byte>, CriticalSection, 10> data;
+    /** Raw bytes captured since connecting, if a capture file is set */
+    const CaptureWriter& getCapture() const { return capture; }
+
+    /** Packets (header + matrix) received during acquisition, waiting to be converted */
+    PacketRing packets;
+
+    /** Health of the stream during the current acquisition: this thread records what it receives, the DataThread what it converts */
+    StreamStats stats;
 
     /** Variables that are part of the incoming header */
     int num_bytes;
@@ -66,6 +126,13 @@ public:
     int num_samp;
     int num_channels;
 
+    /** Size of the header in front of every packet, including the extension if the sender adds one */
+    int header_size;
+
+    /** Digital rows at the end of the matrix and lines per row, as announced by the extension (0 rows if it doesn't) */
+    int ttl_rows;
+    int ttl_bits;
+
 private:
     /** Default socket parameters */
     const int DEFAULT_NUM_SAMPLES = 256;
@@ -74,31 +141,223 @@ private:
     const int DEFAULT_NUM_BYTES = 32678; // NB: 256 * 64 * 2
     const int DEFAULT_ELEMENT_SIZE = 2;
 
+    /** Longest the receive loop waits for the source before checking whether it should exit */
+    const int READ_TIMEOUT_MS = 50;
+
+    /** How long a connection attempt waits for the sender, as a client (TCP) or a server (TCP server) */
+    const int CONNECT_TIMEOUT_MS = 250;
+
+    /** Receive buffer of a TCP server when none is configured: large enough that a sender streaming
+        over a real network never waits on the window */
+    const int SERVER_RECEIVE_BUFFER = 4 << 20;
+
+    /** Keepalive probing of a TCP server's connection, so a sender that lost power is dropped */
+    const int KEEPALIVE_IDLE_SECONDS = 5;
+    const int KEEPALIVE_INTERVAL_SECONDS = 1;
+
+    /** How long the receive loop polls the socket without sleeping in low-latency mode, before it waits in the kernel */
+    const int LOW_LATENCY_SPIN_US = 500;
+
+    /** Largest datagram that can be received, including its header */
+    const int MAX_DATAGRAM_SIZE = 65536;
+
+    /** A TCP stream is read in chunks of up to this many bytes, which may hold many packets */
+    const int STREAM_BUFFER_SIZE = 256 * 1024;
+
+    /** Datagrams up to this size are received in batches of up to DATAGRAM_BATCH_SIZE per system call;
+        larger ones are received one at a time, straight into their packet */
+    const int DATAGRAM_BATCH_THRESHOLD = 8192;
+    const int DATAGRAM_BATCH_SIZE = 32;
+
+    /** Jump in the sample index, either way, taken as the sender restarting rather than as loss */
+    const float SEQUENCE_RESYNC_SECONDS = 10.0f;
+
+    /** Lateness past the recovered clock's prediction, in packets and at least in seconds, that a
+        datagram stream without sample indices takes as lost datagrams rather than jitter */
+    const double GAP_LATENESS_PACKETS = 0.75;
+    const double GAP_LATENESS_SECONDS = 0.005;
+
+    /** Recovered rate drift from the configured sample rate that gets reported */
+    const double DRIFT_TOLERANCE_PPM = 1000.0;
+
+    /** Packet queue sizing */
+    const int MIN_QUEUE_SLOTS = 8;
+    const float QUEUE_SIZE_IN_SECONDS = 1.0f;
+
     void run() override;
 
+    /** Sleeps until the socket is readable and reads whatever has arrived on the TCP stream, up to maxBytes */
+    ReadStatus readSome (std::byte* dest, int maxBytes, int& numRead, bool midFragment) override;
+
+    /** Sleeps until a datagram arrives and reassembles datagrams until a whole packet is complete */
+    ReadStatus readDatagrams (std::byte* packet);
+
+    /** Receives the datagrams waiting on the UDP socket into the batch; returns their number or -1 on an error */
+    int receiveDatagrams();
+
+    /** Opens the socket, server connection, ring or replay for the stream's transport; returns false to retry later */
+    bool openSource();
+
+    /** Reads the first header, and its extension if it has one, from a newly opened source, setting numRead to its size.
+        Returns NO_DATA if nothing has arrived yet, and INVALID_HEADER if what arrived is not a header. */
+    ReadStatus readFirstHeader (std::byte* header_bytes, int& numRead);
+
+    /** Takes on the first header read from the source and skips the rest of its packet, so the stream is aligned.
+        Returns INVALID_HEADER if it does not match the header of an earlier connection. */
+    ReadStatus startStream (const std::byte* header_bytes);
+
+    /** Reads exactly numBytes from a byte stream. Returns NO_DATA if nothing has arrived in time, unless midPacket is set,
+        and STREAM_CLOSED if the sender hangs up or stays silent past the lost timeout. */
+    ReadStatus readExactly (std::byte* dest, int numBytes, bool midPacket);
+
+    /** Checks how long the sender has been silent; reports a stall, and returns true once the stream is lost */
+    bool checkForStall();
+
+    /** Sets the connection state and lets the processor know */
+    void setState (ConnectionState newState);
+
+    /** Returns true if a TCP, UDP or Unix socket, a shared-memory ring or a replayed capture is open */
+    bool isOpen() const;
+
+    /** Returns the native handle of the open socket, or -1 for a ring, a replay or no socket */
+    intptr_t getSocketHandle() const;
+
+    /** Closes and releases whichever socket is open */
+    void closeSocket();
+
+    /** Returns true if the source delivers datagrams rather than a byte stream */
+    bool isDatagramSource() const;
+
+    /** Waits up to timeoutMs until the open socket or replay has bytes to read (1), times out (0) or fails (-1) */
+    int waitForSource (int timeoutMs);
+
+    /** Reads from the open socket or replay, and appends what was read to the capture if one is open */
+    int readSource (std::byte* dest, int numBytes, bool block);
+
+    /** Waits for the source until the next stall deadline, and at most READ_TIMEOUT_MS, recording the wake-up latency
+        if it times out. In low-latency mode on a pinned CPU, polls without sleeping for LOW_LATENCY_SPIN_US first. */
+    int waitForData();
+
+    /** Applies the processor's socket options to a newly opened socket */
+    void configureSocket();
+
+    /** Raises the priority of this thread and pins it to its CPU, as configured when connecting */
+    void configureThread();
+
+    void recordWakeLatency (int64 latencyUs);
+
+    void recordOneWayLatency (int64 latencyUs);
+
+    /** Estimates the samples lost before a packet without a sample index: matrices the assembler
+        dropped, the time the socket was reconnecting, and datagrams that never arrived */
+    int64 estimateMissingSamples (int64 arrivalNs);
+
+    /** Feeds a packet's arrival to the clock recovery and returns the time of its first sample */
+    double recoverClock (int64 arrivalNs);
+
     /** Compares a newly parsed header to existing variables */
     bool compareHeaders (EphysSocketHeader header) const;
 
-    void attemptToReconnect();
-
     /** Pointer to the editor */
     EphysSocket* processor;
 
+    /** Settings of the stream this thread receives */
+    const StreamSettings& settings;
+
+    /** Position of the stream, which picks its CPU, and the name it is logged under */
+    int index;
+    String name;
+
+    /** Low-latency mode and CPU, copied from the processor when connecting */
+    bool lowLatency;
+    int cpu;
+
     /** TCP Socket object */
     std::unique_ptr<StreamingSocket> socket;
 
-    /** Mutex for thread safety */
-    std::mutex socketMutex;
+    /** UDP Socket object */
+    std::unique_ptr<DatagramSocket> datagramSocket;
+
+    /** Multicast group joined by the UDP socket, if any */
+    String joinedGroup;
+
+    /** Listening socket and accepted connection in TCP server mode, kept listening across reconnects */
+    std::unique_ptr<TcpServer> server;
+
+    /** Unix domain socket, or shared-memory ring, of a sender on this machine */
+    std::unique_ptr<LocalSocket> localSocket;
+    std::unique_ptr<SharedMemoryRing> sharedMemory;
+
+    /** Capture file played back in REPLAY mode */
+    ReplaySource replay;
+
+    /** Capture of the raw bytes received, kept open across reconnects */
+    CaptureWriter capture;
+
+    /** Frames the TCP stream and rebuilds matrices from fragmented packets or datagrams */
+    FrameReader frameReader;
+
+    /** Chunks read from the TCP stream (or a stream capture), which frameReader frames packets from */
+    StreamBuffer streamBuffer;
+
+    /** Small datagrams received together, waiting to be reassembled */
+    DatagramBatch datagrams;
+    bool batchDatagrams;
+
+    /** Held while the queue is resized or acquisition starts, so the queue never changes under the
+        DataThread; never held across a read, so starting acquisition doesn't wait on the sender */
+    std::mutex queueMutex;
+
+    /** Slots in the queue, published once it has been resized */
+    std::atomic<int> numQueueSlots;
+
+    /** Set when acquisition starts, so that a replay's pacing restarts before its next read */
+    std::atomic<bool> resumePending;
 
     /** Internal buffers */
     std::vector<std::byte> read_buffer;
+    std::vector<std::byte> datagram_buffer;
+
+    /** Connection state, set by this thread once connectSocket() has started it */
+    std::atomic<ConnectionState> state;
+    std::atomic<bool> wasConnected;
+
+    /** Backoff between attempts to connect, and stall detection once connected */
+    ConnectionMonitor monitor;
 
-    std::atomic<bool> connected;
-    std::atomic<bool> shouldReconnect;
     std::atomic<bool> acquiring;
     std::atomic<bool> error_flag;
 
-    std::time_t lastPacketReceived;
+    bool queueFull;
+
+    /** Signalled whenever a packet is published to the queue; shared by all streams */
+    WaitableEvent& packetsReady;
+
+    /** Sample clock recovery, run on this thread */
+    ClockRecovery clock;
+    std::atomic<bool> clockResetPending;
+    std::atomic<double> estimatedSampleRate;
+    std::atomic<double> clockDriftPpm;
+    std::atomic<bool> clockLocked;
+    bool driftReported;
+
+    /** Packet order tracking, run on this thread */
+    SequenceTracker sequence;
+    std::atomic<bool> sequenceResetPending;
+
+    /** Samples lost since the last queued packet, including packets dropped on a full queue */
+    int64 pendingMissingSamples;
+    int64 lastNumDropped;
+    int64 lastArrivalNs;
+    std::atomic<bool> reconnected;
+
+    std::atomic<int64> numLatencies;
+    std::atomic<int64> totalLatencyUs;
+    std::atomic<int64> maxLatencyUs;
+
+    std::atomic<int64> numWakeups;
+    std::atomic<int64> totalWakeLatencyUs;
+    std::atomic<int64> maxWakeLatencyUs;
 
     int previousPort;
 
@@ -0,0 +1,98 @@
+#ifndef __STREAMSETTINGSH__
+#define __STREAMSETTINGSH__
+
+#include <DataThreadHeaders.h>
+
+#include "ChannelMap.h"
+#include "DataConverter.h"
+#include "Decimator.h"
+
+namespace EphysSocketNode
+{
+/** Network protocol a stream is received over */
+enum Transport
+{
+    TCP, // client connection to the sender, one packet per matrix
+    UDP, // datagrams bound to the port, optionally from a multicast group
+    REPLAY, // a capture file, played back through the same receive path
+    UNIX_SOCKET, // client connection to a Unix domain socket of a sender on this machine, framed as TCP
+    SHARED_MEMORY, // shared-memory ring written by a sender on this machine, framed as TCP
+    TCP_SERVER // listens on the port and accepts the sender's connection, for senders that can only be clients
+};
+
+/** How fast a capture file is played back */
+enum ReplayPace
+{
+    RECORDED_PACE, // as the bytes arrived when they were captured
+    FAST_PACE // as fast as they can be read
+};
+
+/** What is pushed in place of samples that were lost on the way */
+enum GapFill
+{
+    NO_FILL, // nothing; sample numbers carry on as if no samples were lost
+    ZERO_FILL, // zeros
+    HOLD_FILL, // the last sample received on each channel
+    NAN_FILL // NaN, so downstream processing can tell the gap from data
+};
+
+/** Settings of one network stream (must match features of incoming data) */
+struct StreamSettings
+{
+    int port;
+    float sample_rate;
+    float data_scale;
+    float data_offset;
+    Layout layout;
+    Transport transport;
+    String multicast_group; // empty for unicast UDP
+    int ttl_rows; // digital rows at the end of each matrix, 0 if none
+    int ttl_bits; // digital lines per row, 0 for the element width
+    String channel_map; // file the channel table was loaded from, empty for none
+    ChannelMap channels; // per-channel names, types, scales and offsets
+    String capture_file; // file the received bytes are captured to, empty for none
+    String replay_file; // capture file received from in REPLAY mode
+    ReplayPace replay_pace;
+    String local_path; // Unix socket path or shared-memory name, empty to derive one from the port
+    float output_rate; // rate the stream is decimated to before the DataBuffer, 0 to keep sample_rate
+    String host; // host name or IPv4/IPv6 address, empty for the default of the transport (see getHost())
+
+    /** Returns the Unix socket path or shared-memory name to connect to for the transport */
+    String getLocalPath() const
+    {
+        if (local_path.isNotEmpty())
+            return local_path;
+
+        return transport == SHARED_MEMORY ? "/ephys-socket-" + String (port) : "/tmp/ephys-socket-" + String (port) + ".sock";
+    }
+
+    /** Returns the host the TCP client connects to, or the address of the interface the TCP server listens
+        on, which is empty to listen on all of them */
+    String getHost() const
+    {
+        const String address = host.trim().removeCharacters ("[]"); // IPv6 addresses are often written in brackets
+
+        if (address.isEmpty() && transport != TCP_SERVER)
+            return "localhost";
+
+        return address;
+    }
+
+    /** Returns the factor the stream is decimated by, the whole number that brings sample_rate closest to output_rate */
+    int getDecimation() const
+    {
+        if (output_rate <= 0.0f || output_rate >= sample_rate)
+            return 1;
+
+        return jlimit (1, Decimator::MAX_FACTOR, roundToInt (sample_rate / output_rate));
+    }
+
+    /** Returns the rate the stream's samples reach the DataBuffer at */
+    float getOutputSampleRate() const
+    {
+        return sample_rate / getDecimation();
+    }
+};
+} // namespace EphysSocketNode
+
+#endif
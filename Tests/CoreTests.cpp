@@ -0,0 +1,825 @@
+/*
+    Checks of the EphysSocket receiver core, run by ctest.
+
+    Each check is a function that returns false, after printing what went wrong,
+    if the core doesn't behave as the plugin relies on.
+*/
+
+#include "DataConverter.h"
+#include "Decimator.h"
+#include "DeltaCodec.h"
+#include "EphysSocketHeader.h"
+#include "FrameReader.h"
+#include "PacketRing.h"
+#include "SequenceTracker.h"
+#include "TtlDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+using namespace EphysSocketNode;
+
+#define EXPECT(condition)                                                     \
+    if (! (condition))                                                        \
+    {                                                                         \
+        std::printf ("%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+        return false;                                                         \
+    }
+
+namespace
+{
+/** A sender that restarts while the socket is down comes back at a lower index */
+bool sequenceResyncsAfterReconnect()
+{
+    SequenceTracker sequence;
+    sequence.reset (30000);
+
+    EXPECT (sequence.check (0, 256) == SequenceTracker::FIRST);
+    EXPECT (sequence.check (256, 256) == SequenceTracker::IN_ORDER);
+    EXPECT (sequence.check (512, 256) == SequenceTracker::IN_ORDER);
+
+    // Without a reconnect, an index that goes back is a late packet
+    EXPECT (sequence.check (256, 256) == SequenceTracker::LATE);
+
+    sequence.resync();
+
+    EXPECT (sequence.check (128, 256) == SequenceTracker::RESYNC);
+    EXPECT (sequence.check (384, 256) == SequenceTracker::IN_ORDER);
+    EXPECT (sequence.check (896, 256) == SequenceTracker::GAP);
+    EXPECT (sequence.getLastGap() == 256);
+    EXPECT (sequence.getNumResyncs() == 1);
+    EXPECT (sequence.getNumLate() == 1);
+
+    return true;
+}
+
+/** A sender that kept running while the socket was down is tracked as before */
+bool sequenceKeepsGapAfterReconnect()
+{
+    SequenceTracker sequence;
+    sequence.reset (30000);
+
+    EXPECT (sequence.check (0, 256) == SequenceTracker::FIRST);
+
+    sequence.resync();
+
+    EXPECT (sequence.check (1024, 256) == SequenceTracker::GAP);
+    EXPECT (sequence.getLastGap() == 768);
+
+    // The resync only applies to the first packet after the reconnect
+    EXPECT (sequence.check (512, 256) == SequenceTracker::LATE);
+    EXPECT (sequence.getNumResyncs() == 0);
+
+    return true;
+}
+
+/** Parses a header of the given fields, as the sender would write it */
+EphysSocketHeader parseHeader (int depth, int elementSize, int numSamples, int numChannels)
+{
+    std::byte bytes[HEADER_SIZE];
+    EphysSocketHeader (0, (Depth) depth, elementSize, numSamples, numChannels).write (bytes);
+
+    return EphysSocketHeader (bytes);
+}
+
+/** Hands out the bytes of a recorded stream, as a socket would */
+class MemorySource : public ByteSource
+{
+public:
+    void append (const std::byte* bytes, int numBytes) { data.insert (data.end(), bytes, bytes + numBytes); }
+
+    /** Appends a packet of the given header and a payload of numBytes bytes counting up from first */
+    void appendPacket (const EphysSocketHeader& header, int numBytes, int first)
+    {
+        std::byte bytes[HEADER_SIZE];
+        header.write (bytes);
+        append (bytes, HEADER_SIZE);
+
+        for (int i = 0; i < numBytes; i++)
+            data.push_back ((std::byte) (first + i));
+    }
+
+    ReadStatus read (std::byte* dest, int numBytes, bool midFragment) override
+    {
+        if (position == data.size() && ! midFragment)
+            return NO_DATA;
+
+        if (data.size() - position < (size_t) numBytes)
+            return STREAM_CLOSED;
+
+        std::memcpy (dest, data.data() + position, (size_t) numBytes);
+        position += (size_t) numBytes;
+
+        return PACKET_READY;
+    }
+
+private:
+    std::vector<std::byte> data;
+    size_t position = 0;
+};
+
+/** Returns true if the matrix of packet counts up from first */
+bool matrixCountsFrom (const std::byte* packet, int matrixSize, int first)
+{
+    for (int i = 0; i < matrixSize; i++)
+    {
+        if (packet[HEADER_SIZE + i] != (std::byte) (first + i))
+            return false;
+    }
+
+    return true;
+}
+
+/** Senders that predate fragmentation may leave num_bytes unset; their packets carry whole matrices */
+bool legacyPacketsAreFramedAsWholeMatrices()
+{
+    const int matrixSize = 4 * 8 * 2;
+
+    EphysSocketHeader unset (0, U16, 2, 8, 4);
+    EphysSocketHeader tooLarge (100000, U16, 2, 8, 4);
+    EphysSocketHeader exact (matrixSize, U16, 2, 8, 4);
+
+    EXPECT (unset.getPayloadSize (matrixSize) == matrixSize);
+    EXPECT (tooLarge.getPayloadSize (matrixSize) == matrixSize);
+    EXPECT (exact.getPayloadSize (matrixSize) == matrixSize);
+
+    MemorySource source;
+    source.appendPacket (unset, matrixSize, 0);
+    source.appendPacket (tooLarge, matrixSize, 1);
+    source.appendPacket (exact, matrixSize, 2);
+
+    FrameReader reader;
+    reader.reset (matrixSize);
+
+    std::vector<std::byte> packet (HEADER_SIZE + matrixSize);
+
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT (reader.readPacket (source, packet.data()) == PACKET_READY);
+        EXPECT (matrixCountsFrom (packet.data(), matrixSize, i));
+    }
+
+    EXPECT (reader.readPacket (source, packet.data()) == NO_DATA);
+    EXPECT (reader.getAssembler().getNumInvalid() == 0);
+
+    return true;
+}
+
+/** The ring holds numSlots packets, hands them out in order across the wrap and refuses more when full */
+bool packetRingWrapsAndFills()
+{
+    const int headerSize = HEADER_SIZE;
+
+    PacketRing ring;
+    ring.resize (4, 64, headerSize);
+
+    EXPECT (ring.getNumSlots() == 4);
+    EXPECT (ring.beginRead() == nullptr);
+
+    int written = 0;
+    int read = 0;
+
+    // Fill, drain half, and fill again, so the writes wrap around the end twice
+    for (int round = 0; round < 3; round++)
+    {
+        while (std::byte* slot = ring.beginWrite())
+        {
+            EXPECT ((reinterpret_cast<uintptr_t> (slot) + headerSize) % PacketRing::PAYLOAD_ALIGNMENT == 0);
+
+            std::memset (slot, written, 64);
+            ring.getWriteInfo().sampleIndex = written;
+            ring.finishWrite();
+            written++;
+        }
+
+        EXPECT (ring.getNumReady() == 4);
+        EXPECT (ring.peek (3) != nullptr);
+        EXPECT (ring.peek (4) == nullptr);
+
+        for (int i = 0; i < 2; i++)
+        {
+            const std::byte* slot = ring.beginRead();
+            EXPECT (slot != nullptr);
+            EXPECT (slot[0] == (std::byte) read && slot[63] == (std::byte) read);
+            EXPECT (ring.getReadInfo().sampleIndex == read);
+
+            ring.finishRead();
+            read++;
+        }
+
+        EXPECT (ring.getNumReady() == 2);
+    }
+
+    EXPECT (written == 8);
+    EXPECT (ring.getReadInfo (1).sampleIndex == read + 1);
+
+    ring.clear();
+
+    EXPECT (ring.getNumReady() == 0);
+    EXPECT (ring.beginRead() == nullptr);
+    EXPECT (ring.beginWrite() != nullptr);
+
+    return true;
+}
+
+/** Builds the fragment of a matrix of matrixSize bytes that counts up from first, for datagram reassembly */
+std::vector<std::byte> makeFragment (int matrixSize, int offset, int numBytes, int first)
+{
+    EphysSocketHeader header (numBytes, U8, 1, matrixSize, 1);
+    header.offset = offset;
+
+    std::vector<std::byte> fragment (HEADER_SIZE + numBytes);
+    header.write (fragment.data());
+
+    for (int i = 0; i < numBytes; i++)
+        fragment[HEADER_SIZE + i] = (std::byte) (first + offset + i);
+
+    return fragment;
+}
+
+/** Fragments are joined in order; a missing, repeated or reordered one drops its matrix */
+bool assemblerDropsBrokenMatrices()
+{
+    const int matrixSize = 64;
+
+    PacketAssembler assembler;
+    assembler.reset (matrixSize);
+
+    std::vector<std::byte> packet (HEADER_SIZE + matrixSize);
+
+    const auto add = [&] (int offset, int numBytes, int first) {
+        const std::vector<std::byte> fragment = makeFragment (matrixSize, offset, numBytes, first);
+        return assembler.addFragment (fragment.data(), (int) fragment.size(), packet.data());
+    };
+
+    // In order
+    EXPECT (! add (0, 24, 0));
+    EXPECT (! add (24, 24, 0));
+    EXPECT (add (48, 16, 0));
+    EXPECT (matrixCountsFrom (packet.data(), matrixSize, 0));
+
+    // Joined mid-matrix: skipped without counting anything
+    EXPECT (! add (24, 24, 1));
+    EXPECT (! add (48, 16, 1));
+    EXPECT (assembler.getNumMissing() == 0 && assembler.getNumDropped() == 0);
+
+    // Reordered: the later fragment first means one went missing, and the earlier one is then skipped
+    EXPECT (! add (0, 24, 2));
+    EXPECT (! add (48, 16, 2));
+    EXPECT (! add (24, 24, 2));
+    EXPECT (assembler.getNumMissing() == 1 && assembler.getNumDropped() == 1);
+
+    // Repeated: a fragment behind the expected offset
+    EXPECT (! add (0, 24, 3));
+    EXPECT (! add (24, 24, 3));
+    EXPECT (! add (24, 24, 3));
+    EXPECT (assembler.getNumOutOfOrder() == 1 && assembler.getNumDropped() == 2);
+
+    // Partial: the next matrix starts before this one is complete
+    EXPECT (! add (0, 24, 4));
+    EXPECT (! add (0, 24, 5));
+    EXPECT (assembler.getNumMissing() == 2 && assembler.getNumDropped() == 3);
+    EXPECT (! add (24, 24, 5));
+    EXPECT (add (48, 16, 5));
+    EXPECT (matrixCountsFrom (packet.data(), matrixSize, 5));
+
+    // Truncated: a datagram shorter than its header says, or a payload past the end of the matrix
+    std::vector<std::byte> truncated = makeFragment (matrixSize, 0, 24, 6);
+    EXPECT (! assembler.addFragment (truncated.data(), (int) truncated.size() - 1, packet.data()));
+    EXPECT (! add (48, 24, 6));
+    EXPECT (assembler.getNumInvalid() == 2);
+
+    return true;
+}
+
+/** A fragmented TCP stream is framed into whole matrices, and a fragment cut short ends the stream */
+bool frameReaderJoinsFragments()
+{
+    const int matrixSize = 64;
+
+    MemorySource source;
+
+    for (int m = 0; m < 2; m++)
+    {
+        for (int offset = 0; offset < matrixSize; offset += 16)
+        {
+            const std::vector<std::byte> fragment = makeFragment (matrixSize, offset, 16, m);
+            source.append (fragment.data(), (int) fragment.size());
+        }
+    }
+
+    const std::vector<std::byte> cut = makeFragment (matrixSize, 0, 16, 2);
+    source.append (cut.data(), (int) cut.size() - 4);
+
+    FrameReader reader;
+    reader.reset (matrixSize);
+
+    std::vector<std::byte> packet (HEADER_SIZE + matrixSize);
+
+    for (int m = 0; m < 2; m++)
+    {
+        for (int f = 0; f < 3; f++)
+            EXPECT (reader.readPacket (source, packet.data()) == NO_DATA);
+
+        EXPECT (reader.readPacket (source, packet.data()) == PACKET_READY);
+        EXPECT (matrixCountsFrom (packet.data(), matrixSize, m));
+    }
+
+    EXPECT (reader.readPacket (source, packet.data()) == STREAM_CLOSED);
+
+    return true;
+}
+
+/** Fills numSamples samples of type T with values across its range */
+template <typename T>
+void fillSamples (std::byte* dest, int numSamples, std::mt19937& random)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        T value;
+
+        if constexpr (std::is_floating_point<T>::value)
+            value = (T) std::uniform_real_distribution<double> (-1e4, 1e4) (random);
+        else
+            value = (T) std::uniform_int_distribution<int64_t> (std::numeric_limits<T>::min(), std::numeric_limits<T>::max()) (random);
+
+        std::memcpy (dest + (size_t) i * sizeof (T), &value, sizeof (T));
+    }
+}
+
+void fillSamples (Depth depth, std::byte* dest, int numSamples, std::mt19937& random)
+{
+    switch (depth)
+    {
+        case U8:
+            fillSamples<uint8_t> (dest, numSamples, random);
+            break;
+        case S8:
+            fillSamples<int8_t> (dest, numSamples, random);
+            break;
+        case U16:
+            fillSamples<uint16_t> (dest, numSamples, random);
+            break;
+        case S16:
+            fillSamples<int16_t> (dest, numSamples, random);
+            break;
+        case S32:
+            fillSamples<int32_t> (dest, numSamples, random);
+            break;
+        case F32:
+            fillSamples<float> (dest, numSamples, random);
+            break;
+        case F64:
+            fillSamples<double> (dest, numSamples, random);
+            break;
+    }
+}
+
+/** Returns true if every value of a matches b, up to float rounding */
+bool nearlyEqual (const float* a, const float* b, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (std::abs (a[i] - b[i]) > 1e-5f * std::max (1.0f, std::abs (b[i])))
+            return false;
+    }
+
+    return true;
+}
+
+/** Every kernel the CPU supports converts every depth, in both layouts, as the scalar reference does */
+bool converterKernelsMatchScalar()
+{
+    const Depth depths[] = { U8, S8, U16, S16, S32, F32, F64 };
+    const int numChannels = 13;
+    const int numSamples = 37;
+    const int destStride = 40;
+    const int count = numChannels * numSamples;
+
+    std::mt19937 random (1);
+
+    std::vector<float> scales (numChannels);
+    std::vector<float> offsets (numChannels);
+
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        scales[ch] = 0.1f + 0.05f * ch;
+        offsets[ch] = 3.0f * ch - 20.0f;
+    }
+
+    for (Depth depth : depths)
+    {
+        // One extra byte, so the samples can start unaligned
+        std::vector<std::byte> samples ((size_t) count * EphysSocketHeader::getDepthSize (depth) + 1);
+        fillSamples (depth, samples.data() + 1, count, random);
+
+        DataConverter reference;
+        reference.setDepth (depth);
+        reference.setSimdLevel (SimdLevel::SCALAR);
+
+        std::vector<float> expected (count);
+        std::vector<float> expectedRows ((size_t) numChannels * destStride);
+
+        reference.convert (samples.data() + 1, expected.data(), count, 0.195f, 32768.0f);
+        reference.convertInterleaved (samples.data() + 1, numChannels, numSamples, expectedRows.data(), destStride, scales.data(), offsets.data());
+
+        for (int level = (int) SimdLevel::SSE2; level <= (int) DataConverter::getMaxSimdLevel(); level++)
+        {
+            DataConverter converter;
+            converter.setDepth (depth);
+            converter.setSimdLevel ((SimdLevel) level);
+
+            // Every length up to count covers the vector bodies and scalar tails
+            for (int n = 1; n <= count; n += 7)
+            {
+                std::vector<float> converted (n);
+                converter.convert (samples.data() + 1, converted.data(), n, 0.195f, 32768.0f);
+
+                if (! nearlyEqual (converted.data(), expected.data(), n))
+                {
+                    std::printf ("depth %d, %s kernel, %d samples\n", (int) depth, DataConverter::getSimdLevelName (converter.getSimdLevel()), n);
+                    EXPECT (false);
+                }
+            }
+
+            std::vector<float> rows ((size_t) numChannels * destStride);
+            converter.convertInterleaved (samples.data() + 1, numChannels, numSamples, rows.data(), destStride, scales.data(), offsets.data());
+
+            for (int ch = 0; ch < numChannels; ch++)
+            {
+                if (! nearlyEqual (rows.data() + ch * destStride, expectedRows.data() + ch * destStride, numSamples))
+                {
+                    std::printf ("depth %d, %s interleaved kernel, channel %d\n", (int) depth, DataConverter::getSimdLevelName (converter.getSimdLevel()), ch);
+                    EXPECT (false);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/** A malformed first header must be rejected before the buffers are sized from it */
+bool headerRejectsMalformedFields()
+{
+    EXPECT (parseHeader (U16, 2, 256, 64).isValid());
+    EXPECT (parseHeader (F64, 8, 1, 1).isValid());
+
+    EXPECT (! parseHeader (U16, 2, 0, 64).isValid());
+    EXPECT (! parseHeader (U16, 2, 256, 0).isValid());
+    EXPECT (! parseHeader (U16, 2, -256, 64).isValid());
+    EXPECT (! parseHeader (U16, 2, 256, -1).isValid());
+    EXPECT (! parseHeader (U16, 1, 256, 64).isValid());
+    EXPECT (! parseHeader (F32, 2, 256, 64).isValid());
+    EXPECT (! parseHeader (F64, 0, 256, 64).isValid());
+
+    // The converters step through samples by the size of the depth, not element_size
+    EXPECT (! parseHeader (U8, 4, 16, 8).isValid());
+    EXPECT (! parseHeader (S16, 4, 256, 64).isValid());
+    EXPECT (! parseHeader (F64 + 1, 8, 256, 64).isValid());
+
+    // A matrix that doesn't fit in an int would overflow its size
+    EXPECT (! parseHeader (S32, 4, 1 << 16, 1 << 14).isValid());
+
+    return true;
+}
+
+/** Float rows are truncated to integers, whatever values they hold */
+bool ttlTruncatesAnyFloat()
+{
+    const float samples[] = { 5.0f, std::nanf (""), INFINITY, -INFINITY, 1e30f, -1e30f, 3.7f };
+    const int numSamples = (int) (sizeof (samples) / sizeof (samples[0]));
+    const uint64_t expected[] = { 5, 0, 0, 0, 0xff, 0, 3 };
+
+    std::byte matrix[sizeof (samples)];
+    std::memcpy (matrix, samples, sizeof (samples));
+
+    TtlDecoder decoder;
+    decoder.prepare (F32, 4, 1, numSamples, CHANNEL_MAJOR, 1, 8);
+
+    uint64_t words[numSamples];
+    uint64_t previous = 0;
+    decoder.decode (matrix, words, previous);
+
+    for (int i = 0; i < numSamples; i++)
+        EXPECT (words[i] == expected[i]);
+
+    return true;
+}
+
+/** Compresses a numChannels x numSamples matrix of 16-bit samples and checks that the scalar and
+    SSE2 decoders both restore it exactly, in the given layout. Returns the payload size, or -1. */
+int roundTrip (const std::vector<uint16_t>& matrix, int numChannels, int numSamples, Layout layout, std::vector<std::byte>& payload)
+{
+    payload.resize ((size_t) DeltaCodec::getMaxCompressedSize (numChannels, numSamples));
+
+    const int size = DeltaCodec::encode (reinterpret_cast<const std::byte*> (matrix.data()), numChannels, numSamples, layout, payload.data(), (int) payload.size());
+
+    if (size < 0)
+        return -1;
+
+    payload.resize ((size_t) size);
+
+    for (SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2 })
+    {
+        DeltaCodec codec;
+        codec.setSimdLevel (level);
+
+        std::vector<uint16_t> decoded (matrix.size(), 0xdead);
+
+        if (! codec.decode (payload.data(), size, numChannels, numSamples, layout, reinterpret_cast<std::byte*> (decoded.data())) || decoded != matrix)
+        {
+            std::printf ("%d x %d %s matrix did not survive the %s decoder\n", numChannels, numSamples, layout == INTERLEAVED ? "interleaved" : "channel-major", level == SimdLevel::SCALAR ? "scalar" : "SSE2");
+            return -1;
+        }
+    }
+
+    return size;
+}
+
+/** Every block width from 0 to 16 bits decodes back to the matrix it came from */
+bool deltaCodecRoundTripsEveryWidth()
+{
+    const int numChannels = DeltaCodec::GROUP_CHANNELS;
+    const int numSamples = 1 + DeltaCodec::BLOCK_SAMPLES;
+
+    for (int width = 0; width <= 16; width++)
+    {
+        for (Layout layout : { CHANNEL_MAJOR, INTERLEAVED })
+        {
+            std::vector<uint16_t> matrix ((size_t) numChannels * numSamples, 1000);
+
+            // A delta of -2^(width - 1) zigzags to the largest code that fits in width bits
+            if (width > 0)
+            {
+                const size_t last = layout == CHANNEL_MAJOR ? (size_t) (numChannels - 1) * numSamples + numSamples - 1 : (size_t) (numSamples - 1) * numChannels + numChannels - 1;
+                const size_t before = layout == CHANNEL_MAJOR ? last - 1 : last - numChannels;
+                matrix[last] = (uint16_t) (matrix[before] - (1u << (width - 1)));
+            }
+
+            std::vector<std::byte> payload;
+            const int size = roundTrip (matrix, numChannels, numSamples, layout, payload);
+
+            EXPECT (size == 16 + 1 + width * 16);
+            EXPECT (payload[16] == (std::byte) width);
+        }
+    }
+
+    return true;
+}
+
+/** Matrices with no blocks, partial groups and blocks, full-scale deltas and random walks all decode exactly */
+bool deltaCodecRoundTripsAnyMatrix()
+{
+    std::vector<std::byte> payload;
+
+    // A single sample has no blocks, only the first samples
+    std::vector<uint16_t> single = { 1, 2, 3, 4, 5 };
+    EXPECT (roundTrip (single, 5, 1, CHANNEL_MAJOR, payload) == 16);
+
+    // Every sample jumps by half the range, the largest delta there is
+    const int numChannels = 13;
+    const int numSamples = 50;
+    std::vector<uint16_t> matrix ((size_t) numChannels * numSamples);
+
+    for (size_t i = 0; i < matrix.size(); i++)
+        matrix[i] = (i / numSamples + i) % 2 == 0 ? 0 : 0x8000;
+
+    EXPECT (roundTrip (matrix, numChannels, numSamples, CHANNEL_MAJOR, payload) == DeltaCodec::getMaxCompressedSize (numChannels, numSamples));
+
+    // Random walks of several step sizes, in both layouts and group and block remainders
+    std::mt19937 random (2);
+
+    for (int step : { 1, 30, 4000 })
+    {
+        for (Layout layout : { CHANNEL_MAJOR, INTERLEAVED })
+        {
+            for (int ch = 0; ch < numChannels; ch++)
+            {
+                uint16_t value = (uint16_t) random();
+
+                for (int s = 0; s < numSamples; s++)
+                {
+                    value = (uint16_t) (value + std::uniform_int_distribution<int> (-step, step) (random));
+                    matrix[layout == CHANNEL_MAJOR ? (size_t) ch * numSamples + s : (size_t) s * numChannels + ch] = value;
+                }
+            }
+
+            EXPECT (roundTrip (matrix, numChannels, numSamples, layout, payload) > 0);
+        }
+    }
+
+    return true;
+}
+
+/** A payload that is cut short, has trailing bytes or a width past 16 bits is rejected by both decoders */
+bool deltaCodecRejectsCorruptPayloads()
+{
+    const int numChannels = 13;
+    const int numSamples = 50;
+
+    std::vector<uint16_t> matrix ((size_t) numChannels * numSamples);
+
+    for (size_t i = 0; i < matrix.size(); i++)
+        matrix[i] = (uint16_t) (i * 7);
+
+    std::vector<std::byte> payload;
+    const int size = roundTrip (matrix, numChannels, numSamples, CHANNEL_MAJOR, payload);
+    EXPECT (size > 0);
+
+    // Room for the extra channels decoded below
+    std::vector<uint16_t> decoded ((size_t) (numChannels + 8) * numSamples);
+    std::byte* dest = reinterpret_cast<std::byte*> (decoded.data());
+
+    for (SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2 })
+    {
+        DeltaCodec codec;
+        codec.setSimdLevel (level);
+
+        EXPECT (! codec.decode (payload.data(), 0, numChannels, numSamples, CHANNEL_MAJOR, dest));
+        EXPECT (! codec.decode (payload.data(), 15, numChannels, numSamples, CHANNEL_MAJOR, dest));
+        EXPECT (! codec.decode (payload.data(), size - 1, numChannels, numSamples, CHANNEL_MAJOR, dest));
+
+        std::vector<std::byte> longer (payload);
+        longer.push_back (std::byte { 0 });
+        EXPECT (! codec.decode (longer.data(), size + 1, numChannels, numSamples, CHANNEL_MAJOR, dest));
+
+        std::vector<std::byte> corrupt (payload);
+        corrupt[16] = (std::byte) 17;
+        EXPECT (! codec.decode (corrupt.data(), size, numChannels, numSamples, CHANNEL_MAJOR, dest));
+
+        // A payload for fewer channels runs out before the matrix is complete
+        EXPECT (! codec.decode (payload.data(), size, numChannels + 8, numSamples, CHANNEL_MAJOR, dest));
+    }
+
+    return true;
+}
+
+/** Runs numSamples of every channel (rows numSamples apart) through decimator in blocks that cycle through
+    blockSizes, and returns the outputs as rows, with their timestamps and TTL words */
+int decimateInBlocks (Decimator& decimator, const std::vector<float>& signal, int numChannels, int numSamples, const std::vector<int>& blockSizes, std::vector<float>& outputs, std::vector<double>& timestamps, std::vector<uint64_t>& ttlWords)
+{
+    const int maxOutputs = numSamples / decimator.getFactor() + (int) blockSizes.size() + 1;
+
+    outputs.assign ((size_t) numChannels * maxOutputs, 0.0f);
+    timestamps.assign ((size_t) maxOutputs, 0.0);
+    ttlWords.assign ((size_t) maxOutputs, 0);
+
+    std::vector<double> inputTimes ((size_t) numSamples);
+    std::vector<uint64_t> inputWords ((size_t) numSamples);
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        inputTimes[i] = i * 1e-4;
+        inputWords[i] = (uint64_t) i;
+    }
+
+    std::vector<float> block ((size_t) numChannels * decimator.getMaxOutputSamples (numSamples));
+    int numOutputs = 0;
+
+    for (int start = 0, b = 0; start < numSamples; b++)
+    {
+        const int numInputs = std::min (blockSizes[b % blockSizes.size()], numSamples - start);
+        const int n = decimator.process (signal.data() + start, numSamples, inputTimes.data() + start, inputWords.data() + start, numInputs, block.data(), timestamps.data() + numOutputs, ttlWords.data() + numOutputs);
+
+        for (int ch = 0; ch < numChannels; ch++)
+            std::copy_n (block.data() + (size_t) ch * n, n, outputs.data() + (size_t) ch * maxOutputs + numOutputs);
+
+        numOutputs += n;
+        start += numInputs;
+    }
+
+    // Rows numOutputs apart, as a single block would have written them
+    for (int ch = 1; ch < numChannels; ch++)
+        std::copy_n (outputs.data() + (size_t) ch * maxOutputs, numOutputs, outputs.data() + (size_t) ch * numOutputs);
+
+    outputs.resize ((size_t) numChannels * numOutputs);
+    timestamps.resize ((size_t) numOutputs);
+    ttlWords.resize ((size_t) numOutputs);
+
+    return numOutputs;
+}
+
+/** Blocks of any size filter as one long signal, centred on the input sample each output is stamped with */
+bool decimatorIsIndependentOfBlockSize()
+{
+    const int factor = 5;
+    const int numChannels = 3;
+    const int numSamples = 1000;
+    const int impulse = 500;
+
+    // A DC level, a tone in the passband with one above the output Nyquist frequency, and an impulse
+    std::vector<float> signal ((size_t) numChannels * numSamples);
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        signal[i] = 3.0f;
+        signal[numSamples + i] = (float) (std::sin (0.01 * i) + 0.5 * std::sin (2.9 * i));
+        signal[2 * numSamples + i] = i == impulse ? 1.0f : 0.0f;
+    }
+
+    Decimator reference;
+    reference.prepare (factor, numChannels, numSamples);
+    reference.setSimdLevel (SimdLevel::SCALAR);
+
+    std::vector<float> expected;
+    std::vector<double> expectedTimes;
+    std::vector<uint64_t> expectedWords;
+    const int numOutputs = decimateInBlocks (reference, signal, numChannels, numSamples, { numSamples }, expected, expectedTimes, expectedWords);
+
+    // The last getDelay() inputs are still needed by outputs that aren't complete yet
+    EXPECT (numOutputs == (numSamples - reference.getDelay() - 1) / factor + 1);
+
+    for (int k = 0; k < numOutputs; k++)
+    {
+        // Each output is centred on every factor-th input, from the first
+        EXPECT (expectedWords[k] == (uint64_t) (k * factor));
+        EXPECT (expectedTimes[k] == k * factor * 1e-4);
+
+        // Unity gain at DC
+        EXPECT (std::abs (expected[k] - 3.0f) < 1e-3f);
+    }
+
+    // getDelay() centres the linear-phase response on the output of the impulse's own sample
+    const float* response = expected.data() + 2 * numOutputs;
+    const int centre = impulse / factor;
+    EXPECT (reference.getDelay() == Decimator::TAPS_PER_PHASE * factor / 2);
+
+    for (int k = 0; k < numOutputs; k++)
+        EXPECT (k == centre || std::abs (response[k]) < response[centre]);
+
+    for (int d = 1; d <= Decimator::TAPS_PER_PHASE / 2; d++)
+        EXPECT (std::abs (response[centre - d] - response[centre + d]) < 1e-6f);
+
+    // The tone above the output Nyquist frequency is filtered out, the one in the passband kept
+    for (int k = Decimator::TAPS_PER_PHASE; k < numOutputs - Decimator::TAPS_PER_PHASE; k++)
+        EXPECT (std::abs (expected[numOutputs + k] - (float) std::sin (0.01 * k * factor)) < 0.02f);
+
+    const std::vector<std::vector<int>> blockings = { { 1 }, { 7, 97, 13, 50, 2 }, { 4, 5, 6 }, { 200 } };
+
+    for (int level = (int) SimdLevel::SCALAR; level <= (int) DataConverter::getMaxSimdLevel(); level++)
+    {
+        for (const std::vector<int>& blockSizes : blockings)
+        {
+            Decimator decimator;
+            decimator.prepare (factor, numChannels, *std::max_element (blockSizes.begin(), blockSizes.end()));
+            decimator.setSimdLevel ((SimdLevel) level);
+
+            std::vector<float> outputs;
+            std::vector<double> times;
+            std::vector<uint64_t> words;
+
+            EXPECT (decimateInBlocks (decimator, signal, numChannels, numSamples, blockSizes, outputs, times, words) == numOutputs);
+            EXPECT (nearlyEqual (outputs.data(), expected.data(), numChannels * numOutputs));
+            EXPECT (times == expectedTimes && words == expectedWords);
+        }
+    }
+
+    return true;
+}
+
+struct Check
+{
+    const char* name;
+    bool (*run)();
+};
+
+const Check checks[] = {
+    { "header rejects malformed fields", headerRejectsMalformedFields },
+    { "packet ring wraps and fills", packetRingWrapsAndFills },
+    { "assembler drops broken matrices", assemblerDropsBrokenMatrices },
+    { "frame reader joins fragments", frameReaderJoinsFragments },
+    { "converter kernels match scalar", converterKernelsMatchScalar },
+    { "decimator is independent of block size", decimatorIsIndependentOfBlockSize },
+    { "delta codec round-trips every width", deltaCodecRoundTripsEveryWidth },
+    { "delta codec round-trips any matrix", deltaCodecRoundTripsAnyMatrix },
+    { "delta codec rejects corrupt payloads", deltaCodecRejectsCorruptPayloads },
+    { "legacy packets are framed as whole matrices", legacyPacketsAreFramedAsWholeMatrices },
+    { "TTL rows truncate any float", ttlTruncatesAnyFloat },
+    { "sequence resyncs after a reconnect", sequenceResyncsAfterReconnect },
+    { "sequence keeps gaps after a reconnect", sequenceKeepsGapAfterReconnect },
+};
+} // namespace
+
+int main()
+{
+    int numFailed = 0;
+
+    for (const Check& check : checks)
+    {
+        const bool passed = check.run();
+        std::printf ("%s: %s\n", passed ? "PASS" : "FAIL", check.name);
+
+        if (! passed)
+            numFailed++;
+    }
+
+    return numFailed > 0 ? 1 : 0;
+}